@@ -2,6 +2,7 @@
 #include "core/Global.h"
 #include "iterator/SstableIterator.h"
 #include "core/memtable.h"
+#include "core/WriteController.h"
 #include "compaction/Manifest.h"      
 #include "storage/Sstable.h"
 #include "iterator/TmergeIterator.h"
@@ -9,12 +10,18 @@
 #include "transaction/transaction.h"
 #include <array>
 #include <atomic>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <deque>
 #include <map>
+#include <set>
+#include <span>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
@@ -37,34 +44,79 @@ class LSM_Engine : public std::enable_shared_from_this<LSM_Engine> {
   std::array<std::size_t, Global_::MAX_LEVEL>          level_size;
   std::shared_mutex                                    ssts_mtx;
   std::shared_ptr<BlockCache>                          block_cache;
-  std::unique_ptr<WAL>                                 wal;
+  std::vector<std::unique_ptr<WAL>>                    wals;  // one per WAL stream
   std::atomic<uint64_t>                                nextTransactionId_ = 1;
+  // Every allocated tranc_id up to this one is in the memtable.
+  std::atomic<uint64_t>                                published_tranc_id_ = 0;
   std::atomic_size_t                                   next_sst_id        = 0;
   size_t                                               cur_max_level      = 0;
 
  public:
   LSM_Engine(std::string path, size_t block_cache_capacity = Global_::Block_CACHE_capacity,
-             size_t block_cache_k = Global_::Block_CACHE_K);
+             size_t                     block_cache_k = Global_::Block_CACHE_K,
+             Global_::MemTableShardMode shard_mode    = Global_::MEMTABLE_SHARD_MODE,
+             size_t                     flush_threads = Global_::FLUSH_THREAD_NUM,
+             Global_::MemTableRepType   memtable_rep  = Global_::MEMTABLE_REP,
+             size_t                     wal_streams   = Global_::WAL_STREAMS);
   ~LSM_Engine();
 
   std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
       const std::string& prefix, uint64_t tranc_id);
   std::vector<std::pair<std::string, std::string>>     print_level_range(size_t level);
-  std::optional<std::pair<std::string, uint64_t>> get(std::string_view key,
-                                                           uint64_t         tranc_id = 0);
+  std::optional<std::pair<std::string, uint64_t>> get(std::string_view   key,
+                                                      uint64_t           tranc_id = 0,
+                                                      const ReadOptions& options  = {});
   std::vector<std::tuple<std::string, std::optional<std::string>, uint64_t>> get_batch(
-      const std::vector<std::string>& keys, uint64_t tranc_id = 0);
+      const std::vector<std::string>& keys, uint64_t tranc_id = 0,
+      const ReadOptions& options = {});
   uint64_t bytes_to_mb(size_t bytes) const;
 
   // Returns a snapshot of all live SST metadata recorded in the MANIFEST.
   [[nodiscard]] std::vector<SstMeta> get_manifest_info() const;
+  // Cumulative slowdown / stop counters of the write controller.
+  [[nodiscard]] WriteStallStats write_stall_stats() const;
+
+  // Read view that sees every completed write and no half-applied one.
+  [[nodiscard]] uint64_t published_tranc_id() const {
+    return published_tranc_id_.load(std::memory_order_acquire);
+  }
+
+  // Pins a read view at tranc_id (0 == the latest published one). Until it
+  // is released, freeze, flush and compaction keep the version of every key
+  // it can see; versions no live snapshot can see are dropped. Reads issued
+  // with an older tranc_id that was never acquired here are not protected.
+  uint64_t acquire_snapshot(uint64_t tranc_id = 0);
+  void     release_snapshot(uint64_t snapshot);
+
+  // A read view at the latest published id, protected like an acquired
+  // snapshot for as long as the object lives. It takes a free read slot
+  // instead of snapshot_mtx_, falling back to acquire_snapshot when every
+  // slot is in use.
+  class ReadView {
+   public:
+    explicit ReadView(LSM_Engine& engine);
+    ~ReadView();
+    ReadView(const ReadView&)            = delete;
+    ReadView& operator=(const ReadView&) = delete;
+    [[nodiscard]] uint64_t tranc_id() const { return tranc_id_; }
+
+   private:
+    LSM_Engine&            engine_;
+    std::atomic<uint64_t>* slot_     = nullptr;
+    uint64_t               tranc_id_ = 0;
+  };
 
   // 如果触发了刷盘, 返回当前刷入sst的最大事务id
-  uint64_t put(const std::string& key, const std::string& value, uint64_t tranc_id = 0);
+  // options 决定这次写入的 WAL 持久化方式 (sync / 不 sync / 不写 WAL)
+  // tranc_id 为 0 时由 WAL 写组统一分配, 写入内存表后按序发布给读请求
+  uint64_t put(const std::string& key, const std::string& value, uint64_t tranc_id = 0,
+               const WriteOptions& options = {});
   uint64_t put_batch(const std::vector<std::pair<std::string, std::string>>& kvs,
-                     uint64_t                                                tranc_id = 0);
-  uint64_t remove(const std::string& key, uint64_t tranc_id = 0);
-  uint64_t remove_batch(const std::vector<std::string>& keys, uint64_t tranc_id = 0);
+                     uint64_t tranc_id = 0, const WriteOptions& options = {});
+  uint64_t remove(const std::string& key, uint64_t tranc_id = 0,
+                  const WriteOptions& options = {});
+  uint64_t remove_batch(const std::vector<std::string>& keys, uint64_t tranc_id = 0,
+                        const WriteOptions& options = {});
   void     clear();
   uint64_t flush(bool force = false);
 
@@ -77,18 +129,109 @@ class LSM_Engine : public std::enable_shared_from_this<LSM_Engine> {
   // ── MANIFEST ──────────────────────────────────────────────────────────────
   std::unique_ptr<Manifest> manifest_;
 
+  // ── WAL streams ───────────────────────────────────────────────────────────
+  // Writes go to the first wal_write_streams_ entries of wals; any further
+  // ones are streams found on disk from a run with more streams, kept only
+  // so their cleaners retire them.
+  size_t wal_write_streams_;
+  // The stream the calling thread writes to.
+  WAL&   wal_for_writer();
+  void   open_wal_streams(uint64_t checkpoint);
+
+  // ── Transaction ids ───────────────────────────────────────────────────────
+  // Logs one write's entries (carrying tranc_id) and returns the id they are
+  // written with: tranc_id itself, or with tranc_id == 0 one allocated by the
+  // stream's write group (by a plain fetch_add when the WAL is bypassed).
+  uint64_t log_write(std::span<const WalEntryRef> entries, uint64_t tranc_id,
+                     const WriteOptions& options);
+  // Marks an allocated id's write as applied to the memtable and returns
+  // once published_tranc_id_ covers it (i.e. every smaller id is applied).
+  void     publish_tranc_id(uint64_t tranc_id) noexcept;
+  // Publishes an allocated id when the write path leaves scope, also when it
+  // unwinds: every later id waits for this one. tranc_id == 0 publishes
+  // nothing (the caller brought its own id).
+  class PublishGuard {
+   public:
+    PublishGuard(LSM_Engine& engine, uint64_t tranc_id) : engine_(engine), tranc_id_(tranc_id) {}
+    ~PublishGuard() {
+      if (tranc_id_ != 0) engine_.publish_tranc_id(tranc_id_);
+    }
+    PublishGuard(const PublishGuard&)            = delete;
+    PublishGuard& operator=(const PublishGuard&) = delete;
+
+   private:
+    LSM_Engine& engine_;
+    uint64_t    tranc_id_;
+  };
+  // publish_slots_[id % kPublishSlots] == id once that write is applied.
+  static constexpr size_t                          kPublishSlots = 4096;
+  std::array<std::atomic<uint64_t>, kPublishSlots> publish_slots_{};
+
+  // ── Flush pipeline ────────────────────────────────────────────────────────
+  // One job == the frozen tables claimed together, merged into one L0 run.
+  struct FlushJob {
+    uint64_t               seq;           // install order == claim order
+    std::vector<Skiplist*> tables;        // oldest first, still owned by memtable
+    size_t                 first_sst_id;  // ids reserved at claim time
+    size_t                 sst_id_count;
+  };
+  std::vector<std::thread> flush_threads_;
+  std::mutex               flush_mutex_;  // guards the fields below
+  std::condition_variable  flush_cv_;     // frozen tables queued / stop
+  std::condition_variable  install_cv_;   // next_install_seq_ advanced
+  uint64_t                 next_flush_seq_   = 0;
+  uint64_t                 next_install_seq_ = 0;
+  bool                     stop_flush_       = false;
+  std::optional<FlushJob>               claim_flush_job();
+  std::vector<std::shared_ptr<Sstable>> build_flush_job(const FlushJob& job);
+  uint64_t install_flush_job(const FlushJob& job, std::vector<std::shared_ptr<Sstable>> new_ssts);
+  uint64_t run_flush_job();
+  void     wait_for_flushes();
+  void     flush_worker();
+
+  // ── Snapshots ─────────────────────────────────────────────────────────────
+  std::mutex               snapshot_mtx_;
+  std::multiset<uint64_t>  snapshots_;  // guarded by snapshot_mtx_
+  // Ids that ReadViews read at; 0 == free. A slot is taken by CAS, so each
+  // holds at most one reader.
+  static constexpr size_t kReadSlots = 64;
+  struct alignas(64) ReadSlot {
+    std::atomic<uint64_t> tranc_id{0};
+  };
+  std::array<ReadSlot, kReadSlots> read_slots_;
+  // Collapser keeping every version that an acquired snapshot or a ReadView
+  // can still see.
+  VersionCollapser         live_snapshots();
+
   // ── Compaction ────────────────────────────────────────────────────────────
   std::thread             compaction_thread_;
   std::mutex              compaction_mutex_;
   std::condition_variable compaction_cv_;
   std::atomic<bool>       stop_compaction_{false};
- uint64_t drain_one_frozen_table();
+  bool                    compaction_pending_ = false;  // guarded by compaction_mutex_
+  // Held for a whole compaction round, which merges without ssts_mtx;
+  // clear() takes it so it never wipes SSTs a round is about to replace.
+  std::mutex              compaction_run_mtx_;
+  // L0 sorted runs since the last L0→L1 compaction; one flush == one run.
+  // Guarded by ssts_mtx.
+  size_t l0_runs_ = 0;
+  bool l0_needs_compaction() const;  // caller holds ssts_mtx
   void compaction_worker();
+
+  // ── Write stall ───────────────────────────────────────────────────────────
+  //  Snapshot of the LSM shape read lock-free by the write controller;
+  //  refreshed under ssts_mtx whenever L0 or level sizes change.
+  std::atomic_size_t l0_files_{0};
+  std::atomic_size_t pending_compaction_bytes_{0};
+  WriteController    write_controller_;
+  void               refresh_stall_inputs();  // caller holds ssts_mtx
   bool exit_valid_sst_iter(std::vector<SstIterator>& sst_iters);
   std::pair<size_t, size_t> find_the_small_kv(std::vector<SstIterator>& sst_iters);
   std::optional<std::string> find_smallest_compaction_key(const std::vector<SstIterator>& merged);
   std::vector<CompactionEntry> collect_compaction_entries(std::vector<SstIterator>& merged,const std::string&key);
-  bool can_drop_tombstone(std::string_view key, size_t output_level) const ;
+  // deeper: every SST below the output level, taken with the compaction's inputs
+  static bool can_drop_tombstone(std::string_view key,
+                                 std::span<const std::shared_ptr<Sstable>> deeper);
  // compaction round-robin pointer: level → last compacted key
 std::unordered_map<size_t, std::string> compaction_pointer_;
 
@@ -97,9 +240,17 @@ std::vector<size_t> find_overlapping_ssts(size_t level,
                                            std::string_view min_key,
                                            std::string_view max_key);
 size_t pick_compaction_index(size_t level);
-std::vector<std::shared_ptr<Sstable>> compact_ssts(const std::vector<size_t>& upper_ids,
-                                                    const std::vector<size_t>& lower_ids,
-                                                    size_t output_level);
+// Inputs of one compaction round, picked under a shared ssts_mtx.
+struct CompactionPlan {
+  size_t                                src_level = 0;
+  std::vector<std::shared_ptr<Sstable>> src{};     // L0: newest first
+  std::vector<std::shared_ptr<Sstable>> dst{};     // overlapping SSTs of src_level + 1
+  std::vector<std::shared_ptr<Sstable>> deeper{};  // every SST below src_level + 1
+  size_t                                l0_runs = 0;  // L0 runs covered by src
+  std::string                           range_max{};
+};
+std::optional<CompactionPlan> plan_compaction(size_t src_level);
+std::vector<std::shared_ptr<Sstable>> compact_ssts(const CompactionPlan& plan);
 void leveled_compact(size_t src_level);
   std::vector<std::shared_ptr<Sstable>> gen_sst_from_iter(BaseIterator& iter,
                                                           size_t        target_sst_size,
@@ -110,10 +261,12 @@ void leveled_compact(size_t src_level);
 class LSM {
  private:
   std::shared_ptr<LSM_Engine> engine;
-  uint64_t getNextTransactionId();
 
  public:
-  explicit LSM(std::string path);
+  explicit LSM(std::string path,
+               Global_::MemTableShardMode shard_mode   = Global_::MEMTABLE_SHARD_MODE,
+               Global_::MemTableRepType   memtable_rep = Global_::MEMTABLE_REP,
+               size_t                     wal_streams  = Global_::WAL_STREAMS);
   ~LSM();
 
   void print_level_range(size_t level);
@@ -122,19 +275,24 @@ class LSM {
   // Entries are ordered by sst_id (ascending).  Useful for inspecting
   // the current level layout without reading SST files from disk.
   [[nodiscard]] std::vector<SstMeta> get_manifest_info() const;
+  [[nodiscard]] WriteStallStats      write_stall_stats() const;
 
-  std::optional<std::string>                                 get(std::string_view key);
+  // ReadOptions::verify_checksums 决定从 SST 读出的 block 是否校验 checksum
+  std::optional<std::string> get(std::string_view key, const ReadOptions& options = {});
   std::vector<std::pair<std::string, std::optional<std::string>>> get_batch(
-      const std::vector<std::string>& keys);
+      const std::vector<std::string>& keys, const ReadOptions& options = {});
   std::vector<std::pair<std::string, std::string>> range(const std::string& start_key,
                                                          const std::string& end_key);
   std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
       const std::string& prefix);
 
-  void put(const std::string& key, const std::string& value);
-  void put_batch(const std::vector<std::pair<std::string, std::string>>& kvs);
-  void remove(const std::string& key);
-  void remove_batch(const std::vector<std::string>& keys);
+  // Durability is per call, see WriteOptions; the default follows
+  // Global_::WAL_SYNC_ON_WRITE.
+  void put(const std::string& key, const std::string& value, const WriteOptions& options = {});
+  void put_batch(const std::vector<std::pair<std::string, std::string>>& kvs,
+                 const WriteOptions&                                     options = {});
+  void remove(const std::string& key, const WriteOptions& options = {});
+  void remove_batch(const std::vector<std::string>& keys, const WriteOptions& options = {});
 
   using LSMIterator = Level_Iterator;
   void clear();
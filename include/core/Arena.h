@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Global.h"
+#include "WriteBufferManager.h"
+
+// 跳表节点的 bump 分配器
+// 按块向系统申请内存, 节点只分配不单独释放, 随 Arena 析构整体归还.
+// allocate 可以被多个写线程并发调用: 快路径只有一次 fetch_add,
+// 当前块用尽时才进入加锁的慢路径换块.
+// 每个新块都记到 WriteBufferManager 的账上 (如果有), Arena 析构时归还.
+class Arena {
+ public:
+  static constexpr size_t kAlign = 8;  // 节点里最宽的成员是 uint64_t / 指针
+
+  explicit Arena(WriteBufferManager* wbm = nullptr);
+  ~Arena()                       = default;
+  Arena(const Arena&)            = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // 返回 kAlign 对齐的 bytes 字节, 生命周期与 Arena 相同
+  char* allocate(size_t bytes);
+  // 已经向系统申请的字节数 (包含块尾部未用完的部分和 charge 记入的外部内存)
+  size_t memory_usage() const;
+  // 把表在 Arena 之外分配的内存 (哈希桶数组, 向量缓冲区) 也记到这张表的账上
+  void charge(size_t bytes);
+  // 表冻结, 之后这个 Arena 的内存不再算作活跃内存
+  void done_allocating();
+  WriteBufferManager* write_buffer_manager() const;
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t                  size;
+    std::atomic_size_t      used;
+  };
+  char*  allocate_slow(size_t bytes);
+  Block* new_block(size_t block_bytes, size_t used);
+
+  std::atomic<Block*>                 current_;
+  std::mutex                          mutex_;   // 保护 blocks_ 和换块
+  std::vector<std::unique_ptr<Block>> blocks_;
+  std::atomic_size_t                  memory_usage_;
+  AllocTracker                        tracker_;
+};
@@ -4,36 +4,92 @@
 #include <span>
 #include <stdexcept>
 namespace Global_ {
-constexpr int              FIX_LEVEL   = 5;
-constexpr int              MAX_LEVEL   = 12;
+constexpr int              MAX_LEVEL   = 12;  // 跳表塔高上限, 节点只分配实际高度的 forward
 constexpr int              NUMS_SHARDS = 8;  // 分片数量
 constexpr int              MAX_MEMTABLE_SIZE_PER_TABLE       = 1024ULL * 1024 * 3;  // 3MB
 constexpr int              MAX_SSTABLE_SIZE                  = 1024ULL * 1024 * 3;  // 3MB
 constexpr int              Block_SIZE                        = 1024ULL * 4;         // 4KB
+constexpr size_t           BLOCK_RESTART_INTERVAL            = 16;  // block 内每 16 条存一次完整 key
+constexpr bool             BLOCK_HASH_INDEX                  = true;  // block 末尾附带 key 哈希 -> 重启点索引
+constexpr double           BLOCK_HASH_INDEX_UTIL_RATIO       = 0.75;  // 哈希索引装载率: 不同 key 数 / 桶数
+constexpr bool             VERIFY_CHECKSUMS_ON_READ          = true;  // ReadOptions::verify_checksums 的默认值
+constexpr size_t           ARENA_BLOCK_SIZE                  = 1024ULL * 64;        // 跳表 Arena 每块 64KB
 constexpr int              Block_CACHE_capacity              = 1024ULL*1024 * 256; //256MB
 constexpr int              Block_CACHE_K                     = 2;
 constexpr int              LSM_SST_LEVEL_RATIO               = 4;
+constexpr size_t           FLUSH_THREAD_NUM                  = 2;  // 后台 flush 线程数
+// ── 写入反压 (WriteController) ─ 超过 slowdown 开始限速, 超过 stop 停写 ──
+constexpr size_t WRITE_SLOWDOWN_IMM_BYTES     = 2ULL * NUMS_SHARDS * MAX_MEMTABLE_SIZE_PER_TABLE;
+constexpr size_t WRITE_STOP_IMM_BYTES         = 4ULL * NUMS_SHARDS * MAX_MEMTABLE_SIZE_PER_TABLE;
+constexpr size_t WRITE_SLOWDOWN_L0_FILES      = 20;
+constexpr size_t WRITE_STOP_L0_FILES          = 36;
+constexpr size_t WRITE_SLOWDOWN_PENDING_BYTES = 1024ULL * 1024 * 256;   // 256MB
+constexpr size_t WRITE_STOP_PENDING_BYTES     = 1024ULL * 1024 * 1024;  // 1GB
+constexpr double DELAYED_WRITE_RATE           = 1024.0 * 1024 * 16;     // 限速起点 16MB/s
 constexpr int              bloom_filter_expected_size_       = 1024ULL*64;
 constexpr double           bloom_filter_expected_error_rate_ = 0.01;
 constexpr size_t L1_BUDGET_MB =
     10 * NUMS_SHARDS * MAX_MEMTABLE_SIZE_PER_TABLE / (1024ULL * 1024);
 constexpr std::string_view WAL_DIR                           = "data/wal";
-constexpr bool WAL_SYNC_ON_WRITE = false;  // 改为 false 开启 group-only sync
+constexpr bool WAL_SYNC_ON_WRITE = false;  // WriteOptions::sync 的默认值, 可按次写入覆盖
 constexpr int              WAL_BLOCK_SIZE       = 1024 * 32;         // 32 KB  (already present)
 constexpr uint64_t         WAL_FILE_LIMIT       = 1024 * 1024 * 64;  // 64 MB per WAL file
 constexpr uint64_t         WAL_CLEAN_INTERVAL_S = 30;                // cleaner cadence (seconds)
+constexpr size_t           WAL_RECYCLE_SEGMENTS = 2;  // 已落盘的 WAL 段最多留几个复用, 多余的删除
+constexpr size_t           WAL_RECOVERY_THREADS   = 4;                 // 恢复时并行解码的段数
+constexpr size_t           WAL_RECOVERY_READ_SIZE = 1024 * 1024;       // 恢复时每次读 1MB, 须为块大小的整数倍
+constexpr size_t           WAL_ASYNC_QUEUE_SIZE   = 4096;  // log_async 队列的槽数, 满了生产者让出 CPU 重试
+// WAL 流数. 1 为单一日志; 大于 1 时每个写线程固定写其中一个流, 各流独立加锁、
+// 独立 fsync. 流 0 在数据目录下, 流 i 在 wal_stream_<i>/ 下, 恢复时全部回放
+constexpr size_t           WAL_STREAMS            = 1;
 enum class WalWritePolicy : uint8_t {
   kPipelined,
   kUnordered,
 };
+// WAL 记录压缩: kLz 时每条足够大的记录先用内置的 LZ 编码, 变小了才按压缩格式写
+enum class WalCompression : uint8_t {
+  kNone,
+  kLz,
+};
+// 内存表分片方式:
+//   kHash  : fast_hash(key) 决定分片, 负载均匀, 但每个分片都覆盖整个 key 空间
+//   kRange : 按 key 范围分片, 分界随观测到的 key 分布调整; 范围扫描只访问
+//            相交的分片, 同一轮冻结出的各分片 key 范围互不重叠
+enum class MemTableShardMode : uint8_t {
+  kHash,
+  kRange,
+};
+constexpr MemTableShardMode MEMTABLE_SHARD_MODE = MemTableShardMode::kHash;
+constexpr size_t RANGE_SHARD_SAMPLES = 64;  // 重新划分范围时每个分片取的样本数
+// 活跃内存表的存储结构, 冻结后统一转成跳表:
+//   kSkiplist  : 并发跳表, 写入 O(log n), 冻结时无需转换
+//   kHashTable : 定长哈希桶 + 桶内有序链表, 点写/点查 O(1), 冻结时整体排序成跳表;
+//                范围扫描要遍历所有桶, 适合以点查为主的负载
+//   kVector    : 每个写线程一个只追加的缓冲区, 冻结时才排序; 读要线性扫描,
+//                只适合导入期间几乎不读的批量加载
+enum class MemTableRepType : uint8_t {
+  kSkiplist,
+  kHashTable,
+  kVector,
+};
+constexpr MemTableRepType MEMTABLE_REP = MemTableRepType::kSkiplist;
+constexpr size_t HASH_REP_BUCKETS = 1 << 15;  // 哈希表示每个分片的桶数, 须为 2 的幂
+// 全部内存表 (活跃 + 待落盘) 的写缓冲预算, 超出时冻结最大的活跃分片;
+// 单个分片的上限仍是 MAX_MEMTABLE_SIZE_PER_TABLE, 两者都按实际分配的字节计算
+constexpr size_t WRITE_BUFFER_SIZE = 3ULL * NUMS_SHARDS * MAX_MEMTABLE_SIZE_PER_TABLE / 2;
+constexpr bool   WRITE_BUFFER_CHARGE_BLOCK_CACHE = false;  // block cache 是否计入写缓冲预算
+constexpr size_t VECTOR_REP_PARALLEL_SORT_MIN = 1 << 14;  // 向量表示冻结时每个排序线程至少分到的条目数
 enum class SkiplistStatus {
   kNormal,
   KFreezing,
   kFrozen,
+  kFlushing,  // 已被 flush 任务认领, SST 安装前仍可读
 };
 // Global.h — 找到这行改掉
 constexpr WalWritePolicy WAL_WRITE_POLICY = WalWritePolicy::kUnordered; // ← 原来是这个
 //constexpr WalWritePolicy WAL_WRITE_POLICY = WalWritePolicy::kPipelined;
+constexpr WalCompression WAL_COMPRESSION          = WalCompression::kNone;
+constexpr size_t         WAL_COMPRESS_MIN_BYTES   = 64;  // 更短的记录不尝试压缩
 // ── Write policy ─────────────────────────────────────────────────────────────
 //   kPipelined : group leader writes WAL for the whole batch, then releases
 //                the write lock so the next group can start WAL while the
@@ -64,12 +120,26 @@ inline consteval auto make_crc32c_table() noexcept {
 }
 inline constexpr auto kCrc32cLookup = make_crc32c_table();
 
-[[nodiscard]] inline constexpr uint32_t crc32c(std::span<const uint8_t> data) noexcept {
+// 可移植版本: 查表, 每次一个字节; 也用于编译期
+[[nodiscard]] inline constexpr uint32_t crc32c_portable(std::span<const uint8_t> data) noexcept {
   uint32_t crc = ~0u;
   for (auto b : data) crc = (crc >> 8) ^ kCrc32cLookup[(crc ^ b) & 0xFF];
   return ~crc;
 }
 
+// CRC-32C 的几种实现, 结果完全相同
+enum class Crc32cImpl : uint8_t {
+  kPortable,  // 查表
+  kSse42,     // SSE4.2 crc32 指令, 每次 8 字节
+  kPclmul,    // 三路 crc32 指令并行, 再用 PCLMULQDQ 把三段结果合并
+};
+// 第一次使用时按 CPUID 选出的最快实现, crc32c() 就用它
+[[nodiscard]] Crc32cImpl crc32c_impl() noexcept;
+[[nodiscard]] bool       crc32c_supported(Crc32cImpl impl) noexcept;
+// 指定实现计算, 供测试和基准使用; 当前 CPU 不支持时退回可移植版本
+[[nodiscard]] uint32_t   crc32c(Crc32cImpl impl, std::span<const uint8_t> data) noexcept;
+[[nodiscard]] uint32_t   crc32c(std::span<const uint8_t> data) noexcept;
+
 // LevelDB-style masking: rotate + salt so a CRC of all-zeros differs from 0.
 [[nodiscard]] inline constexpr uint32_t mask_crc(uint32_t crc) noexcept {
   return ((crc >> 15) | (crc << 17)) + 0xa282ead8u;
@@ -78,6 +148,22 @@ inline constexpr auto kCrc32cLookup = make_crc32c_table();
   const uint32_t rot = v - 0xa282ead8u;
   return (rot >> 17) | (rot << 15);
 }
+// SST 里数据 block、索引 (BlockMeta) 和 bloom filter 的校验和
+[[nodiscard]] inline uint32_t block_checksum(std::span<const uint8_t> data) noexcept {
+  return mask_crc(crc32c(data));
+}
+// 改用 crc32c 之前的校验和: std::hash 截断到 32 位, 随标准库实现而变.
+// 只用于格式标记表明写于改用 crc32c 之前的旧 block / 索引
+[[nodiscard]] inline uint32_t legacy_block_checksum(std::span<const uint8_t> data) noexcept {
+  return static_cast<uint32_t>(std::hash<std::string_view>{}(
+      std::string_view(reinterpret_cast<const char*>(data.data()), data.size())));
+}
+// 按写入时的格式选一种校验和比较, 不会两种都试
+[[nodiscard]] inline bool block_checksum_matches(std::span<const uint8_t> data, uint32_t stored,
+                                                 bool legacy) noexcept {
+  return (legacy ? legacy_block_checksum(data) : block_checksum(data)) == stored;
+}
+
 // 在公共头文件里定义，使用 inline 防止重复定义报错
 template <std::integral T>
 inline void write_le(std::vector<uint8_t>& buf, T v) noexcept {
@@ -89,6 +175,16 @@ inline void write_le(std::vector<uint8_t>& buf, T v) noexcept {
   }
 }
 
+// 写到调用方给的内存, dst 至少有 sizeof(T) 字节
+template <std::integral T>
+inline void write_le(uint8_t* dst, T v) noexcept {
+  auto val = static_cast<std::make_unsigned_t<T>>(v);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    dst[i] = static_cast<uint8_t>(val & 0xFF);
+    val >>= 8;
+  }
+}
+
 
 template <std::integral T>
 inline T read_le(std::span<const uint8_t> src, size_t off = 0) {
@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "Arena.h"
+#include "Global.h"
+#include "MemTableRep.h"
+#include "Skiplist.h"
+
+// 哈希索引的活跃内存表
+// 定长桶数组, 每个桶是一条按 (key 升序, tranc_id 降序) 排列的单链表, 节点复用
+// 跳表的 Node (高度为 1), 同样分配在 Arena 里. 同一个 key 的所有版本落在同一个桶,
+// 点写/点查只需遍历一条很短的链; 写入用 CAS 挂链, 读者无锁.
+// 没有全局顺序, 冻结时由 to_skiplist 把全部节点排序后顺序追加成一张跳表.
+class HashTableRep : public MemTableRep {
+ public:
+  explicit HashTableRep(size_t bucket_count = Global_::HASH_REP_BUCKETS,
+                        WriteBufferManager* wbm = nullptr);
+  HashTableRep(const HashTableRep&)            = delete;
+  HashTableRep& operator=(const HashTableRep&) = delete;
+  ~HashTableRep() override                     = default;
+
+  bool Insert(std::string_view key, std::string_view value,
+              const uint64_t transaction_id = 0) override;
+  std::optional<LookupResult> Get(std::string_view key,
+                                  const uint64_t   transaction_id = 0) override;
+  Node* get_node(std::string_view key, const uint64_t transaction_id = 0) override;
+  // 需要遍历所有桶, 结果按 (key 升序, tranc_id 降序) 排好
+  std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
+      std::string_view prefix, uint64_t tranc_id) override;
+  std::size_t get_size() override;
+  std::size_t memory_usage() override;
+  std::size_t getnodecount() override;
+  void        set_num_shard(int num_shard) override;
+  int         get_num_shard() const override;
+
+  std::unique_ptr<Skiplist> to_skiplist(VersionCollapser* collapser = nullptr) override;
+
+ private:
+  std::atomic<Node*>& bucket_of(std::string_view key) const;
+  // 桶内第一个 key 等于 key 的节点 (最新版本)
+  Node* find_first(std::string_view key) const;
+
+  std::unique_ptr<Arena>                arena_;
+  std::unique_ptr<std::atomic<Node*>[]> buckets_;
+  size_t                                mask_;
+  std::atomic_size_t                    size_bytes_;
+  std::atomic_size_t                    nodecount_;
+  int                                   num_shard_;
+};
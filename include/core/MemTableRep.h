@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+class Node;
+class Skiplist;
+
+struct LookupResult {
+  std::string value;
+  uint64_t    transaction_id;
+};
+
+// 版本回收
+// 按 (key 升序, tranc_id 降序) 的顺序逐个喂入版本, keep 判断它是否还可能被读到.
+// 每个 key 最新的版本总是保留 (删除标记也要保留, 它还要遮住 SST 里的旧值);
+// 更旧的版本只有某个存活快照 s 满足 tranc_id <= s < 紧邻的更新版本的 tranc_id,
+// 也就是它恰好是 s 能看到的版本时才保留. 同 tranc_id 的多次写入只留最新的一次.
+// 已经分配、还没发布的 id (published, next_id) 上的版本一律保留: 回收之后才登记的读请求
+// 可能取到落在这段里的读视图.
+class VersionCollapser {
+ public:
+  // snapshots: 存活快照的 tranc_id, 顺序任意; published 非 0 时本身也当作一个快照
+  explicit VersionCollapser(std::vector<uint64_t> snapshots, uint64_t published = 0,
+                            uint64_t next_id = 0)
+      : snapshots_(std::move(snapshots)), published_(published), next_id_(next_id) {
+    if (published_ != 0) {
+      snapshots_.push_back(published_);
+    }
+    std::ranges::sort(snapshots_);
+  }
+
+  bool keep(std::string_view key, uint64_t transaction_id) {
+    if (!has_prev_ || key != prev_key_) {
+      has_prev_ = true;
+      prev_key_ = key;
+      prev_tid_ = transaction_id;
+      return true;
+    }
+    auto it      = std::ranges::lower_bound(snapshots_, transaction_id);
+    bool visible = (transaction_id > published_ && transaction_id < next_id_) ||
+                   (it != snapshots_.end() && *it < prev_tid_);
+    prev_tid_    = transaction_id;
+    return visible;
+  }
+
+ private:
+  std::vector<uint64_t> snapshots_;
+  uint64_t              published_;
+  uint64_t              next_id_;
+  std::string           prev_key_;
+  uint64_t              prev_tid_ = 0;
+  bool                  has_prev_ = false;
+};
+
+// 活跃内存表的存储结构
+// MemTable 的每个分片持有一个 MemTableRep 接收写入. 冻结以后一律是 Skiplist:
+// 非跳表的实现在冻结时通过 to_skiplist 转成按 (key 升序, tranc_id 降序) 排列的
+// 跳表, 因此 flush / 冻结表查询只需要面对跳表一种结构.
+// 并发语义与 Skiplist 相同: Insert / Get / get_node / get_prefix_range 可以并发调用.
+class MemTableRep {
+ public:
+  virtual ~MemTableRep() = default;
+
+  virtual bool Insert(std::string_view key, std::string_view value,
+                      const uint64_t transaction_id = 0)                          = 0;
+  virtual std::optional<LookupResult> Get(std::string_view key,
+                                          const uint64_t   transaction_id = 0)    = 0;
+  // 可见版本所在的节点; transaction_id != 0 且可见版本是删除标记时返回 nullptr
+  virtual Node* get_node(std::string_view key, const uint64_t transaction_id = 0) = 0;
+  virtual std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
+      std::string_view prefix, uint64_t tranc_id)  = 0;
+  // 节点字节数 (key/value/版本号), 即落盘的数据量
+  virtual std::size_t get_size()                   = 0;
+  // 实际向系统申请的字节数, 写缓冲预算按这个记账
+  virtual std::size_t memory_usage()               = 0;
+  virtual std::size_t getnodecount()               = 0;
+  virtual void        set_num_shard(int num_shard) = 0;
+  virtual int         get_num_shard() const        = 0;
+
+  // 本身就是跳表时返回自己, 冻结时无需转换
+  virtual Skiplist* as_skiplist() { return nullptr; }
+  // 转成有序跳表 (总是一张新表); collapser 非空时顺带丢掉没有读者能看到的旧版本.
+  // 调用方保证此时没有并发写入
+  virtual std::unique_ptr<Skiplist> to_skiplist(VersionCollapser* collapser = nullptr) = 0;
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include "../iterator/BaseIterator.h"
+#include "../storage/BloomFilter.h"
+#include <algorithm>
 #include <atomic>
 #include <concepts>
 #include <ranges>
@@ -13,29 +15,80 @@
 #include <tuple>
 #include <utility>
 #include <vector>
+#include "Arena.h"
 #include "Global.h"
+#include "MemTableRep.h"
 
 class SkiplistIterator;
-struct LookupResult {
-  std::string value;
-  uint64_t    transaction_id;
-};
+// 节点整体分配在所属跳表的 Arena 中, 内存布局:
+//   [transaction_id][key_prefix][key_size][value_size][height][forward[0..height)][key 字节][value 字节]
+// forward 只按节点实际高度分配. 节点一旦通过 CAS 挂到第 0 层就对读者可见,
+// 之后 key/value 不再修改; forward 用 acquire/release 发布, 读者无需加锁即可遍历.
+// key_prefix 是 key 前 8 字节按大端拼成的整数 (不足补 0), 和 forward 在同一条缓存行里:
+// 查找时先比它, 只有相等时才去读 key 字节
 class Node {
  public:
-  std::string                           key_;
-  std::string                           value_;
-  std::unique_ptr<Node>                 next_;
-  std::array<Node*, Global_::FIX_LEVEL> forward;
-  uint64_t                              transaction_id;
-  Node(std::string key, std::string value, const uint64_t transaction_ids = 0)
-      : key_(std::move(key)), value_(std::move(value)), next_{}, transaction_id(transaction_ids) {
-    forward.fill(nullptr);
-  }
-  Node(Node&&) noexcept            = default;
-  Node& operator=(Node&&) noexcept = default;
-  Node(const Node&)                = delete;
-  Node& operator=(const Node&)     = delete;
+  uint64_t transaction_id;
+
+  // 大端前缀保持字典序: prefix(a) < prefix(b) 蕴含 a < b, 相等时需要比完整 key
+  static uint64_t key_prefix(std::string_view key);
+
+  static Node* create(Arena& arena, std::string_view key, std::string_view value,
+                      uint64_t transaction_id, int height);
+  // 一个节点在 Arena 中占用的字节数
+  static size_t alloc_size(int height, size_t key_size, size_t value_size);
+
+  Node(const Node&)            = delete;
+  Node& operator=(const Node&) = delete;
   auto  operator<=>(const Node& other) const;
+
+  std::string_view key() const { return {payload(), key_size_}; }
+  std::string_view value() const { return {payload() + key_size_, value_size_}; }
+  int              height() const { return height_; }
+  uint64_t         prefix() const { return key_prefix_; }
+  // 与 key 比较, prefix 必须是 key_prefix(key); 返回 -1 / 0 / 1
+  int compare_key(std::string_view key, uint64_t prefix) const {
+    if (key_prefix_ != prefix) {
+      return key_prefix_ < prefix ? -1 : 1;
+    }
+    constexpr size_t kPrefix = sizeof(uint64_t);
+    // 两边都不超过 8 字节: 前缀相等只可能是补 0 造成的长度差异
+    if (key_size_ <= kPrefix && key.size() <= kPrefix) {
+      return key_size_ == key.size() ? 0 : (key_size_ < key.size() ? -1 : 1);
+    }
+    // 两边都至少 8 字节: 前 8 字节已经相同, 从第 9 个字节比起
+    const size_t skip = key_size_ >= kPrefix && key.size() >= kPrefix ? kPrefix : 0;
+    auto         res  = this->key().substr(skip) <=> key.substr(skip);
+    return res < 0 ? -1 : (res > 0 ? 1 : 0);
+  }
+  size_t           size() const { return alloc_size(height_, key_size_, value_size_); }
+
+  Node* next(int level) const { return forward[level].load(std::memory_order_acquire); }
+  void  set_next(int level, Node* node) { forward[level].store(node, std::memory_order_release); }
+  bool  cas_next(int level, Node*& expected, Node* node) {
+    return forward[level].compare_exchange_strong(expected, node, std::memory_order_acq_rel,
+                                                   std::memory_order_acquire);
+  }
+  void no_barrier_set_next(int level, Node* node) {
+    forward[level].store(node, std::memory_order_relaxed);
+  }
+
+ private:
+  Node(uint64_t transaction_ids, uint64_t prefix, size_t key_size, size_t value_size, int height)
+      : transaction_id(transaction_ids),
+        key_prefix_(prefix),
+        key_size_(static_cast<uint32_t>(key_size)),
+        value_size_(static_cast<uint32_t>(value_size)),
+        height_(static_cast<uint32_t>(height)) {}
+  const char* payload() const { return reinterpret_cast<const char*>(&forward[height_]); }
+  char*       payload() { return reinterpret_cast<char*>(&forward[height_]); }
+
+  uint64_t key_prefix_;
+  uint32_t key_size_;
+  uint32_t value_size_;
+  uint32_t height_;
+  // 柔性数组: 实际长度为 height_, 由 create 按高度分配并逐个构造
+  std::atomic<Node*> forward[1];
 };
 
 bool operator==(const SkiplistIterator& lhs, const SkiplistIterator& rhs) noexcept;
@@ -58,6 +111,9 @@ class SkiplistIterator : public BaseIterator {
   uint64_t                                       get_tranc_id() const override;
   valuetype                                      getValue() const;
   std::tuple<std::string, std::string, uint64_t> get_value_tranc_id() const;
+  // 直接指向节点内存, 跳表存活期间有效
+  std::string_view key() const;
+  std::string_view value() const;
 
  private:
   Node* current;
@@ -72,90 +128,122 @@ inline int cmp(std::string_view a, std::string_view b) {
   return 0;
 }
 
-class Skiplist {
+// 并发语义:
+//   Insert / Get / Contain / get_node / 前缀查询 可以被任意多个线程同时调用,
+//   写入通过逐层 CAS 挂链, 读者从不阻塞; Delete 与移动操作需要调用方保证独占.
+// 同一个 key 的多个版本按 transaction_id 降序排列 (同 id 时后插入的在前),
+// 因此并发插入的结果与插入顺序无关.
+class Skiplist : public MemTableRep {
  public:
-  explicit Skiplist(int max_level_ = Global_::MAX_LEVEL)
-      : max_level(max_level_), current_level(1), size_bytes(0), nodecount(0), dis(0.0, 1.0) {
-    head = std::make_unique<Node>(std::string(), std::string(), 0);
-  }  // 默认最大取决FIX_LEVEL层
+  explicit Skiplist(int max_level_ = Global_::MAX_LEVEL, WriteBufferManager* wbm = nullptr)
+      : arena_(std::make_unique<Arena>(wbm)),
+        max_level(std::clamp(max_level_, 1, Global_::MAX_LEVEL)),
+        current_level(1),
+        size_bytes(0),
+        nodecount(0),
+        num_shard_(0) {
+    head = Node::create(*arena_, {}, {}, 0, Global_::MAX_LEVEL);
+  }  // 默认最大取决MAX_LEVEL层
   Skiplist(const Skiplist& other)            = delete;
   Skiplist& operator=(const Skiplist& other) = delete;
   Skiplist(Skiplist&& other) noexcept
-      : max_level(other.max_level),
-        head(std::move(other.head)),
-        current_level(other.current_level),
+      : arena_(std::move(other.arena_)),
+        head(std::exchange(other.head, nullptr)),
+        max_level(other.max_level),
+        current_level(other.current_level.load(std::memory_order_relaxed)),
         size_bytes(other.size_bytes.load()),
-        nodecount(other.nodecount.load()) {
+        nodecount(other.nodecount.load()),
+        filter_(std::move(other.filter_)) {
     num_shard_=0;
-    other.head = nullptr;
-    size_bytes.exchange(0, std::memory_order_relaxed);
-    nodecount.exchange(0, std::memory_order_relaxed);
+    other.size_bytes.exchange(0, std::memory_order_relaxed);
+    other.nodecount.exchange(0, std::memory_order_relaxed);
   }
   Skiplist& operator=(Skiplist&& other) noexcept {
-    std::ranges::swap(max_level, other.max_level);
+    std::ranges::swap(arena_, other.arena_);
     std::ranges::swap(head, other.head);
-    std::ranges::swap(current_level, other.current_level);
+    std::ranges::swap(max_level, other.max_level);
+    const int level = current_level.load(std::memory_order_relaxed);
+    current_level.store(other.current_level.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+    other.current_level.store(level, std::memory_order_relaxed);
     size_bytes.exchange(other.size_bytes, std::memory_order_relaxed);
     nodecount.exchange(other.nodecount, std::memory_order_relaxed);
+    std::ranges::swap(filter_, other.filter_);
     return *this;
   }
 
-  ~Skiplist() {
-    // Iterative cleanup to avoid stack overflow from recursive unique_ptr destruction
-    if (head) {
-      clearLinkedList();
-      head.reset();
-    }
-  }
+  // 节点都在 arena_ 里, 析构时整块归还, 不需要逐个遍历释放
+  ~Skiplist() override = default;
 
-  // Explicitly clear the linked list to prevent stack overflow
-  void clearLinkedList() {
-    if (!head)
-      return;
-
-    // Move the entire chain out of head to prevent recursive destruction
-    std::unique_ptr<Node> current = std::move(head->next_);
-    while (current) {
-      // Move next before current's destructor runs
-      std::unique_ptr<Node> next = std::move(current->next_);
-      current                    = std::move(next);
-    }
-  }
-
-  bool Insert(std::string key, std::string value, const uint64_t transaction_id = 0);
+  bool Insert(std::string_view key, std::string_view value,
+              const uint64_t transaction_id = 0) override;
+  // 按 (key 升序, tranc_id 降序) 顺序追加, 每层直接挂在上一个节点之后, 不做查找.
+  // 只用于把其他结构整体转换成跳表: 调用方保证顺序且独占, 不能与 Insert 混用
+  void Append(std::string_view key, std::string_view value, const uint64_t transaction_id);
 
   bool Delete(std::string_view key);
-  void set_num_shard(int num_shard);
-  int get_num_shard()const;
+  void set_num_shard(int num_shard) override;
+  int get_num_shard()const override;
+  Skiplist* as_skiplist() override { return this; }
+  // 按 collapser 复制成一张新跳表; 冻结时经 as_skiplist 原地使用, 不走这里
+  std::unique_ptr<Skiplist> to_skiplist(VersionCollapser* collapser = nullptr) override;
   std::optional<std::string>  Contain(std::string_view key, const uint64_t transaction_id = 0);
-  std::optional<LookupResult> Get(std::string_view key, const uint64_t transaction_id = 0);
+  std::optional<LookupResult> Get(std::string_view key,
+                                  const uint64_t   transaction_id = 0) override;
   std::vector<std::pair<std::string, std::string>> flush();
-  Node*            get_node(std::string_view key, const uint64_t transaction_id = 0);
-  std::size_t      get_size();
-  std::size_t      getnodecount();
+  Node*            get_node(std::string_view key, const uint64_t transaction_id = 0) override;
+  std::size_t      get_size() override;
+  std::size_t      memory_usage() override;
+  std::size_t      getnodecount() override;
   int              get_range_index(std::string_view key);
-  auto             seekToFirst();
-  auto             seekToLast();
+  Node*            seekToFirst();
+  Node*            seekToLast();
   SkiplistIterator end();
   SkiplistIterator begin();
   SkiplistIterator prefix_serach_begin(std::string_view key);
   SkiplistIterator prefix_serach_end(std::string_view key);
   std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
-      std::string_view prefix, uint64_t tranc_id);
+      std::string_view prefix, uint64_t tranc_id) override;
 
   void                    set_status(Global_::SkiplistStatus status);
   Global_::SkiplistStatus get_status() const;
+  // 冻结: 之后不再写入, 记下 key 范围并建一个布隆过滤器供读路径过滤;
+  // 内存从写缓冲预算的活跃部分转到不可变部分
+  void             freeze();
+  std::string_view first_key() const;
+  std::string_view last_key() const;
+  // 冻结表的 key 范围是否可能包含 key / 与 [lo, hi) 相交 (hi 为空表示无上界)
+  bool             covers(std::string_view key) const;
+  bool             overlaps(std::string_view lo, std::string_view hi) const;
+  // 点查前的快速判断: key 范围 + 布隆过滤器, 返回 false 时一定不含 key
+  bool             may_contain(std::string_view key) const;
+  // 从高层索引上近似均匀地取约 n 个不同的 key, 用于估计 key 分布
+  std::vector<std::string> sample_keys(size_t n) const;
+  // 按 collapser 丢掉没有读者能看到的旧版本, 返回精简后的新表; 没有可丢的返回 nullptr.
+  // 调用方保证此时没有并发写入
+  std::unique_ptr<Skiplist> collapse_versions(const VersionCollapser& collapser) const;
 
  private:
-  std::unique_ptr<Node>            head;
+  std::unique_ptr<Arena>           arena_;         // 节点内存, 随跳表整体释放
+  Node*                            head;
   int                              max_level;      // 最大层级
-  int                              current_level;  // 当前层级
+  std::atomic_int                  current_level;  // 当前层级, 只增不减(Delete 除外)
   std::atomic_size_t               size_bytes;     // 内存占用，达到限制flush到disk
   std::atomic_int                  nodecount;      // 节点数量
-  std::random_device               rd;             // 随机数生成器
-  static thread_local std::mt19937 gen;            // 随机数引擎
-  std::uniform_real_distribution<> dis;            // 随机数分布
-  int                               num_shard_;
+  static thread_local std::mt19937 gen;            // 随机数引擎, 每个线程一份
+  int                              num_shard_;
   Global_::SkiplistStatus cur_status = Global_::SkiplistStatus::kNormal;
+  std::string             first_key_;  // freeze 时记录
+  std::string             last_key_;
+  std::unique_ptr<BloomFilter> filter_;  // freeze 时建立, 之后只读
+  std::array<Node*, Global_::MAX_LEVEL> append_tail_{};  // Append 时每层的尾节点, 空表示 head
   int                     random_level();
+
+  // 第一个 key >= key 的节点 (同 key 的最新版本)
+  Node* find_greater_or_equal(std::string_view key) const;
+  // 在 level 层从 before 开始向后找插入位置: prev 排在 (key, tranc_id) 之前, next 不在;
+  // prefix 为 Node::key_prefix(key), 由调用方算一次
+  static void find_splice_for_level(std::string_view key, uint64_t prefix,
+                                    uint64_t transaction_id, Node* before, int level, Node** prev,
+                                    Node** next);
 };
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Arena.h"
+#include "Global.h"
+#include "MemTableRep.h"
+#include "Skiplist.h"
+
+// 只追加的向量内存表, 用于批量加载
+// 每个写线程第一次写入时领到自己的缓冲区, 之后 Insert 只是把 Arena 里的节点指针
+// 追加到这个缓冲区末尾, 不做任何排序或查找. 排序推迟到 to_skiplist: 条目多时
+// 切成若干段并行排序再归并, 然后顺序追加成跳表.
+// 读 (Get / get_node / get_prefix_range) 需要扫描全部缓冲区, 代价与条目数成正比,
+// 只用于保证导入期间偶尔的读仍然正确.
+class VectorRep : public MemTableRep {
+ public:
+  explicit VectorRep(WriteBufferManager* wbm = nullptr);
+  VectorRep(const VectorRep&)            = delete;
+  VectorRep& operator=(const VectorRep&) = delete;
+  ~VectorRep() override                  = default;
+
+  bool Insert(std::string_view key, std::string_view value,
+              const uint64_t transaction_id = 0) override;
+  std::optional<LookupResult> Get(std::string_view key,
+                                  const uint64_t   transaction_id = 0) override;
+  Node* get_node(std::string_view key, const uint64_t transaction_id = 0) override;
+  std::vector<std::tuple<std::string, std::string, uint64_t>> get_prefix_range(
+      std::string_view prefix, uint64_t tranc_id) override;
+  std::size_t get_size() override;
+  std::size_t memory_usage() override;
+  std::size_t getnodecount() override;
+  void        set_num_shard(int num_shard) override;
+  int         get_num_shard() const override;
+
+  std::unique_ptr<Skiplist> to_skiplist(VersionCollapser* collapser = nullptr) override;
+
+ private:
+  // 只有所属线程追加; mutex 只在读者扫描时才会有竞争
+  struct ThreadBuffer {
+    std::thread::id    owner;
+    std::mutex         mutex;
+    std::vector<Node*> nodes;
+  };
+
+  ThreadBuffer& local_buffer();
+  // 可见版本中最新的那个: tranc_id 最大, 相同时取后追加的
+  Node* find_visible(std::string_view key, uint64_t transaction_id);
+
+  const uint64_t                       id_;  // 线程本地缓存用它区分不同的 VectorRep
+  std::unique_ptr<Arena>               arena_;
+  std::mutex                           buffers_mutex_;
+  std::list<ThreadBuffer>              buffers_;  // 地址稳定, 线程本地缓存直接存指针
+  std::atomic_size_t                   size_bytes_;
+  std::atomic_size_t                   nodecount_;
+  int                                  num_shard_;
+};
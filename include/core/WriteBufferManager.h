@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include "Global.h"
+
+// 全局写缓冲预算
+// 所有分片的活跃表、冻结但还没落盘的表 (以及可选的 block cache) 共用一个内存预算.
+// 内存按 Arena 实际向系统申请的字节记账, 由 AllocTracker 在表的生命周期里
+// 依次调用 reserve_mem (分配) -> schedule_free_mem (冻结) -> free_mem (析构).
+// should_flush 为真时由 MemTable 挑一个最大的活跃分片冻结.
+class WriteBufferManager {
+ public:
+  using UsageProbe = std::function<size_t()>;
+
+  explicit WriteBufferManager(size_t buffer_size = Global_::WRITE_BUFFER_SIZE);
+  WriteBufferManager(const WriteBufferManager&)            = delete;
+  WriteBufferManager& operator=(const WriteBufferManager&) = delete;
+
+  // 让 block cache 的占用也计入预算; 在开始写入之前调用
+  void set_block_cache_usage(UsageProbe probe);
+
+  void reserve_mem(size_t bytes);        // 活跃表新分配的内存
+  void schedule_free_mem(size_t bytes);  // 表冻结, 这部分内存不再属于活跃表
+  void free_mem(size_t bytes);           // 表析构, 内存归还
+
+  size_t buffer_size() const;
+  // 内存表总占用 (活跃 + 冻结), 加上计入预算的 block cache
+  size_t memory_usage() const;
+  size_t memtable_memory_usage() const;
+  size_t mutable_memtable_memory_usage() const;
+  // 活跃表超过预算的 7/8, 或者总量超预算且活跃表至少占一半时需要冻结;
+  // 活跃表太少时冻结也腾不出多少内存, 交给 flush 和写入反压处理
+  bool should_flush() const;
+
+ private:
+  size_t                      buffer_size_;
+  size_t                      mutable_limit_;
+  UsageProbe                  cache_usage_;
+  std::atomic_size_t          memory_used_;    // 所有内存表
+  std::atomic_size_t          memory_active_;  // 其中活跃表的部分
+};
+
+// 一个 Arena 在 WriteBufferManager 里的账目; wbm 为空时什么都不做
+class AllocTracker {
+ public:
+  explicit AllocTracker(WriteBufferManager* wbm);
+  AllocTracker(const AllocTracker&)            = delete;
+  AllocTracker& operator=(const AllocTracker&) = delete;
+  ~AllocTracker();
+
+  void allocate(size_t bytes);
+  // 表冻结后调用, 之后的分配 (很少) 直接算作不可变内存; 调用方保证不与 allocate 并发
+  void done_allocating();
+  WriteBufferManager* write_buffer_manager() const { return wbm_; }
+
+ private:
+  WriteBufferManager* wbm_;
+  std::atomic_size_t  bytes_;
+  std::atomic_bool    done_;
+};
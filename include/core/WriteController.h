@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include "Global.h"
+
+// 决定写入是否需要减速/停写的几个指标, 由引擎提供
+struct WriteStallInputs {
+  size_t imm_bytes                = 0;  // 冻结但还没落盘的跳表字节数
+  size_t l0_files                 = 0;  // L0 SST 个数
+  size_t pending_compaction_bytes = 0;  // 估算的待压缩字节数
+};
+
+struct WriteStallStats {
+  uint64_t delayed_writes = 0;  // 被减速过的写入次数
+  uint64_t stopped_writes = 0;  // 被停写过的写入次数
+  uint64_t delay_micros   = 0;  // 减速累计睡眠时间
+  uint64_t stop_micros    = 0;  // 停写累计等待时间
+};
+
+enum class WriteStallState : uint8_t {
+  kNormal,
+  kDelayed,
+  kStopped,
+};
+
+// 写入反压
+// 每个指标有 slowdown / stop 两个阈值. 任一指标超过 stop 时写入阻塞, 直到后台
+// flush / compaction 把它降下来; 介于两者之间时按令牌桶限速, 指标越接近 stop
+// 允许的写入速率越低, 从而平滑地把写入压到后台处理得过来的速度, 而不是硬停.
+class WriteController {
+ public:
+  using Probe = std::function<WriteStallInputs()>;
+
+  explicit WriteController(Probe probe);
+  WriteController(const WriteController&)            = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // 写入前调用, write_bytes 是本次写入的 key+value 字节数; 需要时在这里睡眠或阻塞
+  void maybe_stall(size_t write_bytes);
+  // 后台 flush / compaction 完成后调用, 唤醒停写的写者重新评估
+  void notify();
+
+  WriteStallState state() const;
+  WriteStallStats stats() const;
+
+  // 0 表示不需要减速, (0, 1) 表示减速程度, >= 1 表示需要停写
+  static double severity(const WriteStallInputs& inputs);
+
+ private:
+  std::chrono::microseconds reserve_delay(size_t write_bytes, double sev);
+
+  Probe                                 probe_;
+  std::mutex                            mutex_;
+  std::condition_variable               cv_;
+  std::chrono::steady_clock::time_point next_write_;  // 令牌桶: 下一次写入最早的时刻
+  std::atomic<WriteStallState>          state_;
+  std::atomic_uint64_t                  delayed_writes_;
+  std::atomic_uint64_t                  stopped_writes_;
+  std::atomic_uint64_t                  delay_micros_;
+  std::atomic_uint64_t                  stop_micros_;
+};
@@ -1,15 +1,22 @@
 #pragma once
 #include "Global.h"
+#include "MemTableRep.h"
 #include "Skiplist.h"
+#include "WriteBufferManager.h"
+#include "../utils/ReadEpoch.h"
 #include <array>
 #include <atomic>
 #include <cstddef>
+#include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
 #include <shared_mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 class MemTableIterator;
 bool operator==(const MemTableIterator& lhs, const MemTableIterator& rhs) noexcept;
@@ -56,7 +63,10 @@ class MemTable {
   friend class LSM_Engine;
 
  public:
-  MemTable();
+  // wbm 为空时使用自己的 WriteBufferManager (预算 WRITE_BUFFER_SIZE)
+  explicit MemTable(Global_::MemTableShardMode          mode = Global_::MEMTABLE_SHARD_MODE,
+                    Global_::MemTableRepType            rep  = Global_::MEMTABLE_REP,
+                    std::shared_ptr<WriteBufferManager> wbm  = nullptr);
   MemTable(const MemTable& other)            = delete;
   MemTable& operator=(const MemTable& other) = delete;
   ~MemTable()                                = default;
@@ -80,11 +90,19 @@ class MemTable {
   size_t get_cur_size();
   size_t get_fixed_size();
   size_t get_total_size();
+  // 全部内存表实际占用的字节数 (活跃 + 冻结)
+  size_t get_memory_usage() const;
+  const std::shared_ptr<WriteBufferManager>& write_buffer_manager() const;
   void   remove(std::string key, const uint64_t transaction_id = 0);
   void   remove_mutex(std::string key, const uint64_t transaction_id = 0);
   void   remove_batch(const std::vector<std::string>& key_pairs, const uint64_t transaction_id = 0);
   bool   IsFull(size_t target=0);
   std::unique_ptr<Skiplist>            flushtodisk();
+  // flush 任务认领所有还没被认领的冻结表 (从旧到新), 状态改为 kFlushing.
+  // 表仍留在 fixed_tables 里继续服务读请求, SST 安装完成后再 release
+  std::vector<Skiplist*> claim_frozen_tables();
+  void                   release_flushed_tables(const std::vector<Skiplist*>& tables);
+  bool                   has_unclaimed_frozen() const;
   std::list<std::unique_ptr<Skiplist>>            flush();
   std::list<std::unique_ptr<Skiplist>> flushsync();
   bool                                 frozen_cur_table(bool force = false,size_t target=0);
@@ -94,12 +112,86 @@ class MemTable {
 
   // Debug: Get actual node counts for each shard
   std::vector<size_t> getShardNodeCounts() const;
+  Global_::MemTableShardMode shard_mode() const;
+  Global_::MemTableRepType   rep_type() const;
+  // 冻结时用来回收旧版本的回收器来源 (存活快照和正在进行的读); 不设置时保留全部版本
+  using SnapshotSource = std::function<VersionCollapser()>;
+  void   set_snapshot_source(SnapshotSource source);
+  // 冻结时丢掉的版本数
+  size_t collapsed_versions() const;
+  // 范围分片模式下 key 当前所属的分片; 哈希模式等同 fast_hash
+  size_t shard_of(std::string_view key) const;
 
  private:
-  std::array<std::unique_ptr<Skiplist>, Global_::NUMS_SHARDS> current_table;  // 活跃 SkipList
-  std::list<std::unique_ptr<Skiplist>> fixed_tables;  // 不可写的 SkipList==InmutTable
+  // key 前缀按大端拼成的两个 uint64, 其字典序与 key 前 16 字节的字典序一致
+  using RangeBound = std::pair<uint64_t, uint64_t>;
+  static RangeBound make_bound(std::string_view key);
+  // key 所在的分片号和它的活跃表, 调用方已经 pin 住 epoch_.
+  // 范围模式下取到表后复查路由: 换表先改分界再发布新表, 拿到新表时一定能看到新分界
+  size_t route(std::string_view key, MemTableRep*& table) const;
+  // 换上新的活跃表并把旧表挂进 fixed_tables; 调用方持有该分片的 cur_lock_.
+  // 返回旧表, 调用方放开锁、等 epoch_ 上的写者退出以后再 seal_retired
+  MemTableRep* swap_active(size_t index);
+  // 范围模式的换表: 拿全部分片的换表锁, 一起换下并启用上一轮估计出的分界 (next_bounds_)
+  bool rotate_all(bool force, size_t target, bool budget = false);
+  // (key, 它代表的字节数) 样本, 用来估计 key 分布
+  using KeySamples = std::vector<std::pair<std::string, double>>;
+  static void sample(Skiplist& table, KeySamples& samples);
+  // 按样本取累计字节数的 NUMS_SHARDS 等分点, 存进 next_bounds_ 供下一次换表启用
+  void rebalance(KeySamples samples);
+  // 写入后检查: 分片超过单表上限就冻结它, 否则超过全局预算时冻结最大的活跃分片
+  void maybe_freeze(size_t index);
+  bool freeze_largest();
+  // 冻结 target 分片; budget 为真时按全局预算判断, 否则按单表上限判断
+  bool freeze_shard(size_t target, bool budget);
+  // 按 rep_ 新建分片 index 的活跃表
+  std::unique_ptr<MemTableRep> new_rep(size_t index) const;
+  // 活跃表转成冻结用的跳表, 顺带回收没有读者能看到的旧版本; 调用方保证没有并发写入.
+  // rep 本身是跳表且没有可回收的版本时返回 nullptr, 原样使用即可
+  std::unique_ptr<Skiplist> convert(MemTableRep& rep);
+  // 同上, 但拿走 rep, 总是返回跳表
+  std::unique_ptr<Skiplist> seal(std::unique_ptr<MemTableRep> rep);
+  // 换下来的活跃表原样挂到 fixed_tables 尾部, 调用方持有该分片的 cur_lock_.
+  // 转换和回收旧版本都不在锁内做, 放开分片锁以后再调 seal_retired
+  MemTableRep* retire(std::unique_ptr<MemTableRep> rep);
+  // 封存 retire 挂上的表: 转换、回收旧版本、建布隆过滤器, 再换进它在 fixed_tables 的位置;
+  // samples 非空时顺带取样
+  void seal_retired(MemTableRep* rep, KeySamples* samples = nullptr);
+  // 重算 unclaimed_tables_; 调用方持有 fix_lock_ 独占锁
+  void count_claimable();
+
+  // 冻结表. 换表时先原样挂上 rep, 封存后换成 table; 读请求两种都能查,
+  // flush 只认领封存好的表, 并且按冻结顺序认领, 遇到没封存的就停下
+  struct FrozenTable {
+    std::unique_ptr<MemTableRep> rep;    // 封存前: 换下来的活跃表, 已不再写入
+    std::unique_ptr<Skiplist>    table;  // 封存后
+    // 计入 fixed_bytes 的字节数. 挂上时可能还有写者没退出, rep 之后还会变大, 只能按记下的数扣
+    size_t                       bytes = 0;
+    MemTableRep* readable() const {
+      return table ? static_cast<MemTableRep*>(table.get()) : rep.get();
+    }
+  };
+
+  Global_::MemTableShardMode mode_;
+  Global_::MemTableRepType   rep_;
+  // 先于各张表构造, 后于它们析构: 表析构时要向它归还内存
+  std::shared_ptr<WriteBufferManager> wbm_;
+  SnapshotSource             snapshot_source_;  // 只在构造后设置一次
+  std::atomic_size_t         collapsed_versions_{0};
+  // 范围分片的分界, 只在持有全部分片的 cur_lock_ 时修改; 路由时无锁读取, 取到活跃表后复查
+  std::array<std::array<std::atomic_uint64_t, 2>, Global_::NUMS_SHARDS - 1> bounds_;
+  std::array<std::unique_ptr<MemTableRep>, Global_::NUMS_SHARDS> current_table;  // 活跃表, 换表时改
+  // 读写路径不拿锁: pin 住 epoch_ 后从这里取活跃表. 换表换掉指针后 synchronize,
+  // 之后旧表上不再有写者, 才能封存
+  std::array<std::atomic<MemTableRep*>, Global_::NUMS_SHARDS> active_;
+  mutable ReadEpoch                                           epoch_;
+  std::list<FrozenTable>               fixed_tables;  // 不可写的 SkipList==InmutTable, 从旧到新
   std::atomic_size_t                   fixed_bytes;   // fixed_tables的跳表的大小
+  // 可以马上认领的冻结表数: 封存好、还没被认领, 且前面没有未封存的表
+  std::atomic_size_t                   unclaimed_tables_;
+  // 范围分片下一次换表时启用的分界, 由上一轮封存好的表估计; 受 fix_lock_ 保护
+  std::optional<std::array<RangeBound, Global_::NUMS_SHARDS - 1>> next_bounds_;
   std::shared_mutex                    fix_lock_;
-  std::array<std::shared_mutex, Global_::NUMS_SHARDS> cur_lock_;   // 保护当前跳表的锁
+  std::array<std::mutex, Global_::NUMS_SHARDS> cur_lock_;  // 只在换表时持有, 串行化同一分片的换表
   std::atomic<Global_::SkiplistStatus>                cur_status;  // 当前跳表的状态
 };
\ No newline at end of file
@@ -41,7 +41,8 @@ class BlockIterator {
   std::shared_ptr<Block> get_block() const;
 
  private:
-  void update_current();
+  // prev_key: 上一条 (current_index - 1) 的 key, 有的话在它基础上拼出当前 key
+  void update_current(std::string* prev_key = nullptr);
 
  private:
   std::shared_ptr<Block>    block;          // 指向所属的 Block
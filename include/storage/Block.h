@@ -1,6 +1,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <utility>
@@ -8,14 +9,39 @@
 #include "../../include/core/Global.h"
 
 class BlockIterator;
+
+// Block 编码格式 (little-endian), 末尾可选 hash(u32): kFormatLegacy 是截断的 std::hash,
+// 其余格式是掩码后的 crc32c
+//   kFormatPrefix (新写入的 block):
+//     entry*   : shared(u16) unshared(u16) key[shared:](unshared) value_len(u16) value tranc_id(u64)
+//                key 只存与上一条 key 不同的后缀; 每 restart_interval 条是一个重启点,
+//                重启点 shared == 0, 存完整 key
+//     trailer  : num_entries(u16) restart_interval(u16) version(u8) marker(u16 = 0xFFFF)
+//   kFormatPrefixHash: 同 kFormatPrefix, entry 之后、trailer 之前多一段哈希索引
+//     index    : bucket(u8 * num_buckets) num_buckets(u16)
+//                bucket = crc32c(key) % num_buckets 所在 key 第一次出现的重启点编号,
+//                kBucketEmpty 表示没有 key 落在这个桶, kBucketCollision 表示多个重启点的 key 冲突
+//   kFormatLegacy (旧 block, 只读):
+//     entry*   : key_len(u16) key value_len(u16) value tranc_id(u64)
+//     trailer  : offsets(u16 * num) num(u16)
+// 旧格式的 num 不可能是 0xFFFF, 据此区分两种格式.
+// 解码时顺序扫描一遍重建每条 entry 的偏移, 重启点 k 就是第 k * restart_interval 条;
+// 查找先在重启点上二分 (完整 key, 不用拼接), 再在一个区间内顺序解码;
+// 有哈希索引时点查一次探测就定位到重启点区间, 或直接确定 key 不在 block 里.
 class Block : public std::enable_shared_from_this<Block> {
  public:
   friend class BlockIterator;
+  static constexpr uint8_t kFormatLegacy = 1;
+  static constexpr uint8_t kFormatPrefix = 2;
+  static constexpr uint8_t kFormatPrefixHash = 3;
+
   Block();
   explicit Block(std::size_t capacity);
   std::vector<uint8_t> encode(bool with_hash = true);
 
-  static std::shared_ptr<Block> decode(const std::vector<uint8_t>& encoded, bool with_hash = true);
+  // verify_checksum 为 false 时跳过校验和, 只做格式检查
+  static std::shared_ptr<Block> decode(const std::vector<uint8_t>& encoded, bool with_hash = true,
+                                       bool verify_checksum = true);
   std::string                   get_first_key();
   std::optional<std::pair<size_t, size_t>> get_offset_binary(std::string_view key,
                                                              const uint64_t   tranc_id = 0);
@@ -33,7 +59,7 @@ class Block : public std::enable_shared_from_this<Block> {
                                                                    const uint64_t   tranc_id = 0);
   bool                                                 KeyExists(std::string_view key);
   std::pair<std::string, std::string>                  get_first_and_last_key();
-  bool          add_entry(const std::string& key, const std::string& value, const uint64_t tranc_id,
+  bool          add_entry(std::string_view key, std::string_view value, const uint64_t tranc_id,
                           bool force_write = false);
   bool          is_empty() const;
   void          print_debug() const;
@@ -49,12 +75,39 @@ class Block : public std::enable_shared_from_this<Block> {
   std::vector<uint8_t>  Data_;
   std::vector<uint16_t> Offset_;
   std::size_t           capcity;
+  uint8_t               version_          = kFormatPrefix;
+  std::size_t           restart_interval_ = Global_::BLOCK_RESTART_INTERVAL;  // legacy 为 1
+  std::string           last_key_;        // add_entry 写入的上一条 key, 前缀压缩用
+  bool                  has_last_key_ = false;
+  std::size_t           distinct_keys_ = 0;  // 决定哈希索引的桶数
+  std::vector<uint8_t>  hash_buckets_;       // decode 出来的哈希索引, 空表示没有
   struct Entry {
     std::string    key;
     std::string    value;
     const uint64_t tranc_id;
   };
-  std::string_view                                     get_key_view(const std::size_t offset)const;
+  // 一条 entry 的原始字段; legacy 格式 shared 恒为 0, delta 即完整 key
+  struct EntryView {
+    uint16_t         shared;
+    std::string_view delta;
+    std::string_view value;
+    uint64_t         tranc_id;
+    std::size_t      size;  // entry 编码后的字节数
+  };
+  EntryView parse_entry(std::size_t offset) const;
+  // key 里须是第 index - 1 条的 key (index 是重启点时无所谓), 就地改成第 index 条的 key
+  void             append_key(std::size_t index, std::string& key) const;
+  std::string      get_key_at(std::size_t index) const;
+  std::string_view restart_key(std::size_t restart) const;
+  std::size_t      index_of(std::size_t offset) const;
+  // 有 entries 条、distinct 个不同 key 时哈希索引的桶数, 0 表示不带索引
+  std::size_t      hash_bucket_count(std::size_t entries, std::size_t distinct) const;
+  // 用哈希索引找 key 第一次出现的下标, 不拼接 key 也不分配内存; key 不存在时返回
+  // Offset_.size(), 没有索引或桶冲突时返回 nullopt (需要走二分)
+  std::optional<std::size_t> hash_seek(std::string_view key) const;
+  // 第一个使 pred(key) 为 false 的下标 (pred 在 key 有序时先真后假); key_out 收到该条的 key
+  template <class Pred>
+  std::size_t partition_index(Pred pred, std::string* key_out = nullptr) const;
   std::optional<std::pair<std::string, uint64_t>> get_value(const std::size_t offset) const;
   std::shared_ptr<Block::Entry>                        get_entry(std::size_t offset);
 };
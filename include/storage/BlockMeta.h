@@ -2,8 +2,14 @@
 #include <vector>
 #include <cstdint>
 
+// 编码: num(size_t) [offset(size_t) first_key_len(u16) first_key last_key_len(u16) last_key]* hash(u32)
+// num 的最高字节是格式版本: kFormatLegacy (改用 crc32c 之前写的, hash 为截断的 std::hash,
+// 当时这个字节总是 0) 或 kFormatCrc32c (hash 为掩码后的 crc32c)
 class BlockMeta {
  public:
+  static constexpr uint8_t kFormatLegacy = 0;
+  static constexpr uint8_t kFormatCrc32c = 1;
+
   BlockMeta();
   BlockMeta(std::string first_key, std::string last_key, size_t offset);
   static std::vector<uint8_t>   encode_meta_to_slice(std::vector<BlockMeta>& meta);
@@ -51,6 +51,8 @@ class BlockCache {
 
   // 获取缓存命中率
   double hit_rate() const;
+  // 缓存中 block 的数据字节数
+  size_t memory_usage() const;
 
  private:
   size_t             capacity_;  // 缓存容量
@@ -67,8 +69,11 @@ class BlockCache {
 
   // 更新缓存项的访问时间戳
   void update_access_count(std::list<CacheItem>::iterator it);
+  // 按 block 的数据大小记账 (调用方持有 mutex_)
+  static size_t charge_of(const std::shared_ptr<Block>& block);
 
   // 记录请求数和命中数
   std::atomic<std::size_t> total_requests = 0;
   std::atomic<std::size_t> hits_requests  = 0;
+  std::atomic<std::size_t> charge_bytes_  = 0;
 };
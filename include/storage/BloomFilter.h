@@ -18,7 +18,10 @@ public:
 
     void clear() noexcept;
 
-    // 序列化：磁盘格式与旧版完全兼容
+    // 序列化：末尾带 checksum；没有 checksum 的旧格式照样能 decode.
+    // 格式版本存在 expected_elements_ 字段的最高字节, 旧格式是 0
+    static constexpr uint8_t kFormatLegacy = 0;
+    static constexpr uint8_t kFormatCrc32c = 1;
     size_t               encode_size() const noexcept;
     size_t               encode_into(uint8_t* dst) const;
     std::vector<uint8_t> encode() const;
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// 轻量 LZ77 编解码 (LZ4 风格的块格式, 无外部依赖), 目前给 WAL 记录压缩用.
+// 压缩流由若干 sequence 组成:
+//   token u8        : 高 4 位字面量长度, 低 4 位匹配长度 - 4; 取 15 时后面跟扩展字节,
+//                     每个扩展字节累加, 遇到不是 255 的字节结束
+//   literals        : 字面量
+//   offset u16 (LE) : 匹配起点相对当前位置的回退距离, 1..65535
+// 最后一个 sequence 只有字面量, 没有 offset. 解压方必须预先知道原始长度.
+namespace Lz {
+
+inline constexpr size_t kMaxOffset = 65535;
+
+// 单独压缩一段数据, 结果追加到 out 末尾
+void compress(std::span<const uint8_t> src, std::vector<uint8_t>& out);
+
+// 解压到 out (大小调整为 raw_size); 输入损坏或长度对不上时返回 false
+bool decompress(std::span<const uint8_t> src, size_t raw_size, std::vector<uint8_t>& out);
+
+// 流式压缩: 一条记录可以引用之前 commit 过的记录 (最多回退 kMaxOffset 字节),
+// 短记录之间的重复也能压掉. 解压方必须按同样的顺序解压同样的那些记录.
+class Encoder {
+ public:
+  Encoder();
+
+  // 以之前 commit 的记录为字典压缩 src, 结果追加到 out
+  void compress(std::span<const uint8_t> src, std::vector<uint8_t>& out);
+  // 把最近一次 compress 的记录留作后续记录的字典; 不调用就当它没压缩过
+  void commit();
+  void reset();
+
+ private:
+  std::vector<uint8_t>  window_;  // [0, committed_) 是字典, 之后是正在压缩的记录
+  size_t                committed_{0};
+  std::vector<uint32_t> table_;   // 4 字节哈希 -> window_ 中的位置 + 1
+};
+
+class Decoder {
+ public:
+  // 解压一条由 Encoder 压缩并 commit 的记录; 返回的数据在下次调用前有效
+  std::optional<std::span<const uint8_t>> decompress(std::span<const uint8_t> src,
+                                                      size_t                   raw_size);
+  void reset();
+
+ private:
+  std::vector<uint8_t> history_;  // 解压过的记录, 末尾 kMaxOffset 字节是字典
+};
+
+}  // namespace Lz
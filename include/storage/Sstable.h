@@ -13,6 +13,15 @@
 #include "file.h"
 
 class SstIterator;
+
+// 读路径的选项, 由 LSM::get / get_batch 一路传到 Sstable::read_block.
+//   verify_checksums: block 不在 block cache 里、从文件 (多半是页缓存) 读出时校验 checksum;
+//                     反复读热点数据又信任存储时可以关掉, 省掉每次整块的 crc 计算.
+//                     关掉时读出的 block 不放进 block cache, 缓存里的 block 都是校验过的
+struct ReadOptions {
+  bool verify_checksums = Global_::VERIFY_CHECKSUMS_ON_READ;
+};
+
 class Sstable : public std::enable_shared_from_this<Sstable> {
   friend class Sstbuild;
 
@@ -26,7 +35,7 @@ class Sstable : public std::enable_shared_from_this<Sstable> {
                                                                 const std::string&          first_key,
                                                                 const std::string&          last_key,
                                                                 std::shared_ptr<BlockCache> block_cache);
-  std::shared_ptr<Block>              read_block(size_t block_idx);
+  std::shared_ptr<Block>              read_block(size_t block_idx, const ReadOptions& options = {});
   std::optional<size_t>               find_block_idx(std::string_view key, bool is_prefix = false);
   std::vector<std::shared_ptr<Block>> find_block_range(std::string_view key_prefix);
   size_t                              num_blocks() const;
@@ -36,7 +45,8 @@ class Sstable : public std::enable_shared_from_this<Sstable> {
   std::string                         get_last_key() const;
   std::tuple<std::string, std::string, uint64_t> getValue() const;
   bool                                           is_block_index_vaild(size_t block_index) const;
-  std::optional<std::pair<std::string, uint64_t>> KeyExists(std::string_view key, uint64_t);
+  std::optional<std::pair<std::string, uint64_t>> KeyExists(std::string_view key, uint64_t,
+                                                            const ReadOptions& options = {});
   SstIterator get_Iterator(std::string_view key, uint64_t tranc_id = 0, bool is_prefix = false);
   SstIterator current_Iterator(size_t block_idx, uint64_t tranc_id = 0);
   SstIterator begin(uint64_t tranc_id);
@@ -68,7 +78,7 @@ class Sstbuild {
  public:
   Sstbuild(size_t block_size);
   void   clean();
-  void   add(const std::string& key, const std::string& value, uint64_t tranc_id = 0);
+  void   add(std::string_view key, std::string_view value, uint64_t tranc_id = 0);
   void   finish_block();
   size_t estimated_size() const;
   std::shared_ptr<Sstable> build(std::shared_ptr<BlockCache> block_cache,
@@ -55,10 +55,21 @@ class FileObj {
   // 写入到文件
   bool write(size_t offset, std::vector<uint8_t>& buf);
 
+  // 一次 pwritev 把多段缓冲写到 offset 起的连续位置
+  bool writev(size_t offset, std::span<const std::span<const uint8_t>> bufs);
+
   // 追加写入到文件
   bool append(std::vector<uint8_t>& buf);
 
   bool sync();
+  // 只刷数据 (fdatasync)
+  bool sync_data();
+  // 预分配 size 字节, 文件大小随之变为 size
+  bool allocate(size_t size);
+  // 重命名, 文件保持打开
+  bool rename(const std::string& new_path);
+  // fsync 目录, 目录项 (新建 / 重命名的文件) 随之落盘
+  static bool sync_dir(const std::string& dir);
   bool is_open();
   void close();
 
@@ -1,6 +1,8 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -36,7 +38,14 @@ class StdFile {
   void                 close();
   size_t               size() const;
   bool                 write(size_t offset, const void* data, size_t size);
+  // pwritev: 把 bufs 依次写到 offset 起的连续位置
+  bool                 writev(size_t offset, std::span<const std::span<const uint8_t>> bufs);
   bool                 sync();
+  bool                 sync_data();  // fdatasync: 只刷数据, 文件大小不变时不写元数据
+  bool                 allocate(size_t size);  // 预分配 [0, size) 的磁盘空间
+  bool                 rename(const std::string& new_filename);
+  // fsync 目录本身, 让其中文件的创建 / 重命名落盘
+  static bool          sync_dir(const std::string& dir);
   bool                 remove();
 
  private:
@@ -1,12 +1,17 @@
 #pragma once
 #include "file.h"
+#include "Lz.h"
 #include "../core/Global.h"
+#include "../utils/MpscRing.h"
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
 #include <expected>
+#include <functional>
+#include <future>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <span>
 #include <string>
@@ -36,42 +41,125 @@ struct WalEntry {
   uint64_t    tranc_id{0};
 };
 
+// What the write path takes: a view of key and value that must stay valid
+// until log() / log_batch() returns.  Records are encoded from it straight
+// into the WAL's block buffers, so callers need not build WalEntry copies.
+struct WalEntryRef {
+  std::string_view key;
+  std::string_view value;
+  uint64_t         tranc_id{0};
+
+  WalEntryRef(std::string_view k, std::string_view v, uint64_t id)
+      : key(k), value(v), tranc_id(id) {}
+  WalEntryRef(const WalEntry& e) : key(e.key), value(e.value), tranc_id(e.tranc_id) {}
+};
+
+// ─── Write options ────────────────────────────────────────────────────────────
+// Per-call durability, passed down from LSM::put / put_batch / remove.
+//   sync        – return only after the WAL record is fsync'd.  Concurrent
+//                 sync writers share one fsync (group commit).
+//   no sync     – the record reaches the OS page cache; survives a process
+//                 crash but not a machine crash.
+//   disable_wal – skip the WAL; the write is lost on any crash until its
+//                 memtable is flushed.
+struct WriteOptions {
+  bool sync        = Global_::WAL_SYNC_ON_WRITE;
+  bool disable_wal = false;
+};
+
 // ─── WAL ──────────────────────────────────────────────────────────────────────
 //
+//  Segments: wal.<log_number>, log numbers strictly increasing.
+//
+//    Every segment is fallocate'd to WAL_FILE_LIMIT when created, so appends
+//    only overwrite already-allocated blocks and fdatasync never has to
+//    journal a size change.  A new WAL object always starts a new segment;
+//    older ones are only read by recover() and later retired by the cleaner.
+//    Retired segments (every tranc_id checkpointed) are renamed to
+//    recycled_wal.<n> and reused for the next rotation instead of being
+//    deleted and re-created, up to WAL_RECYCLE_SEGMENTS of them.
+//
+//    Block 0 is the segment header:
+//      magic u32 | version u32 | log_number u64 | logical_end u64 |
+//      min_tranc_id u64 | max_tranc_id u64 | flags u32 | crc32c u32
+//    logical_end and the tranc_id range are rewritten after each fsync and
+//    ride along with the next one, so they never run ahead of durable data.
+//    When a segment is closed (rotation or shutdown) the header is written
+//    once more with the sealed flag: from then on its range is final and the
+//    cleaner and replay() can judge the segment without reading its records.
+//    Only segments left unsealed by a crash are still scanned.  Records
+//    follow from block 1 on; what lies beyond the last record is
+//    preallocated zeros or, in a recycled segment, stale records from its
+//    previous life.
+//
 //  Physical format: LevelDB-style 32 KB blocks.
 //
 //    Block layout:
-//      [record]* [padding to block boundary]
+//      [record]* [zeroed tail < header size]
 //
-//    Record header (7 bytes):
-//      masked_crc32c : uint32  (covers type + data)
+//    Record header (11 bytes, RocksDB "recyclable" layout):
+//      masked_crc32c : uint32  (covers type + log_number + data)
 //      length        : uint16
-//      type          : uint8   (kFull | kFirst | kMiddle | kLast)
+//      type          : uint8   (kFull | kFirst | kMiddle | kLast,
+//                                 | kCompressed on every fragment of an LZ
+//                                 compressed entry)
+//      log_number    : uint32  (low 32 bits of the segment's log number)
+//
+//    Recovery reads a segment up to the first record that is zero, torn,
+//    fails its CRC, or carries another log number – the logical end.  Below
+//    the header's logical_end such a record is reported as corruption
+//    instead.  Large entries are split across blocks; per RocksDB issue
+//    #12488 an incomplete kFirst/kMiddle sequence at the logical end is
+//    discarded rather than silently accepted.
 //
-//    Large entries are split across blocks.  The type field lets recovery
-//    detect "clean truncation" per RocksDB issue #12488 – an incomplete
-//    kFirst/kMiddle sequence has no matching kLast and is discarded on
-//    recovery rather than silently accepted.
+//  Compression (WalCompression::kLz):
+//    An entry payload of at least WAL_COMPRESS_MIN_BYTES is LZ-compressed
+//    (storage/Lz.h) before it is split into fragments and stored as
+//      raw_length u32 | lz stream
+//    when that saves at least an eighth; otherwise it is written raw.  The
+//    stream may refer back into earlier compressed payloads of the same
+//    segment (up to 64 KB), so short entries compress against each other;
+//    recovery reads a segment front to back and rebuilds the same history.
+//    The flag lives in each record's type byte, so a segment may mix both
+//    kinds and segments written without compression read exactly as before.
 //
 //  Concurrency:
-//    kPipelined  – writers form a group; the leader writes WAL for the whole
-//                  batch, fsyncs, then releases write_mutex_.  The next group
-//                  can start WAL immediately while the previous group writes
-//                  MemTable in parallel.
+//    Sync writes always go through the write group: writers enqueue, whoever
+//    gets write_mutex_ becomes leader, appends every queued writer's entries
+//    and issues ONE fsync if any of them asked for sync.  Writers arriving
+//    during that fsync queue up and form the next group, so the number of
+//    fsyncs grows with time, not with the number of concurrent writers.
+//    Buffered writes follow WAL_WRITE_POLICY:
+//    kPipelined  – they join the write group as well.
 //    kUnordered  – each writer independently holds write_mutex_ for its own
-//                  entry only; no grouping overhead.
+//                  entries only; no grouping overhead.
+//
+//    Either way everything written under one write_mutex_ hold is encoded
+//    from the callers' key / value views into reusable 32 KB buffers, one
+//    per file block, and reaches the file with a single pwritev.
 //
 //  log_batch():
-//    Bypasses the pipelining mechanism and holds write_mutex_ for the entire
-//    span of entries, issuing exactly one fsync at the end.  This is the
-//    preferred path for put_batch / remove_batch where all entries share one
-//    transaction-id and must be atomically durable.
+//    All entries of one call are appended back to back under one
+//    write_mutex_ hold, so a batch is never interleaved with other writers
+//    and needs at most one fsync.  Given an id allocator, the leader stamps
+//    the group's batches with consecutive tranc_ids taken in one fetch_add,
+//    so ids follow log order and the shared counter is touched once per
+//    group rather than once per writer.
+//
+//  log_async():
+//    Producers move their entries into a lock-free MPSC ring and get a
+//    future back without touching write_mutex_.  A dedicated writer thread
+//    drains whatever has accumulated, writes it as one write group (one
+//    pwrite, at most one fsync) and fulfils the futures.  The thread sleeps
+//    on an atomic wait while the ring is empty, so a busy producer pays no
+//    context switch per entry.
 // ─────────────────────────────────────────────────────────────────────────────
 class WAL {
  public:
   WAL(std::string_view log_dir, uint64_t checkpoint_tranc_id,
-               uint64_t clean_interval_s = Global_::WAL_CLEAN_INTERVAL_S,
-               uint64_t file_size_limit  = Global_::WAL_FILE_LIMIT);
+               uint64_t                clean_interval_s = Global_::WAL_CLEAN_INTERVAL_S,
+               uint64_t                file_size_limit  = Global_::WAL_FILE_LIMIT,
+               Global_::WalCompression compression      = Global_::WAL_COMPRESSION);
   ~WAL();
 
   WAL(const WAL&)            = delete;
@@ -79,21 +167,54 @@ class WAL {
   WAL(WAL&&)                 = delete;
   WAL& operator=(WAL&&)      = delete;
 
+  // Receives every recovered entry; see replay().
+  using ReplayFn = std::function<void(WalEntry&&)>;
+
+  // Streams every entry with tranc_id > checkpoint_tranc_id into apply while
+  // segments are still being read, instead of collecting them first.  Up to
+  // `threads` workers each take whole segments, so apply is called
+  // concurrently; the entries of one segment arrive in log order on one
+  // thread, so a batch (never split across segments) stays together.
+  // Returns the number of entries applied.  On corruption no further
+  // segments are started and the error of the lowest failing segment is
+  // returned; entries already applied stay applied.  Sealed segments whose
+  // max_tranc_id is already checkpointed are skipped unread.
+  [[nodiscard]] static std::expected<size_t, WalError> replay(
+      std::string_view log_dir, uint64_t checkpoint_tranc_id, const ReplayFn& apply,
+      size_t threads = Global_::WAL_RECOVERY_THREADS);
+
   // Scan log_dir and return entries with tranc_id > checkpoint_tranc_id.
   // Returns kChecksumMismatch on detected corruption.
   [[nodiscard]] static std::expected<std::map<uint64_t, std::vector<WalEntry>>, WalError> recover(
       std::string_view log_dir, uint64_t checkpoint_tranc_id);
 
-  // Append one entry and block until it is fsync'd to disk.
-  // Dispatches to pipelined or unordered path based on WAL_WRITE_POLICY.
-  [[nodiscard]] std::expected<void, WalError> log(const WalEntry& entry);
+  // Append one entry; with sync, block until it is fsync'd to disk.
+  [[nodiscard]] std::expected<void, WalError> log(const WalEntryRef& entry, bool sync);
 
-  // Append a batch of entries with a single fsync.
-  // Holds write_mutex_ for the entire batch regardless of WAL_WRITE_POLICY,
-  // giving atomic durability for all entries in one round-trip to disk.
+  // Append a batch of entries contiguously; with sync, one fsync covers all.
   // Returns on the first I/O error; entries written before the error are NOT
   // rolled back (callers should treat WAL write failure as fatal).
-  [[nodiscard]] std::expected<void, WalError> log_batch(std::span<const WalEntry> entries);
+  [[nodiscard]] std::expected<void, WalError> log_batch(std::span<const WalEntryRef> entries,
+                                                        bool                         sync);
+  [[nodiscard]] std::expected<void, WalError> log_batch(std::span<const WalEntry> entries,
+                                                        bool                      sync);
+  // Like log_batch(), but the entries are written with a tranc_id the write
+  // group leader takes from next_tranc_id: one fetch_add covers every writer
+  // of the group, each writer's batch getting one id of a contiguous range in
+  // log order.  The entries' own tranc_id is ignored.  The id is stored to
+  // tranc_id even when the write fails.
+  [[nodiscard]] std::expected<void, WalError> log_batch(std::span<const WalEntryRef> entries,
+                                                        bool                         sync,
+                                                        std::atomic<uint64_t>&       next_tranc_id,
+                                                        uint64_t&                    tranc_id);
+
+  // Queue entries for the WAL writer thread and return at once.  The future
+  // is ready when they are written (and fsync'd, with sync), or carries the
+  // error.  Calls from one thread are written in call order; there is no
+  // ordering against concurrent log() / log_batch() calls.  Blocks (yielding)
+  // only while the ring is full.
+  [[nodiscard]] std::future<std::expected<void, WalError>> log_async(std::vector<WalEntry> entries,
+                                                                     bool sync);
 
   // Force fsync without appending (used on commit / destructor).
   [[nodiscard]] std::expected<void, WalError> flush();
@@ -101,44 +222,107 @@ class WAL {
   void set_checkpoint_tranc_id(uint64_t id) noexcept;
 
  private:
-  // ── Pipelined write group ─────────────────────────────────────────────────
+  // ── Write group (leader / follower) ───────────────────────────────────────
+  // result / done are written by the leader and read by the owner, both under
+  // write_mutex_.
   struct Writer {
-    const WalEntry&               entry;
+    std::span<const WalEntryRef>  entries;
+    bool                          sync{false};
+    // Set when the leader assigns the id (log_batch with next_tranc_id).
+    std::atomic<uint64_t>*        next_tranc_id{nullptr};
+    uint64_t                      tranc_id{0};
     std::expected<void, WalError> result{};
     bool                          done{false};
-    std::mutex                    mu{};
-    std::condition_variable       cv{};
   };
 
-  [[nodiscard]] std::expected<void, WalError> log_pipelined(const WalEntry& entry);
-  [[nodiscard]] std::expected<void, WalError> log_unordered(const WalEntry& entry);
+  [[nodiscard]] std::expected<void, WalError> submit(Writer& w);
+  [[nodiscard]] std::expected<void, WalError> log_pipelined(Writer& w);
   [[nodiscard]] std::expected<void, WalError> write_group(std::span<Writer*> group);
+  // Gives every writer that asks for one its tranc_id: one fetch_add per
+  // allocator for the whole group.
+  static void assign_tranc_ids(std::span<Writer*> group);
+
+  // ── Async writer ──────────────────────────────────────────────────────────
+  struct AsyncWrite {
+    std::vector<WalEntry>                       entries;
+    std::vector<WalEntryRef>                    refs;  // views of entries
+    bool                                        sync{false};
+    std::promise<std::expected<void, WalError>> done;
+  };
+
+  void async_writer();
 
   // ── Block I/O ─────────────────────────────────────────────────────────────
-  [[nodiscard]] std::expected<void, WalError> write_entry_blocks(const WalEntry& entry);
-  [[nodiscard]] std::expected<void, WalError> write_physical_record(
-      std::span<const uint8_t> payload, uint8_t type);
+  // Encodes into the block buffers up to write_offset_; nothing reaches the
+  // file until flush_write_buf().
+  void write_entry_blocks(const WalEntryRef& entry);
+  // Buffer position of file offset `offset` (>= pending_start_), taking a
+  // block buffer from the pool when a new file block starts.
+  uint8_t* block_at(size_t offset);
+  [[nodiscard]] std::expected<void, WalError> flush_write_buf();
 
   // ── Encode / decode ───────────────────────────────────────────────────────
-  [[nodiscard]] static std::vector<uint8_t>              encode_payload(const WalEntry& e);
+  class PayloadCursor;  // serialises an entry's payload fragment by fragment
+  // With compression on, swaps payload for its compressed form when that is
+  // worth it (true) or for its serialised raw form (false).
+  bool compress_payload(PayloadCursor& payload);
   [[nodiscard]] static std::expected<WalEntry, WalError> decode_payload(
       std::span<const uint8_t> raw);
 
   // ── File management ───────────────────────────────────────────────────────
   void cleaner();
   void cleanWALFile();
-  void reset_file();
+  [[nodiscard]] std::expected<void, WalError> reset_file();
 
-  // Helper used by cleanWALFile: returns all tranc_ids stored in one file.
-  [[nodiscard]] static std::vector<uint64_t> scan_tranc_ids(FileObj& file) noexcept;
+  // Opens the next segment: a recycled one if available, else a new
+  // preallocated file, and syncs log_dir_ so the segment's name is durable.
+  // Caller holds write_mutex_ (or is the constructor).
+  [[nodiscard]] std::expected<void, WalError> open_segment();
+  // Syncs the active segment, seals its header and closes it.
+  void close_segment();
+  // Rewrites the header of the active segment with the current write offset
+  // and tranc_id range.
+  bool write_segment_header(bool sealed = false);
+
+  // Highest tranc_id in a closed segment: from sealed_max_ or the sealed
+  // header, scanning the records only for a segment that was never sealed.
+  [[nodiscard]] uint64_t segment_max_tranc_id(uint64_t log_number, const std::string& path);
+
+  // Fallback for unsealed segments: returns all tranc_ids stored in one file.
+  [[nodiscard]] static std::vector<uint64_t> scan_tranc_ids(FileObj& file,
+                                                           uint64_t log_number) noexcept;
 
   // ── State ─────────────────────────────────────────────────────────────────
+  std::string log_dir_;
   std::string active_log_path_;
   FileObj     log_file_;
   size_t      file_size_limit_;
-  size_t      block_offset_{0};  // byte offset within the current 32 KB block
+  uint64_t    log_number_{0};
+  size_t      write_offset_{0};  // logical end of the active segment
+  // Records encoded but not yet written, guarded by write_mutex_: file bytes
+  // [pending_start_, write_offset_), file block i of that range in
+  // block_pool_[i - pending_start_ / block size] at the same in-block offset.
+  std::vector<std::unique_ptr<uint8_t[]>> block_pool_;
+  std::vector<std::span<const uint8_t>>   iov_;
+  size_t                                  pending_start_{0};
+  // Compression state of the active segment and scratch, same guard.
+  Global_::WalCompression compression_;
+  Lz::Encoder             lz_;
+  std::vector<uint8_t>    raw_scratch_;
+  std::vector<uint8_t>    lz_scratch_;
+  // tranc_id range of the active segment, guarded by write_mutex_.
+  uint64_t min_tranc_id_{UINT64_MAX};
+  uint64_t max_tranc_id_{0};
+
+  // max_tranc_id of sealed segments not yet retired, keyed by log number.
+  std::mutex                   sealed_mutex_;
+  std::map<uint64_t, uint64_t> sealed_max_;
 
-  // Serialises write-group leaders (one at a time).
+  // Segments renamed to recycled_wal.<n>, ready for reuse.
+  std::mutex               recycle_mutex_;
+  std::vector<std::string> recycled_;
+
+  // Serialises write-group leaders (one at a time) and unordered writers.
   std::mutex write_mutex_;
   // Guards writer_queue_.
   std::mutex          queue_mutex_;
@@ -147,6 +331,13 @@ class WAL {
   uint64_t   checkpoint_tranc_id_;
   std::mutex cp_mutex_;
 
+  // log_async: producers push, async_thread_ pops.  async_pushed_ counts
+  // pushes and is what the writer thread sleeps on.
+  MpscRing<std::unique_ptr<AsyncWrite>> async_ring_{Global_::WAL_ASYNC_QUEUE_SIZE};
+  std::atomic_uint64_t                  async_pushed_{0};
+  std::atomic_bool                      stop_async_{false};
+  std::thread                           async_thread_;
+
   std::thread             cleaner_thread_;
   std::mutex              cleaner_mutex_;
   std::condition_variable cleaner_cv_;
@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+// ─── MpscRing ─────────────────────────────────────────────────────────────────
+//  Bounded lock-free queue, many producers / one consumer (Vyukov's bounded
+//  queue with the consumer side reduced to plain loads).  Each slot carries a
+//  sequence number: a producer claims a position with one CAS on head_,
+//  moves its value in and publishes it by bumping the slot's sequence; the
+//  consumer takes slots strictly in claim order.  Neither side ever blocks,
+//  so waiting for space or for data is up to the caller.
+//
+//  T must be default-constructible and move-assignable.
+template <class T>
+class MpscRing {
+ public:
+  explicit MpscRing(size_t capacity)
+      : mask_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity) - 1),
+        slots_(std::make_unique<Slot[]>(mask_ + 1)) {
+    for (size_t i = 0; i <= mask_; ++i)
+      slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  MpscRing(const MpscRing&)            = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  // false when the ring is full; value is left untouched then.
+  bool try_push(T& value) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot&        slot = slots_[pos & mask_];
+      const size_t seq  = slot.seq.load(std::memory_order_acquire);
+      const auto   diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;  // the consumer has not freed this slot yet
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    Slot& slot = slots_[pos & mask_];
+    slot.value = std::move(value);
+    slot.seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only.  false when the next slot is empty or not yet published.
+  bool try_pop(T& out) {
+    Slot& slot = slots_[tail_ & mask_];
+    if (slot.seq.load(std::memory_order_acquire) != tail_ + 1)
+      return false;
+    out = std::move(slot.value);
+    slot.seq.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+ private:
+  static constexpr size_t kCacheLine = 64;  // keeps producers' CAS off the consumer's line
+
+  struct alignas(kCacheLine) Slot {
+    std::atomic_size_t seq;
+    T                  value{};
+  };
+
+  const size_t            mask_;
+  std::unique_ptr<Slot[]> slots_;
+  alignas(kCacheLine) std::atomic_size_t head_{0};
+  alignas(kCacheLine) size_t tail_{0};
+};
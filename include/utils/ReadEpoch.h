@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+// ─── ReadEpoch ────────────────────────────────────────────────────────────────
+//  Lets readers use an object published through an atomic pointer without a
+//  shared lock, and lets the publisher wait until nobody can still be using
+//  the object it just replaced (sleepable-RCU style).
+//
+//  A reader pins before loading the pointer and unpins when done.  Pinning
+//  bumps a counter in one of kSlots cache-line-sized slots picked by thread,
+//  so threads on different slots never write the same line.  Each slot keeps
+//  one counter per phase; synchronize() flips the phase and waits for the old
+//  phase's counters to drain, twice, so a reader that read the phase before
+//  an earlier flip is covered as well.  New pins go to the other phase and
+//  never hold synchronize() up.
+//
+//  The publisher must store the new pointer (seq_cst) before synchronize();
+//  readers must load it (seq_cst) while pinned.
+class ReadEpoch {
+ public:
+  class Guard {
+   public:
+    explicit Guard(std::atomic<int64_t>& counter) noexcept : counter_(counter) {}
+    ~Guard() { counter_.fetch_sub(1, std::memory_order_release); }
+    Guard(const Guard&)            = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    std::atomic<int64_t>& counter_;
+  };
+
+  ReadEpoch()                            = default;
+  ReadEpoch(const ReadEpoch&)            = delete;
+  ReadEpoch& operator=(const ReadEpoch&) = delete;
+
+  [[nodiscard]] Guard pin() noexcept {
+    const auto phase   = phase_.load(std::memory_order_relaxed) & 1;
+    auto&      counter = slots_[slot_index()].active[phase];
+    counter.fetch_add(1, std::memory_order_seq_cst);
+    return Guard(counter);
+  }
+
+  // Returns once every pin taken before the call has been released.
+  void synchronize() {
+    std::lock_guard lk(sync_mutex_);
+    for (int round = 0; round < 2; ++round) {
+      const auto old = phase_.fetch_add(1, std::memory_order_seq_cst) & 1;
+      for (auto& slot : slots_) {
+        while (slot.active[old].load(std::memory_order_seq_cst) != 0)
+          std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  static constexpr size_t kCacheLine = 64;
+  static constexpr size_t kSlots     = 64;
+
+  struct alignas(kCacheLine) Slot {
+    std::atomic<int64_t> active[2]{};
+  };
+
+  static size_t slot_index() noexcept {
+    static std::atomic_size_t next{0};
+    thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+    return index;
+  }
+
+  Slot                 slots_[kSlots];
+  std::atomic_uint32_t phase_{0};
+  std::mutex           sync_mutex_;
+};
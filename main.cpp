@@ -489,6 +489,40 @@ TEST_F(LSMBenchmark, Bench08_SustainedWriteOverTime) {
     std::println("    Throughput degradation: {:.1f}%  Min={:.0f}  Max={:.0f}", degradation, min_qps, max_qps);
 }
 
+// ============================================================
+//  CRC32C throughput per implementation (no DB involved)
+// ============================================================
+TEST(Crc32cBenchmark, ThroughputPerImpl) {
+    std::println("\n[crc32c] Checksum throughput");
+    constexpr size_t BUF_SIZE = 1 << 20;
+    constexpr int    ROUNDS   = 512;
+
+    std::vector<uint8_t> buf(BUF_SIZE);
+    std::mt19937 rng(42);
+    for (auto& b : buf) b = static_cast<uint8_t>(rng());
+
+    constexpr std::pair<Global_::Crc32cImpl, std::string_view> impls[] = {
+        {Global_::Crc32cImpl::kPortable, "portable"},
+        {Global_::Crc32cImpl::kSse42, "sse4.2"},
+        {Global_::Crc32cImpl::kPclmul, "sse4.2+pclmul"},
+    };
+    for (auto [impl, name] : impls) {
+        if (!Global_::crc32c_supported(impl)) {
+            std::println("    {:<14} unsupported on this CPU", name);
+            continue;
+        }
+        uint32_t sink = 0;
+        auto t0 = Clock::now();
+        for (int i = 0; i < ROUNDS; ++i) {
+            sink += Global_::crc32c(impl, buf);
+        }
+        double elapsed = Duration(Clock::now() - t0).count();
+        double gbps    = static_cast<double>(BUF_SIZE) * ROUNDS / elapsed / 1e9;
+        std::println("    {:<14} {:>7.2f} GB/s{}  (crc={:08x})", name, gbps,
+                     impl == Global_::crc32c_impl() ? "  [selected]" : "", sink);
+    }
+}
+
 // ============================================================
 //  CSV writer
 // ============================================================
@@ -5,6 +5,7 @@
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <queue>
 #include <print>
 #include <string>
 #include <string_view>
@@ -18,19 +19,63 @@
 #include "../include/core/record.h"
 #include "spdlog/spdlog.h"
 
+namespace {
+
+constexpr std::string_view kWalStreamPrefix = "wal_stream_";
+
+// Stream 0 lives in the data directory itself, as the single WAL always did.
+std::string wal_stream_dir(const std::string& data_dir, size_t stream) {
+  if (stream == 0)
+    return data_dir;
+  return data_dir + "/" + std::string(kWalStreamPrefix) + std::to_string(stream);
+}
+
+// Number of streams present on disk: one past the highest wal_stream_<i>.
+size_t wal_streams_on_disk(const std::string& data_dir) {
+  size_t streams = 1;
+  for (const auto& entry : std::filesystem::directory_iterator(data_dir)) {
+    const std::string name = entry.path().filename().string();
+    if (!entry.is_directory() || !name.starts_with(kWalStreamPrefix))
+      continue;
+    try {
+      streams = std::max<size_t>(streams, std::stoull(name.substr(kWalStreamPrefix.size())) + 1);
+    } catch (const std::exception&) {
+    }
+  }
+  return streams;
+}
+
+}  // namespace
+
 // ════════════════════════════════════════════════════════════════════════════
 //  LSM_Engine  — construction / destruction
 // ════════════════════════════════════════════════════════════════════════════
 
-LSM_Engine::LSM_Engine(std::string path, size_t block_cache_capacity, size_t block_cache_k)
+LSM_Engine::LSM_Engine(std::string path, size_t block_cache_capacity, size_t block_cache_k,
+                       Global_::MemTableShardMode shard_mode, size_t flush_threads,
+                       Global_::MemTableRepType memtable_rep, size_t wal_streams)
     : data_dir(path),
-      memtable(std::make_shared<MemTable>()),
+      memtable(std::make_shared<MemTable>(shard_mode, memtable_rep)),
       level_size{0},
-      block_cache(std::make_shared<BlockCache>(block_cache_capacity, block_cache_k)) {
+      block_cache(std::make_shared<BlockCache>(block_cache_capacity, block_cache_k)),
+      wal_write_streams_(std::max<size_t>(wal_streams, 1)),
+      write_controller_([this] {
+        return WriteStallInputs{
+            .imm_bytes                = memtable->get_fixed_size(),
+            .l0_files                 = l0_files_.load(std::memory_order_relaxed),
+            .pending_compaction_bytes = pending_compaction_bytes_.load(std::memory_order_relaxed),
+        };
+      }) {
 
   if (!std::filesystem::exists(path))
     std::filesystem::create_directory(path);
 
+  // Frozen memtables drop versions that no live snapshot can see.
+  memtable->set_snapshot_source([this] { return live_snapshots(); });
+  if constexpr (Global_::WRITE_BUFFER_CHARGE_BLOCK_CACHE)
+    memtable->write_buffer_manager()->set_block_cache_usage(
+        [cache = block_cache] { return cache->memory_usage(); });
+
   // ── 1. Load (or create) the MANIFEST ─────────────────────────────────────
   //  Manifest is constructed first so we can derive the WAL checkpoint from
   //  the maximum tranc_id of all SSTs that have already been flushed to disk.
@@ -105,43 +150,70 @@ LSM_Engine::LSM_Engine(std::string path, size_t block_cache_capacity, size_t blo
       // L0: newer SSTs (higher id) must be searched first.
       std::ranges::reverse(sst_id_list);
   }
+  // Run boundaries are not persisted; treating every L0 SST as its own run
+  // only makes the first L0→L1 compaction after a restart come earlier.
+  l0_runs_ = level_sst_ids[0].size();
+  refresh_stall_inputs();
 
-  // ── 3. Create WAL with checkpoint derived from MANIFEST ───────────────────
+  // ── 3. Create WAL streams with checkpoint derived from MANIFEST ───────────
   //  checkpoint_tranc_id() == max(max_tranc_id of all flushed SSTs).
-  //  WAL::recover will only replay entries NEWER than this value.
+  //  WAL::replay will only replay entries NEWER than this value.  Streams
+  //  left on disk by a run with more streams are opened (and replayed) too.
   const uint64_t checkpoint = manifest_->checkpoint_tranc_id();
-  wal = std::make_unique<WAL>(path, checkpoint);
+  open_wal_streams(checkpoint);
 
   // ── 4. Replay WAL entries newer than checkpoint into memtable ─────────────
-  uint64_t max_recovered = checkpoint;
-  if (auto recovered = WAL::recover(path, checkpoint); recovered.has_value()) {
-    for (auto& [tranc_id, entries] : recovered.value()) {
-      for (auto& e : entries) {
-        if (e.value.empty())
-          memtable->remove(e.key, e.tranc_id);       // tombstone
-        else
-          memtable->put_mutex(e.key, e.value, e.tranc_id);
-        max_recovered = std::max(max_recovered, e.tranc_id);
+  //  Segments are decoded in parallel and streamed straight into the
+  //  memtable; shard inserts are concurrent-safe, and versions of one key
+  //  are ordered by tranc_id regardless of arrival order.  That ordering is
+  //  also what merges the streams: a key written through several streams
+  //  ends up with its versions sorted by tranc_id, whichever stream is
+  //  replayed first.
+  std::atomic<uint64_t> max_recovered{checkpoint};
+  for (size_t stream = 0; stream < wals.size(); ++stream) {
+    auto replayed = WAL::replay(wal_stream_dir(path, stream), checkpoint, [&](WalEntry&& e) {
+      if (e.value.empty())
+        memtable->remove_mutex(e.key, e.tranc_id);  // tombstone
+      else
+        memtable->put_mutex(e.key, e.value, e.tranc_id);
+      uint64_t seen = max_recovered.load(std::memory_order_relaxed);
+      while (seen < e.tranc_id &&
+             !max_recovered.compare_exchange_weak(seen, e.tranc_id, std::memory_order_relaxed)) {
       }
-    }
-    if (!recovered.value().empty())
-      spdlog::info("WAL recovery: replayed entries up to tranc_id={}", max_recovered);
-  } else {
-    spdlog::error("WAL recovery returned checksum error — some data may be lost");
+    });
+    if (!replayed)
+      spdlog::error(
+          "WAL recovery of stream {} stopped on a corrupt record (error {}) — some data may be lost",
+          stream, static_cast<int>(replayed.error()));
+    else if (*replayed > 0)
+      spdlog::info("WAL recovery: replayed {} entries of stream {}, up to tranc_id={}", *replayed,
+                   stream, max_recovered.load());
   }
 
   // ── 5. Advance transaction counter past all known ids ────────────────────
   //  Must be strictly greater than any tranc_id ever written, so new
   //  transactions cannot collide with recovered data.
-  nextTransactionId_.store(max_recovered + 1, std::memory_order_relaxed);
+  nextTransactionId_.store(max_recovered.load() + 1, std::memory_order_relaxed);
+  published_tranc_id_.store(max_recovered.load(), std::memory_order_release);
 
-  // ── 6. Start background compaction thread ─────────────────────────────────
+  // ── 6. Start background flush pool and compaction thread ──────────────────
   //  Started last so that wal, manifest_, and ssts are fully initialised
-  //  before the thread can call flush().
+  //  before any thread can flush.
+  for (size_t i = 0; i < std::max<size_t>(flush_threads, 1); ++i)
+    flush_threads_.emplace_back(&LSM_Engine::flush_worker, this);
   compaction_thread_ = std::thread(&LSM_Engine::compaction_worker, this);
 }
 
 LSM_Engine::~LSM_Engine() {
+  // Flush workers first: an install may still hand work to the compactor.
+  {
+    std::lock_guard lk(flush_mutex_);
+    stop_flush_ = true;
+  }
+  flush_cv_.notify_all();
+  for (auto& t : flush_threads_)
+    if (t.joinable()) t.join();
+
   {
     std::lock_guard lk(compaction_mutex_);
     stop_compaction_ = true;
@@ -160,9 +232,12 @@ LSM_Engine::get_prefix_range(const std::string& prefix, uint64_t tranc_id_) {
 
   std::unordered_map<std::string, std::pair<std::string, uint64_t>> merged;
 
-  // 1. memtable
-  for (auto& [k, v, tid] : memtable->get_prefix_range(prefix, tranc_id_))
-    merged[k] = {v, tid};
+  // 1. memtable: 同一个 key 可能同时出现在活跃表和多张冻结表里，取最新版本
+  for (auto& [k, v, tid] : memtable->get_prefix_range(prefix, tranc_id_)) {
+    auto it = merged.find(k);
+    if (it == merged.end() || it->second.second < tid)
+      merged[k] = {v, tid};
+  }
 
   // 计算前缀上界：找到最右侧非 0xFF 字节并 +1，截断其后
   // 例: "beta_" → "beta`"；"abc\xFF" → "abd"；全 0xFF 则无上界
@@ -237,8 +312,9 @@ std::vector<std::pair<std::string, std::string>> LSM_Engine::print_level_range(s
   return result;
 }
 
-std::optional<std::pair<std::string, uint64_t>> LSM_Engine::get(std::string_view key,
-                                                                 uint64_t        tranc_id) {
+std::optional<std::pair<std::string, uint64_t>> LSM_Engine::get(std::string_view   key,
+                                                                 uint64_t           tranc_id,
+                                                                 const ReadOptions& options) {
   auto mem_res = memtable->get(key, tranc_id);
   if (mem_res.has_value()) {
     if (mem_res.value().first.empty()) return std::nullopt;
@@ -249,7 +325,7 @@ std::optional<std::pair<std::string, uint64_t>> LSM_Engine::get(std::string_view
 
   for (auto& sst_id : level_sst_ids[0]) {
     auto& sst = ssts[sst_id];
-    auto  res = sst->KeyExists(key, tranc_id);
+    auto  res = sst->KeyExists(key, tranc_id, options);
     if (res.has_value()) {
       if (res->first.empty()) return std::nullopt;
       return res;
@@ -262,7 +338,7 @@ std::optional<std::pair<std::string, uint64_t>> LSM_Engine::get(std::string_view
     while (left < right) {
       size_t mid = left + (right - left) / 2;
       auto&  sst = ssts[l_sst_ids[mid]];
-      auto   res = sst->KeyExists(key, tranc_id);
+      auto   res = sst->KeyExists(key, tranc_id, options);
       if (res.has_value()) {
         if (res->first.empty()) return std::nullopt;
         return res;
@@ -274,7 +350,8 @@ std::optional<std::pair<std::string, uint64_t>> LSM_Engine::get(std::string_view
   return std::nullopt;
 }
 std::vector<std::tuple<std::string, std::optional<std::string>, uint64_t>>
-LSM_Engine::get_batch(const std::vector<std::string>& keys, uint64_t tranc_id_) {
+LSM_Engine::get_batch(const std::vector<std::string>& keys, uint64_t tranc_id_,
+                      const ReadOptions& options) {
 
   // 每个 key 的查找状态
   struct State {
@@ -324,7 +401,7 @@ LSM_Engine::get_batch(const std::vector<std::string>& keys, uint64_t tranc_id_)
       auto& s = state[k];
       if (s.found) continue;
       any_left = true;
-      if (auto res = sst->KeyExists(k, tranc_id_); res.has_value()) {
+      if (auto res = sst->KeyExists(k, tranc_id_, options); res.has_value()) {
         s.found    = true;
         s.write_tid = res->second;
         s.value    = res->first.empty() ? std::nullopt
@@ -358,7 +435,7 @@ LSM_Engine::get_batch(const std::vector<std::string>& keys, uint64_t tranc_id_)
       auto& sst = ssts[sst_ids[lo]];
       if (sst->get_first_key() > k) { next_remaining.push_back(k); continue; }
 
-      if (auto res = sst->KeyExists(k, tranc_id_); res.has_value()) {
+      if (auto res = sst->KeyExists(k, tranc_id_, options); res.has_value()) {
         auto& s    = state[k];
         s.found    = true;
         s.write_tid = res->second;
@@ -385,64 +462,166 @@ uint64_t LSM_Engine::bytes_to_mb(size_t bytes) const {
   return bytes / (1024ULL * 1024ULL);
 }
 
+// ════════════════════════════════════════════════════════════════════════════
+//  WAL streams
+// ════════════════════════════════════════════════════════════════════════════
+
+void LSM_Engine::open_wal_streams(uint64_t checkpoint) {
+  // Each WAL's destructor syncs and seals its segment before the new
+  // streams are created.
+  wals.clear();
+  const size_t streams = std::max(wal_write_streams_, wal_streams_on_disk(data_dir));
+  for (size_t stream = 0; stream < streams; ++stream)
+    wals.push_back(std::make_unique<WAL>(wal_stream_dir(data_dir, stream), checkpoint));
+}
+
+WAL& LSM_Engine::wal_for_writer() {
+  // Threads are dealt out to streams round-robin on their first write and
+  // stay there, so one thread's writes keep their order and a batch is
+  // never split between streams.
+  static std::atomic_size_t next_thread{0};
+  thread_local const size_t slot = next_thread.fetch_add(1, std::memory_order_relaxed);
+  return *wals[slot % wal_write_streams_];
+}
+
 // ════════════════════════════════════════════════════════════════════════════
 //  Write paths  — WAL logged before memtable
 // ════════════════════════════════════════════════════════════════════════════
 
-uint64_t LSM_Engine::put(const std::string& key, const std::string& value, uint64_t tranc_id) {
+uint64_t LSM_Engine::log_write(std::span<const WalEntryRef> entries, uint64_t tranc_id,
+                               const WriteOptions& options) {
   // WAL write must succeed before the entry is visible in the memtable.
   // On failure we log the error but do not propagate it upward (matching the
-  // existing void-return contract of LSM::put).
-  if (auto r = wal->log(WalEntry{key, value, tranc_id}); !r)
-    spdlog::error("WAL log failed for key='{}': error {}", key, static_cast<int>(r.error()));
-  memtable->put_mutex(key, value, tranc_id);
-  if (!memtable->fixed_tables.empty())
-    compaction_cv_.notify_one();
+  // existing void-return contract of LSM::put); an allocated id is still
+  // returned so the write gets applied and published.
+  std::expected<void, WalError> r;
+  if (options.disable_wal) {
+    if (tranc_id == 0)
+      tranc_id = nextTransactionId_.fetch_add(1, std::memory_order_relaxed);
+  } else if (tranc_id == 0) {
+    r = wal_for_writer().log_batch(entries, options.sync, nextTransactionId_, tranc_id);
+  } else {
+    r = wal_for_writer().log_batch(entries, options.sync);
+  }
+  if (!r)
+    spdlog::error("WAL write of {} entries (first key='{}') failed: error {}", entries.size(),
+                  entries.empty() ? std::string_view{} : entries.front().key,
+                  static_cast<int>(r.error()));
+  return tranc_id;
+}
+
+// Ids are allocated in one order but the writes reach the memtable in
+// another; published_tranc_id_ only moves past an id once every smaller one
+// is applied, so a read at the published id never sees a write while missing
+// an earlier one.  Each writer marks its slot done and then advances the
+// watermark over every done slot it finds, so a write that completes early is
+// published by whichever earlier writer finishes last, without a hand-off
+// per id.  The writer then waits until its own id is covered: a put is
+// visible to the caller's next get.  Writers publish through PublishGuard, so
+// a write that throws after its id was allocated still lets later ids past.
+void LSM_Engine::publish_tranc_id(uint64_t tranc_id) noexcept {
+  uint64_t cur = published_tranc_id_.load(std::memory_order_acquire);
+  while (tranc_id - cur > kPublishSlots) {  // slot still held by an older id
+    published_tranc_id_.wait(cur, std::memory_order_acquire);
+    cur = published_tranc_id_.load(std::memory_order_acquire);
+  }
+  // seq_cst on the slots: of two writers finishing back to back, at least
+  // one sees the other's slot and carries the watermark over both.  seq_cst
+  // on the watermark as well: ReadView and live_snapshots rely on one total
+  // order of its loads and stores.
+  publish_slots_[tranc_id % kPublishSlots].store(tranc_id);
+  bool advanced = false;
+  while (publish_slots_[(cur + 1) % kPublishSlots].load() == cur + 1) {
+    // On failure cur is reloaded: someone else moved the watermark on.
+    if (published_tranc_id_.compare_exchange_weak(cur, cur + 1)) {
+      ++cur;
+      advanced = true;
+    }
+  }
+  if (advanced)
+    published_tranc_id_.notify_all();
+  // Only an earlier writer still between its WAL write and its memtable
+  // insert holds us here; it wakes us when it moves the watermark.
+  for (cur = published_tranc_id_.load(std::memory_order_acquire); cur < tranc_id;
+       cur = published_tranc_id_.load(std::memory_order_acquire))
+    published_tranc_id_.wait(cur, std::memory_order_acquire);
+}
+
+uint64_t LSM_Engine::put(const std::string& key, const std::string& value, uint64_t tranc_id,
+                         const WriteOptions& options) {
+  write_controller_.maybe_stall(key.size() + value.size());
+  const WalEntryRef entry{key, value, tranc_id};
+  const uint64_t    id = log_write(std::span{&entry, 1}, tranc_id, options);
+  {
+    const PublishGuard publish(*this, tranc_id == 0 ? id : 0);
+    memtable->put_mutex(key, value, id);
+  }
+  if (memtable->has_unclaimed_frozen())
+    flush_cv_.notify_one();
   return 0;
 }
 
 uint64_t LSM_Engine::put_batch(const std::vector<std::pair<std::string, std::string>>& kvs,
-                               uint64_t                                                tranc_id) {
-  // Build WAL entries and flush the whole batch in a single fsync.
-  std::vector<WalEntry> entries;
-  entries.reserve(kvs.size());
-  for (const auto& [k, v] : kvs)
-    entries.push_back({k, v, tranc_id});
-
-  if (auto r = wal->log_batch(std::span{entries}); !r)
-    spdlog::error("WAL log_batch failed: error {}", static_cast<int>(r.error()));
-
-  memtable->put_batch(kvs, tranc_id);
-  if (!memtable->fixed_tables.empty())
-    compaction_cv_.notify_one();
+                               uint64_t tranc_id, const WriteOptions& options) {
+  size_t batch_bytes = 0;
+  for (const auto& [k, v] : kvs) batch_bytes += k.size() + v.size();
+  write_controller_.maybe_stall(batch_bytes);
+
+  // Log the whole batch contiguously (one fsync if sync).  The WAL encodes
+  // straight from these views; keys and values are not copied.
+  std::vector<WalEntryRef> entries;
+  if (!options.disable_wal) {
+    entries.reserve(kvs.size());
+    for (const auto& [k, v] : kvs)
+      entries.emplace_back(k, v, tranc_id);
+  }
+  const uint64_t id = log_write(std::span{entries}, tranc_id, options);
+
+  {
+    const PublishGuard publish(*this, tranc_id == 0 ? id : 0);
+    memtable->put_batch(kvs, id);
+  }
+  if (memtable->has_unclaimed_frozen())
+    flush_cv_.notify_one();
   return 0;
 }
 
-uint64_t LSM_Engine::remove(const std::string& key, uint64_t tranc_id) {
+uint64_t LSM_Engine::remove(const std::string& key, uint64_t tranc_id,
+                            const WriteOptions& options) {
+  write_controller_.maybe_stall(key.size());
   // Empty value is the tombstone convention throughout the LSM stack.
-  if (auto r = wal->log(WalEntry{key, /*tombstone*/"", tranc_id}); !r)
-    spdlog::error("WAL log failed for remove key='{}': error {}", key,
-                  static_cast<int>(r.error()));
+  const WalEntryRef entry{key, /*tombstone*/"", tranc_id};
+  const uint64_t    id = log_write(std::span{&entry, 1}, tranc_id, options);
 
-  memtable->remove_mutex(key, tranc_id);
-  if (!memtable->fixed_tables.empty())
-    compaction_cv_.notify_one();
+  {
+    const PublishGuard publish(*this, tranc_id == 0 ? id : 0);
+    memtable->remove_mutex(key, id);
+  }
+  if (memtable->has_unclaimed_frozen())
+    flush_cv_.notify_one();
   return 0;
 }
 
-uint64_t LSM_Engine::remove_batch(const std::vector<std::string>& keys, uint64_t tranc_id) {
-  std::vector<WalEntry> entries;
-  entries.reserve(keys.size());
-  for (const auto& key : keys)
-    entries.push_back({key, /*tombstone*/std::string(), tranc_id});
-
-  if (auto r = wal->log_batch(std::span{entries}); !r)
-    spdlog::error("WAL log_batch failed for remove_batch: error {}",
-                  static_cast<int>(r.error()));
+uint64_t LSM_Engine::remove_batch(const std::vector<std::string>& keys, uint64_t tranc_id,
+                                  const WriteOptions& options) {
+  size_t batch_bytes = 0;
+  for (const auto& key : keys) batch_bytes += key.size();
+  write_controller_.maybe_stall(batch_bytes);
+
+  std::vector<WalEntryRef> entries;
+  if (!options.disable_wal) {
+    entries.reserve(keys.size());
+    for (const auto& key : keys)
+      entries.emplace_back(key, /*tombstone*/std::string_view(), tranc_id);
+  }
+  const uint64_t id = log_write(std::span{entries}, tranc_id, options);
 
-  memtable->remove_batch(keys, tranc_id);
-  if (!memtable->fixed_tables.empty())
-    compaction_cv_.notify_one();
+  {
+    const PublishGuard publish(*this, tranc_id == 0 ? id : 0);
+    memtable->remove_batch(keys, id);
+  }
+  if (memtable->has_unclaimed_frozen())
+    flush_cv_.notify_one();
   return 0;
 }
 
@@ -451,89 +630,216 @@ uint64_t LSM_Engine::remove_batch(const std::vector<std::string>& keys, uint64_t
 // ════════════════════════════════════════════════════════════════════════════
 
 uint64_t LSM_Engine::flush(bool force) {
-  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
-   if (memtable->get_total_size() == 0){
-     return 0;
-    }
+  if (memtable->get_total_size() == 0) return 0;
   memtable->frozen_cur_table(force);
-  auto res = memtable->flushtodisk();
-  if (!res) return 0;
-  Sstbuild     builder(Global_::Block_SIZE);
-  const size_t new_sst_id = next_sst_id.fetch_add(1);
- const auto   sst_path = get_sst_path(new_sst_id, 0);
-  for (auto i = res->begin(); i != res->end(); ++i) {
-    auto kv      = i.getValue();
-    auto tid     = i.get_tranc_id();
-    builder.add(kv.first, kv.second, tid);
+  // Flush on the caller's thread instead of waiting for a pool thread to
+  // wake up, then wait for jobs the pool had already claimed: when flush()
+  // returns, everything frozen before the call is installed in L0.
+  const uint64_t max_tid = run_flush_job();
+  wait_for_flushes();
+  return max_tid;
+}
+
+// ── Flush pipeline ──────────────────────────────────────────────────────────
+//  claim   (flush_mutex_)      take every unclaimed frozen table, assign the
+//                              job a sequence number and a block of SST ids
+//  build   (no lock)           k-way merge + write + fsync the SSTs; several
+//                              jobs build concurrently on the flush pool
+//  install (ssts_mtx, unique)  in sequence order, so L0 stays newest-first
+//                              and SST ids stay in write order for restarts
+//  The frozen tables stay readable in the memtable until their SSTs are
+//  installed; only then are they released.
+
+std::optional<LSM_Engine::FlushJob> LSM_Engine::claim_flush_job() {
+  std::lock_guard lk(flush_mutex_);
+  auto tables = memtable->claim_frozen_tables();
+  if (tables.empty()) return std::nullopt;
+
+  size_t bytes = 0;
+  for (auto* table : tables) bytes += table->get_size();
+  // SST entries are smaller than skiplist nodes, so a run never needs more
+  // than bytes / MAX_SSTABLE_SIZE + 1 files; one more covers rounding.
+  const size_t id_budget = bytes / Global_::MAX_SSTABLE_SIZE + 2;
+  return FlushJob{
+      .seq          = next_flush_seq_++,
+      .tables       = std::move(tables),
+      .first_sst_id = next_sst_id.fetch_add(id_budget),
+      .sst_id_count = id_budget,
+  };
+}
+
+// Merges the frozen tables of one job into a single sorted run, written to
+// L0 as key-disjoint SSTs.  Runs without any engine lock held.
+std::vector<std::shared_ptr<Sstable>> LSM_Engine::build_flush_job(const FlushJob& job) {
+  // ── 1. k-way merge: key asc, tranc_id desc, newer table first on ties ────
+  struct Cursor {
+    SkiplistIterator it;
+    size_t           age;  // position in the frozen list; larger == newer
+  };
+  auto after = [](const Cursor& a, const Cursor& b) {
+    if (int c = cmp(a.it.key(), b.it.key()); c != 0) return c > 0;
+    if (a.it.get_tranc_id() != b.it.get_tranc_id())
+      return a.it.get_tranc_id() < b.it.get_tranc_id();
+    return a.age < b.age;
+  };
+  std::priority_queue<Cursor, std::vector<Cursor>, decltype(after)> heap(after);
+  for (size_t age = 0; age < job.tables.size(); ++age) {
+    if (auto it = job.tables[age]->begin(); it.valid()) heap.push(Cursor{it, age});
   }
- if (builder.estimated_size() == 0) {
-    spdlog::warn("Skipping empty Skiplist during flush, potential ghost table detected.");
-    next_sst_id--; // 回退 sst_id
-    return 0;
+
+  // ── 2. Cut the run into SSTs, only ever between two distinct keys ───────
+  //  Keeping every version of a key inside one SST is what makes the
+  //  outputs of a single flush non-overlapping.
+  std::vector<std::shared_ptr<Sstable>> new_ssts;
+  Sstbuild                              builder(Global_::Block_SIZE);
+  std::string                           last_key;
+  //  Versions shadowed across tables (or left over when no snapshot source
+  //  was set at freeze time) are dropped here before they reach L0.
+  VersionCollapser                      collapser(live_snapshots());
+  size_t                                used_ids = 0;
+  auto finish_sst = [&] {
+    const size_t new_sst_id = job.first_sst_id + used_ids++;
+    if (auto sst = builder.build(block_cache, get_sst_path(new_sst_id, 0), new_sst_id))
+      new_ssts.push_back(std::move(sst));
+    builder.clean();
+  };
+  while (!heap.empty()) {
+    auto cur = heap.top();
+    heap.pop();
+    // the last reserved id absorbs whatever is left rather than overflow
+    if (builder.estimated_size() >= Global_::MAX_SSTABLE_SIZE && cur.it.key() != last_key &&
+        used_ids + 1 < job.sst_id_count)
+      finish_sst();
+    last_key = cur.it.key();
+    if (collapser.keep(cur.it.key(), cur.it.get_tranc_id()))
+      builder.add(cur.it.key(), cur.it.value(), cur.it.get_tranc_id());
+    ++cur.it;
+    if (cur.it.valid()) heap.push(cur);
   }
- 
-  auto new_sst = builder.build(block_cache, sst_path, new_sst_id);
-  if (!new_sst) {
-    // 没有生成 SST 文件，清理临时路径或直接返回
-    spdlog::info("Skipped empty SST generation for sst_id {}", new_sst_id);
-    return 0;  // 或者返回空 vector
+  if (builder.estimated_size() > 0) finish_sst();
+  return new_ssts;
 }
-  // ── MANIFEST: persist ADD_SST before updating in-memory index ────────────
-  //  If we crash after this write but before the index update the SST exists
-  //  on disk and the MANIFEST records it — safe to replay on next startup.
-  auto [min_tid, max_tid] = new_sst->get_tranc_id_range();
-  manifest_->add_sst(SstMeta{
-      .sst_id       = new_sst_id,
-      .level        = 0,
-      .min_tranc_id = min_tid,
-      .max_tranc_id = max_tid,
-      .first_key    = new_sst->get_first_key(),
-      .last_key     = new_sst->get_last_key(),
-  });
-manifest_->sync();  // ensure durability of MANIFEST update before proceeding
-  // ── WAL checkpoint: inform WAL that entries up to this point are safe ─────
-  //  The WAL cleaner will eventually delete segments whose every tranc_id
-  //  is <= checkpoint.
-  wal->set_checkpoint_tranc_id(manifest_->checkpoint_tranc_id());
 
-  // ── Update in-memory SST index ────────────────────────────────────────────
-  ssts[new_sst_id] = new_sst;
-  level_sst_ids[0].push_front(new_sst_id);
+uint64_t LSM_Engine::install_flush_job(const FlushJob&                        job,
+                                       std::vector<std::shared_ptr<Sstable>> new_ssts) {
+  // Wait for every older job to be installed first.
+  {
+    std::unique_lock lk(flush_mutex_);
+    install_cv_.wait(lk, [&] { return next_install_seq_ == job.seq; });
+  }
 
-  if (level_sst_ids.count(0) && level_sst_ids[0].size() >= Global_::LSM_SST_LEVEL_RATIO)
-    leveled_compact(0);
+  uint64_t max_tid        = 0;
+  bool     run_compaction = false;
+  if (new_ssts.empty()) {
+    spdlog::warn("flush: frozen tables produced no SST, potential ghost tables detected.");
+  } else {
+    std::unique_lock<std::shared_mutex> lock(ssts_mtx);
+    // ── MANIFEST: persist ADD_SST before updating in-memory index ──────────
+    //  If we crash after this write but before the index update the SSTs
+    //  exist on disk and the MANIFEST records them — safe to replay on next
+    //  startup.
+    for (const auto& sst : new_ssts) {
+      auto [min_tid, sst_max_tid] = sst->get_tranc_id_range();
+      max_tid                     = std::max(max_tid, sst_max_tid);
+      manifest_->add_sst(SstMeta{
+          .sst_id       = sst->get_sst_id(),
+          .level        = 0,
+          .min_tranc_id = min_tid,
+          .max_tranc_id = sst_max_tid,
+          .first_key    = sst->get_first_key(),
+          .last_key     = sst->get_last_key(),
+      });
+    }
+    manifest_->sync();  // ensure durability of MANIFEST update before proceeding
+    // ── WAL checkpoint: inform WAL that entries up to this point are safe ───
+    //  Each stream's cleaner will eventually retire segments whose every
+    //  tranc_id is <= checkpoint.
+    for (auto& stream : wals)
+      stream->set_checkpoint_tranc_id(manifest_->checkpoint_tranc_id());
+
+    // ── Update in-memory SST index ─────────────────────────────────────────
+    for (const auto& sst : new_ssts) {
+      ssts[sst->get_sst_id()] = sst;
+      level_sst_ids[0].push_front(sst->get_sst_id());
+      level_size[0] += sst->get_sst_size();
+    }
+    ++l0_runs_;
+    run_compaction = l0_needs_compaction();
+    refresh_stall_inputs();
+  }
+  // Readers now find the data in L0; the frozen tables can go.
+  memtable->release_flushed_tables(job.tables);
+  write_controller_.notify();
 
+  {
+    std::lock_guard lk(flush_mutex_);
+    ++next_install_seq_;
+  }
+  install_cv_.notify_all();
+  if (run_compaction) {
+    {
+      std::lock_guard lk(compaction_mutex_);
+      compaction_pending_ = true;
+    }
+    compaction_cv_.notify_one();
+  }
   return max_tid;
 }
 
+uint64_t LSM_Engine::run_flush_job() {
+  auto job = claim_flush_job();
+  if (!job) return 0;
+  return install_flush_job(*job, build_flush_job(*job));
+}
+
+void LSM_Engine::wait_for_flushes() {
+  std::unique_lock lk(flush_mutex_);
+  const uint64_t   target = next_flush_seq_;
+  install_cv_.wait(lk, [&] { return next_install_seq_ >= target; });
+}
+
 // ════════════════════════════════════════════════════════════════════════════
 //  clear — wipe all state and reinitialise manifest + WAL from scratch
 // ════════════════════════════════════════════════════════════════════════════
 
 void LSM_Engine::clear() {
+  // Let in-flight flush jobs install before their SSTs are wiped below.
+  wait_for_flushes();
+  std::lock_guard                     run(compaction_run_mtx_);
+  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
   level_sst_ids.clear();
+  l0_runs_ = 0;
   ssts.clear();
   memtable->clear();
   std::fill(level_size.begin(), level_size.end(), 0);
   cur_max_level = 0;
 
-  // Delete all on-disk files (SSTs, WAL segments, MANIFEST).
+  // Close the WAL streams first: no cleaner may be listing a stream
+  // directory while it is removed below.
+  wals.clear();
+
+  // Delete all on-disk files (SSTs, WAL segments and streams, MANIFEST).
   try {
     for (const auto& entry : std::filesystem::directory_iterator(data_dir)) {
       if (entry.is_regular_file())
         std::filesystem::remove(entry.path());
+      else if (entry.is_directory() &&
+               entry.path().filename().string().starts_with(kWalStreamPrefix))
+        std::filesystem::remove_all(entry.path());
     }
   } catch (const std::filesystem::filesystem_error& e) {
     spdlog::error("Error clearing directory: {}", e.what());
   }
 
-  // Reinitialise manifest and WAL so subsequent writes work correctly.
-  // The old objects' destructors run here (WAL flushes + joins cleaner).
+  // Reinitialise manifest and WAL streams so subsequent writes work correctly.
   manifest_ = std::make_unique<Manifest>(data_dir);
-  wal       = std::make_unique<WAL>(data_dir, /*checkpoint=*/0);
+  open_wal_streams(/*checkpoint=*/0);
 
   next_sst_id.store(0, std::memory_order_relaxed);
   nextTransactionId_.store(1, std::memory_order_relaxed);
+  published_tranc_id_.store(0, std::memory_order_release);
+  for (auto& slot : publish_slots_) slot.store(0, std::memory_order_relaxed);
+  refresh_stall_inputs();
 }
 
 // ════════════════════════════════════════════════════════════════════════════
@@ -555,72 +861,126 @@ std::string LSM_Engine::get_sst_path(size_t sst_id, size_t target_level) {
   return ss.str();
 }
 
-uint64_t LSM_Engine::drain_one_frozen_table() {
-  std::unique_lock<std::shared_mutex> lock(ssts_mtx);
-
-  // 二次检查：拿到锁后再确认一次，避免和 flush_all() 竞争
-  auto res = memtable->flushtodisk();
-  if (!res) return 0;
-
-  Sstbuild     builder(Global_::Block_SIZE);
-  const size_t new_sst_id = next_sst_id.fetch_add(1);
-  const auto   sst_path   = get_sst_path(new_sst_id, 0);
-
-  for (auto i = res->begin(); i != res->end(); ++i) {
-    auto kv  = i.getValue();
-    auto tid = i.get_tranc_id();
-    builder.add(kv.first, kv.second, tid);
+void LSM_Engine::flush_worker() {
+  while (true) {
+    {
+      std::unique_lock lk(flush_mutex_);
+      flush_cv_.wait_for(lk, std::chrono::milliseconds(200), [this] {
+        return stop_flush_ || memtable->has_unclaimed_frozen();
+      });
+      if (stop_flush_) break;
+    }
+    // 冻结的职责在 put_mutex 写路径里，worker 只负责把冻结表落盘
+    while (memtable->has_unclaimed_frozen())
+      run_flush_job();
   }
+}
 
-  if (builder.estimated_size() == 0) {
-    spdlog::warn("drain_one: empty skiplist, skipping sst_id {}", new_sst_id);
-    next_sst_id--;
-    return 0;
+void LSM_Engine::compaction_worker() {
+  while (true) {
+    {
+      std::unique_lock lk(compaction_mutex_);
+      compaction_cv_.wait(lk, [this] {
+        return stop_compaction_.load(std::memory_order_relaxed) || compaction_pending_;
+      });
+      if (stop_compaction_.load(std::memory_order_relaxed)) break;
+      compaction_pending_ = false;
+    }
+    // 一轮 compaction 期间 clear() 不能清掉它要换下的 SST
+    std::lock_guard run(compaction_run_mtx_);
+    bool            needed = false;
+    {
+      // flush 可能在排队期间又装了几个 run，以拿到锁时的 L0 状态为准
+      std::shared_lock<std::shared_mutex> lock(ssts_mtx);
+      needed = l0_needs_compaction();
+    }
+    if (needed)
+      leveled_compact(0);
   }
+}
 
-  auto new_sst = builder.build(block_cache, sst_path, new_sst_id);
-  if (!new_sst) {
-    next_sst_id--;
-    return 0;
+// L0→L1 在攒够 LSM_SST_LEVEL_RATIO 个 run 时触发；单次 flush 很大时 run 数
+// 不多但文件很多，达到写入减速阈值时也要压缩，否则写者可能一直被 L0 文件数卡住
+bool LSM_Engine::l0_needs_compaction() const {
+  auto it = level_sst_ids.find(0);
+  const size_t l0_files = it == level_sst_ids.end() ? 0 : it->second.size();
+  return l0_files > 0 && (l0_runs_ >= static_cast<size_t>(Global_::LSM_SST_LEVEL_RATIO) ||
+                          l0_files >= Global_::WRITE_SLOWDOWN_L0_FILES);
+}
+
+void LSM_Engine::refresh_stall_inputs() {
+  // 待压缩字节：L0 达到触发条件时整层都要压下去；L1+ 超出本层预算的部分
+  size_t pending = l0_needs_compaction() ? level_size[0] : 0;
+  size_t budget  = Global_::L1_BUDGET_MB * 1024ULL * 1024ULL;
+  for (size_t level = 1; level <= cur_max_level && level < level_size.size(); ++level) {
+    if (level_size[level] > budget) pending += level_size[level] - budget;
+    budget *= 10;
   }
+  auto it = level_sst_ids.find(0);
+  l0_files_.store(it == level_sst_ids.end() ? 0 : it->second.size(), std::memory_order_relaxed);
+  pending_compaction_bytes_.store(pending, std::memory_order_relaxed);
+}
 
-  auto [min_tid, max_tid] = new_sst->get_tranc_id_range();
-  manifest_->add_sst(SstMeta{
-      .sst_id       = new_sst_id,
-      .level        = 0,
-      .min_tranc_id = min_tid,
-      .max_tranc_id = max_tid,
-      .first_key    = new_sst->get_first_key(),
-      .last_key     = new_sst->get_last_key(),
-  });
-  manifest_->sync();
+WriteStallStats LSM_Engine::write_stall_stats() const {
+  return write_controller_.stats();
+}
 
-  wal->set_checkpoint_tranc_id(manifest_->checkpoint_tranc_id());
+uint64_t LSM_Engine::acquire_snapshot(uint64_t tranc_id) {
+  std::lock_guard lk(snapshot_mtx_);
+  const uint64_t  snapshot = tranc_id != 0 ? tranc_id : published_tranc_id();
+  snapshots_.insert(snapshot);
+  return snapshot;
+}
 
-  ssts[new_sst_id] = new_sst;
-  level_sst_ids[0].push_front(new_sst_id);
+void LSM_Engine::release_snapshot(uint64_t snapshot) {
+  std::lock_guard lk(snapshot_mtx_);
+  if (auto it = snapshots_.find(snapshot); it != snapshots_.end()) snapshots_.erase(it);
+}
 
-  if (level_sst_ids.count(0) &&
-      level_sst_ids[0].size() >= Global_::LSM_SST_LEVEL_RATIO)
-    leveled_compact(0);
+// A ReadView takes a free slot with the published id, then re-reads the id
+// and retries until it is unchanged.  live_snapshots loads the published id
+// before scanning the slots: a view the scan misses stored its id after the
+// scan, so it confirmed an id no older than that.  The collapser keeps the
+// version the published id sees and every id allocated but not yet
+// published, which covers any such view.
+LSM_Engine::ReadView::ReadView(LSM_Engine& engine) : engine_(engine) {
+  uint64_t id = engine_.published_tranc_id_.load();
+  if (id == 0) return;  // reads the newest versions, which are always kept
+  static std::atomic_size_t next_thread{0};
+  thread_local const size_t hint = next_thread.fetch_add(1, std::memory_order_relaxed);
+  for (size_t i = 0; i < kReadSlots && slot_ == nullptr; ++i) {
+    auto&    slot = engine_.read_slots_[(hint + i) % kReadSlots].tranc_id;
+    uint64_t free = 0;
+    if (slot.compare_exchange_strong(free, id)) slot_ = &slot;
+  }
+  if (slot_ == nullptr) {
+    tranc_id_ = engine_.acquire_snapshot();
+    return;
+  }
+  for (uint64_t now = engine_.published_tranc_id_.load(); now != id;
+       now          = engine_.published_tranc_id_.load()) {
+    id = now;
+    slot_->store(id);
+  }
+  tranc_id_ = id;
+}
 
-  return max_tid;
+LSM_Engine::ReadView::~ReadView() {
+  if (slot_ != nullptr)
+    slot_->store(0, std::memory_order_release);
+  else if (tranc_id_ != 0)
+    engine_.release_snapshot(tranc_id_);
 }
-void LSM_Engine::compaction_worker() {
-  while (true) {
-    {
-      std::unique_lock lk(compaction_mutex_);
-      compaction_cv_.wait_for(lk, std::chrono::milliseconds(200), [this] {
-        return stop_compaction_.load(std::memory_order_relaxed) ||
-               !memtable->fixed_tables.empty();
-      });
-    }
-    if (stop_compaction_.load(std::memory_order_relaxed)) break;
-    // 而冻结的职责在 put_mutex 写路径里，worker 不应重复触发
-    while (!memtable->fixed_tables.empty()) {
-      drain_one_frozen_table();
-    }
-  }
+
+VersionCollapser LSM_Engine::live_snapshots() {
+  const uint64_t        published = published_tranc_id_.load();
+  const uint64_t        next_id   = nextTransactionId_.load();
+  std::vector<uint64_t> views;
+  for (const auto& slot : read_slots_)
+    if (const uint64_t id = slot.tranc_id.load(); id != 0) views.push_back(id);
+  std::lock_guard lk(snapshot_mtx_);
+  views.insert(views.end(), snapshots_.begin(), snapshots_.end());
+  return VersionCollapser(std::move(views), published, next_id);
 }
 bool LSM_Engine::exit_valid_sst_iter(std::vector<SstIterator>& sst_iters) {
   for (auto& it : sst_iters)
@@ -642,18 +1002,12 @@ std::pair<size_t, size_t> LSM_Engine::find_the_small_kv(std::vector<SstIterator>
   return std::make_pair(res - sst_iters.begin(), index);
 }
 
-bool LSM_Engine::can_drop_tombstone(std::string_view key, size_t output_level) const {
+bool LSM_Engine::can_drop_tombstone(std::string_view key,
+                                    std::span<const std::shared_ptr<Sstable>> deeper) {
   // 墓碑只有在比 output_level 更深的层都没有这个 key 的旧数据时才能丢弃
-  for (size_t level = output_level + 1; level <= cur_max_level; ++level) {
-    auto it = level_sst_ids.find(level);
-    if (it == level_sst_ids.end()) continue;
-    for (auto sst_id : it->second) {
-      auto sst_it = ssts.find(sst_id);
-      if (sst_it == ssts.end() || !sst_it->second) continue;
-      const auto& sst = sst_it->second;
-      if (sst->get_first_key() <= key && key <= sst->get_last_key())
-        return false;  // 深层有可能存在此 key，墓碑不能丢
-    }
+  for (const auto& sst : deeper) {
+    if (sst->get_first_key() <= key && key <= sst->get_last_key())
+      return false;  // 深层有可能存在此 key，墓碑不能丢
   }
   return true;  // 深层确认没有，墓碑可以安全丢弃
 }
@@ -746,7 +1100,7 @@ std::vector<size_t> LSM_Engine::find_overlapping_ssts(
 // 返回 level 层下一个要 compact 的 SST 在 level_sst_ids[level] 里的下标。
 // 依据 compaction_pointer_ 做 round-robin，保证 key space 均匀覆盖。
 size_t LSM_Engine::pick_compaction_index(size_t level) {
-  const auto& ids = level_sst_ids[level];
+  const auto& ids = level_sst_ids.at(level);
   if (ids.empty()) return 0;
 
   auto ptr_it = compaction_pointer_.find(level);
@@ -764,19 +1118,19 @@ size_t LSM_Engine::pick_compaction_index(size_t level) {
 }
 
 // 统一的合并函数，取代 full_l0_l1_compact / full_common_compact。
-// upper_ids + lower_ids 里的 SST 合并后输出到 output_level。
-std::vector<std::shared_ptr<Sstable>> LSM_Engine::compact_ssts(
-    const std::vector<size_t>& upper_ids,
-    const std::vector<size_t>& lower_ids,
-    size_t                     output_level) {
+// plan.src + plan.dst 里的 SST 合并后输出到 plan.src_level + 1；不拿 ssts_mtx。
+std::vector<std::shared_ptr<Sstable>> LSM_Engine::compact_ssts(const CompactionPlan& plan) {
+  const size_t output_level = plan.src_level + 1;
 
   std::vector<std::shared_ptr<Sstable>> result;
-  result.reserve(upper_ids.size() + lower_ids.size() + 1);
+  result.reserve(plan.src.size() + plan.dst.size() + 1);
 
-  // merge_sst_iterator 按值传参，这里构造临时 vector，copy 只含 size_t，开销极小
-  auto merged  = merge_sst_iterator(
-      std::vector<size_t>(upper_ids), std::vector<size_t>(lower_ids));
-  auto builder = std::make_unique<Sstbuild>(Global_::Block_SIZE);
+  std::vector<SstIterator> merged;
+  merged.reserve(plan.src.size() + plan.dst.size());
+  for (const auto& sst : plan.src) merged.push_back(sst->begin(0));
+  for (const auto& sst : plan.dst) merged.push_back(sst->begin(0));
+  auto             builder = std::make_unique<Sstbuild>(Global_::Block_SIZE);
+  VersionCollapser collapser(live_snapshots());
 
   auto flush_builder = [&] {
     const size_t new_id = next_sst_id++;
@@ -796,11 +1150,17 @@ std::vector<std::shared_ptr<Sstable>> LSM_Engine::compact_ssts(
     auto               versions = collect_compaction_entries(merged, cur_key);
     assert(!versions.empty());
 
-    const auto& best = versions[0]; // tranc_id 最大的版本（已降序排列）
-    if (best.value.empty() && can_drop_tombstone(cur_key, output_level))
+    // 最新版本之外只留存活快照还看得到的版本
+    std::vector<const CompactionEntry*> kept;
+    for (const auto& v : versions)
+      if (collapser.keep(cur_key, v.tranc_id)) kept.push_back(&v);
+
+    const auto& best = *kept[0]; // tranc_id 最大的版本（已降序排列）
+    if (kept.size() == 1 && best.value.empty() && can_drop_tombstone(cur_key, plan.deeper))
       continue; // 安全丢弃墓碑
 
-    builder->add(cur_key, best.value, best.tranc_id);
+    for (const auto* v : kept)
+      builder->add(cur_key, v->value, v->tranc_id);
     if (builder->estimated_size() >= Global_::MAX_SSTABLE_SIZE)
       flush_builder();
   }
@@ -816,42 +1176,58 @@ std::vector<std::shared_ptr<Sstable>> LSM_Engine::compact_ssts(
 //  L0→L1：取全部 L0，找 L1 里的交集 SST，合并
 //  Ln→L(n+1)：round-robin 取一个 SST，找下层交集，合并
 //
-//  Crash-safety 顺序（与原来一致）：
-//    1. ADD_SST 写入 MANIFEST → fsync
-//    2. 删文件 + REMOVE_SST → fsync
-//    3. 更新内存索引
+//  只有 compaction 线程改 L1 及以下各层，flush 安装只往 L0 头部加新文件，所以：
+//    1. 共享锁下选出输入 SST（plan_compaction）
+//    2. 不拿锁合并、写新 SST（compact_ssts）
+//    3. MANIFEST：ADD_SST → fsync → REMOVE_SST → fsync
+//    4. 独占锁下换内存索引；L0 只摘掉参与合并的文件，期间新装的 run 留着
+//    5. 删旧文件：换完索引以后新的读请求已经看不到它们
 // ════════════════════════════════════════════════════════════════════════════
-void LSM_Engine::leveled_compact(size_t src_level) {
+std::optional<LSM_Engine::CompactionPlan> LSM_Engine::plan_compaction(size_t src_level) {
   const size_t dst_level = src_level + 1;
+  std::shared_lock<std::shared_mutex> lock(ssts_mtx);
 
   // ── 1. 选出本次参与 compact 的 src SST ──────────────────────────────────
+  // 共享锁下只能 find，map 的 operator[] 会插入
+  auto level_it = level_sst_ids.find(src_level);
+  if (level_it == level_sst_ids.end() || level_it->second.empty()) return std::nullopt;
   std::vector<size_t> src_ids;
-  if (src_level == 0) {
-    const auto& l0 = level_sst_ids[0];
-    src_ids.assign(l0.begin(), l0.end());
-  } else {
-    const auto& ids = level_sst_ids[src_level];
-    if (ids.empty()) return;
-    src_ids.push_back(ids[pick_compaction_index(src_level)]);
-  }
-  if (src_ids.empty()) return;
+  if (src_level == 0)
+    src_ids.assign(level_it->second.begin(), level_it->second.end());
+  else
+    src_ids.push_back(level_it->second[pick_compaction_index(src_level)]);
 
   // ── 2. 计算 src SST 们的 key range union ─────────────────────────────────
-  std::string range_min = ssts[src_ids[0]]->get_first_key();
-  std::string range_max = ssts[src_ids[0]]->get_last_key();
+  CompactionPlan plan{.src_level = src_level, .l0_runs = src_level == 0 ? l0_runs_ : 0};
+  std::string    range_min = ssts.at(src_ids[0])->get_first_key();
+  plan.range_max           = ssts.at(src_ids[0])->get_last_key();
   for (size_t id : src_ids) {
-    const auto& s = ssts[id];
+    const auto& s = ssts.at(id);
     if (s->get_first_key() < range_min) range_min = s->get_first_key();
-    if (s->get_last_key()  > range_max) range_max = s->get_last_key();
+    if (s->get_last_key()  > plan.range_max) plan.range_max = s->get_last_key();
+    plan.src.push_back(s);
+  }
+
+  // ── 3. 找 dst_level 里的交集 SST，以及判断墓碑能否丢弃要看的更深层 ─────
+  for (size_t id : find_overlapping_ssts(dst_level, range_min, plan.range_max))
+    plan.dst.push_back(ssts.at(id));
+  for (size_t level = dst_level + 1; level <= cur_max_level; ++level) {
+    auto it = level_sst_ids.find(level);
+    if (it == level_sst_ids.end()) continue;
+    for (auto id : it->second)
+      if (auto sit = ssts.find(id); sit != ssts.end() && sit->second)
+        plan.deeper.push_back(sit->second);
   }
+  return plan;
+}
 
-  // ── 3. 找 dst_level 里的交集 SST ────────────────────────────────────────
-  std::vector<size_t> dst_ids =
-      find_overlapping_ssts(dst_level, range_min, range_max);
+void LSM_Engine::leveled_compact(size_t src_level) {
+  const size_t dst_level = src_level + 1;
+  auto         plan      = plan_compaction(src_level);
+  if (!plan) return;
 
   // ── 4. 执行合并 ──────────────────────────────────────────────────────────
-  std::vector<std::shared_ptr<Sstable>> new_ssts =
-      compact_ssts(src_ids, dst_ids, dst_level);
+  std::vector<std::shared_ptr<Sstable>> new_ssts = compact_ssts(*plan);
 
   // ── 5. Manifest: 先 ADD 新 SST (crash 后旧 SST 仍在，安全) ─────────────
   for (const auto& sst : new_ssts) {
@@ -867,53 +1243,55 @@ void LSM_Engine::leveled_compact(size_t src_level) {
   }
   manifest_->sync();
 
-  // ── 6. 删旧 SST + REMOVE_SST ────────────────────────────────────────────
-  auto erase_ssts = [&](const std::vector<size_t>& ids, size_t level) {
-    for (auto id : ids) {
-      level_size[level] -= ssts[id]->get_sst_size();
-      ssts[id]->del_sst();
-      ssts.erase(id);
-      manifest_->remove_sst(id);
-    }
-  };
-  erase_ssts(src_ids, src_level);
-  erase_ssts(dst_ids, dst_level);
+  // ── 6. REMOVE_SST ────────────────────────────────────────────────────────
+  for (const auto& sst : plan->src) manifest_->remove_sst(sst->get_sst_id());
+  for (const auto& sst : plan->dst) manifest_->remove_sst(sst->get_sst_id());
   manifest_->sync();
 
   // ── 7. 更新内存索引 ──────────────────────────────────────────────────────
-  if (src_level == 0) {
-    level_sst_ids[0].clear();
-  } else {
-    auto& dq = level_sst_ids[src_level];
-    for (auto id : src_ids) {
-      if (auto it = std::ranges::find(dq, id); it != dq.end())
-        dq.erase(it);
-    }
-  }
+  bool cascade = false;
   {
-    auto& dq = level_sst_ids[dst_level];
-    for (auto id : dst_ids) {
-      if (auto it = std::ranges::find(dq, id); it != dq.end())
-        dq.erase(it);
+    std::unique_lock<std::shared_mutex> lock(ssts_mtx);
+    auto erase_ssts = [&](const std::vector<std::shared_ptr<Sstable>>& old, size_t level) {
+      auto& dq = level_sst_ids[level];
+      for (const auto& sst : old) {
+        const size_t id = sst->get_sst_id();
+        level_size[level] -= sst->get_sst_size();
+        ssts.erase(id);
+        if (auto it = std::ranges::find(dq, id); it != dq.end())
+          dq.erase(it);
+      }
+    };
+    erase_ssts(plan->src, src_level);
+    erase_ssts(plan->dst, dst_level);
+    if (src_level == 0)
+      l0_runs_ -= plan->l0_runs;
+    cur_max_level = std::max(cur_max_level, dst_level);
+    for (const auto& sst : new_ssts) {
+      const size_t id = sst->get_sst_id();
+      level_size[dst_level] += sst->get_sst_size();
+      level_sst_ids[dst_level].push_back(id);
+      ssts[id] = sst;
     }
+    // sst_id 升序 == first_key 升序，维持二分查找的前提
+    std::sort(level_sst_ids[dst_level].begin(), level_sst_ids[dst_level].end());
+    refresh_stall_inputs();
+
+    size_t budget_mb = Global_::L1_BUDGET_MB;
+    for (size_t i = 0; i < src_level; ++i) budget_mb *= 10; // 10^(src_level) MB
+    cascade = bytes_to_mb(level_size[dst_level]) >= budget_mb / 2;
   }
-  cur_max_level = std::max(cur_max_level, dst_level);
-  for (const auto& sst : new_ssts) {
-    const size_t id = sst->get_sst_id();
-    level_size[dst_level] += sst->get_sst_size();
-    level_sst_ids[dst_level].push_back(id);
-    ssts[id] = sst;
-  }
-  // sst_id 升序 == first_key 升序，维持二分查找的前提
-  std::sort(level_sst_ids[dst_level].begin(), level_sst_ids[dst_level].end());
+  write_controller_.notify();
 
-  // ── 8. 更新 round-robin 指针 ─────────────────────────────────────────────
-  compaction_pointer_[src_level] = std::move(range_max);
+  // ── 8. 删旧文件 ──────────────────────────────────────────────────────────
+  for (const auto& sst : plan->src) sst->del_sst();
+  for (const auto& sst : plan->dst) sst->del_sst();
 
-  // ── 9. dst_level 超限时级联触发 ─────────────────────────────────────────
-size_t budget_mb = Global_::L1_BUDGET_MB;
-  for (size_t i = 0; i < src_level; ++i) budget_mb *= 10; // 10^(src_level) MB
-  if (bytes_to_mb(level_size[dst_level]) >= budget_mb/2)
+  // ── 9. 更新 round-robin 指针 ─────────────────────────────────────────────
+  compaction_pointer_[src_level] = std::move(plan->range_max);
+
+  // ── 10. dst_level 超限时级联触发 ────────────────────────────────────────
+  if (cascade)
     leveled_compact(dst_level);
 }
 
@@ -957,14 +1335,15 @@ std::vector<SstIterator> LSM_Engine::merge_sst_iterator(std::vector<std::size_t>
 //  LSM façade
 // ════════════════════════════════════════════════════════════════════════════
 
-LSM::LSM(std::string path) : engine(std::make_shared<LSM_Engine>(path)) {}
+LSM::LSM(std::string path, Global_::MemTableShardMode shard_mode,
+         Global_::MemTableRepType memtable_rep, size_t wal_streams)
+    : engine(std::make_shared<LSM_Engine>(path, Global_::Block_CACHE_capacity,
+                                          Global_::Block_CACHE_K, shard_mode,
+                                          Global_::FLUSH_THREAD_NUM, memtable_rep,
+                                          wal_streams)) {}
 
 LSM::~LSM() { flush_all(); }
 
-uint64_t LSM::getNextTransactionId() {
-  return engine->nextTransactionId_.fetch_add(1);
-}
-
 void LSM::print_level_range(size_t level) {
   for (auto& [key, value] : engine->print_level_range(level))
     std::print("key:{},value:{}\n", key, value);
@@ -974,15 +1353,21 @@ std::vector<SstMeta> LSM::get_manifest_info() const {
   return engine->get_manifest_info();
 }
 
-std::optional<std::string> LSM::get(std::string_view key) {
-  auto res = engine->get(key, getNextTransactionId());
+WriteStallStats LSM::write_stall_stats() const {
+  return engine->write_stall_stats();
+}
+
+std::optional<std::string> LSM::get(std::string_view key, const ReadOptions& options) {
+  const LSM_Engine::ReadView view(*engine);
+  auto                       res = engine->get(key, view.tranc_id(), options);
   if (res.has_value()) return res.value().first;
   return std::nullopt;
 }
 
 std::vector<std::pair<std::string, std::optional<std::string>>> LSM::get_batch(
-    const std::vector<std::string>& keys) {
-  auto batch_results = engine->get_batch(keys, getNextTransactionId());
+    const std::vector<std::string>& keys, const ReadOptions& options) {
+  const LSM_Engine::ReadView view(*engine);
+  auto batch_results = engine->get_batch(keys, view.tranc_id(), options);
   std::vector<std::pair<std::string, std::optional<std::string>>> results;
   for (const auto& [key, value, tr] : batch_results)
     results.emplace_back(key, value);
@@ -996,23 +1381,25 @@ std::vector<std::pair<std::string, std::string>> LSM::range(const std::string& /
 
 std::vector<std::tuple<std::string, std::string, uint64_t>> LSM::get_prefix_range(
     const std::string& prefix) {
-  return engine->get_prefix_range(prefix, getNextTransactionId());
+  const LSM_Engine::ReadView view(*engine);
+  return engine->get_prefix_range(prefix, view.tranc_id());
 }
 
-void LSM::put(const std::string& key, const std::string& value) {
-  engine->put(key, value, getNextTransactionId());
+void LSM::put(const std::string& key, const std::string& value, const WriteOptions& options) {
+  engine->put(key, value, /*tranc_id=*/0, options);
 }
 
-void LSM::put_batch(const std::vector<std::pair<std::string, std::string>>& kvs) {
-  engine->put_batch(kvs, getNextTransactionId());
+void LSM::put_batch(const std::vector<std::pair<std::string, std::string>>& kvs,
+                    const WriteOptions&                                     options) {
+  engine->put_batch(kvs, /*tranc_id=*/0, options);
 }
 
-void LSM::remove(const std::string& key) {
-  engine->remove(key, getNextTransactionId());
+void LSM::remove(const std::string& key, const WriteOptions& options) {
+  engine->remove(key, /*tranc_id=*/0, options);
 }
 
-void LSM::remove_batch(const std::vector<std::string>& keys) {
-  engine->remove_batch(keys, getNextTransactionId());
+void LSM::remove_batch(const std::vector<std::string>& keys, const WriteOptions& options) {
+  engine->remove_batch(keys, /*tranc_id=*/0, options);
 }
 
 void LSM::clear() { engine->clear(); }
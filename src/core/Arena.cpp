@@ -0,0 +1,67 @@
+#include "../../include/core/Arena.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+
+Arena::Arena(WriteBufferManager* wbm) : current_(nullptr), memory_usage_(0), tracker_(wbm) {}
+
+char* Arena::allocate(size_t bytes) {
+  bytes = (bytes + kAlign - 1) & ~(kAlign - 1);
+  Block* block = current_.load(std::memory_order_acquire);
+  if (block != nullptr) {
+    // 失败时 used 会超过 size, 该块此后只会走慢路径, 不影响正确性
+    size_t offset = block->used.fetch_add(bytes, std::memory_order_relaxed);
+    if (offset + bytes <= block->size) {
+      return block->data.get() + offset;
+    }
+  }
+  return allocate_slow(bytes);
+}
+
+char* Arena::allocate_slow(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 大对象单独成块, 避免浪费当前块剩下的空间
+  if (bytes > Global_::ARENA_BLOCK_SIZE / 4) {
+    return new_block(bytes, bytes)->data.get();
+  }
+  // 拿锁期间可能已经有别的线程换好了新块
+  Block* block = current_.load(std::memory_order_relaxed);
+  if (block != nullptr) {
+    size_t offset = block->used.fetch_add(bytes, std::memory_order_relaxed);
+    if (offset + bytes <= block->size) {
+      return block->data.get() + offset;
+    }
+  }
+  // 新块在发布前就把本次分配算进 used, 保证这次一定放得下
+  block = new_block(Global_::ARENA_BLOCK_SIZE, bytes);
+  current_.store(block, std::memory_order_release);
+  return block->data.get();
+}
+
+Arena::Block* Arena::new_block(size_t block_bytes, size_t used) {
+  auto block  = std::make_unique<Block>();
+  block->data = std::make_unique_for_overwrite<char[]>(block_bytes);
+  block->size = block_bytes;
+  block->used.store(used, std::memory_order_relaxed);
+  memory_usage_.fetch_add(block_bytes, std::memory_order_relaxed);
+  tracker_.allocate(block_bytes);
+  blocks_.push_back(std::move(block));
+  return blocks_.back().get();
+}
+
+size_t Arena::memory_usage() const {
+  return memory_usage_.load(std::memory_order_relaxed);
+}
+
+void Arena::charge(size_t bytes) {
+  memory_usage_.fetch_add(bytes, std::memory_order_relaxed);
+  tracker_.allocate(bytes);
+}
+
+void Arena::done_allocating() {
+  tracker_.done_allocating();
+}
+
+WriteBufferManager* Arena::write_buffer_manager() const {
+  return tracker_.write_buffer_manager();
+}
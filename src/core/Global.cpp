@@ -1,6 +1,158 @@
 #include "../../include/core/Global.h"
+#include <cstring>
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define TINYDB_CRC32C_X86 1
+#endif
+
 int Global_::generateRandom(int begin, int end) {
   static std::mt19937                generator(std::random_device{}());
   std::uniform_int_distribution<int> distribution(begin, end);
   return distribution(generator);
 }
+
+// ─── CRC-32C ──────────────────────────────────────────────────────────────────
+namespace {
+
+using Crc32cFn = uint32_t (*)(std::span<const uint8_t>) noexcept;
+
+#ifdef TINYDB_CRC32C_X86
+// 三路并行时每一路的长度; 三段各自算完后合并
+constexpr size_t kCrcStride = 256;
+
+uint64_t load_u64(const uint8_t* p) noexcept {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_tail(uint32_t crc, const uint8_t* p,
+                                                       size_t n) noexcept {
+  uint64_t c = crc;
+  for (; n >= 8; n -= 8, p += 8) c = _mm_crc32_u64(c, load_u64(p));
+  crc = static_cast<uint32_t>(c);
+  for (; n > 0; --n, ++p) crc = _mm_crc32_u8(crc, *p);
+  return crc;
+}
+
+__attribute__((target("sse4.2"))) uint32_t crc32c_sse42(std::span<const uint8_t> data) noexcept {
+  return ~crc32c_tail(~0u, data.data(), data.size());
+}
+
+// x^e mod P, 按 CRC 寄存器的反射位序表示 (bit 31 是 x^0)
+constexpr uint32_t xpow_mod(size_t e) noexcept {
+  uint32_t v = 0x80000000u;
+  while (e-- > 0) v = (v >> 1) ^ (0x82F63B78u & -(v & 1u));
+  return v;
+}
+// 寄存器 r 之后再跟 n 个 0 字节等价于 r * x^(8n) mod P.
+// clmul(r, x^(8n-33)) 得到的 64 位积在反射位序下是 r * x^(8n-33) * x,
+// 再喂给 crc32 指令 (相当于乘 x^32 后取模) 正好是 r * x^(8n) mod P
+constexpr uint64_t kShift1 = xpow_mod(8 * kCrcStride - 33);      // 跨过一段
+constexpr uint64_t kShift2 = xpow_mod(8 * 2 * kCrcStride - 33);  // 跨过两段
+
+__attribute__((target("sse4.2,pclmul"))) uint32_t crc32c_pclmul(
+    std::span<const uint8_t> data) noexcept {
+  const uint8_t* p   = data.data();
+  size_t         n   = data.size();
+  uint32_t       crc = ~0u;
+  // crc32 指令延迟 3 个周期、吞吐 1 个周期: 三条互不依赖的流水把它喂满
+  while (n >= 3 * kCrcStride) {
+    uint64_t c0 = crc, c1 = 0, c2 = 0;
+    for (size_t i = 0; i < kCrcStride; i += 8) {
+      c0 = _mm_crc32_u64(c0, load_u64(p + i));
+      c1 = _mm_crc32_u64(c1, load_u64(p + kCrcStride + i));
+      c2 = _mm_crc32_u64(c2, load_u64(p + 2 * kCrcStride + i));
+    }
+    // CRC 是线性的: 整体 = c0 后移两段 ^ c1 后移一段 ^ c2
+    const __m128i folded = _mm_xor_si128(
+        _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<int64_t>(c0)),
+                             _mm_cvtsi64_si128(static_cast<int64_t>(kShift2)), 0x00),
+        _mm_clmulepi64_si128(_mm_cvtsi64_si128(static_cast<int64_t>(c1)),
+                             _mm_cvtsi64_si128(static_cast<int64_t>(kShift1)), 0x00));
+    crc = static_cast<uint32_t>(
+              _mm_crc32_u64(0, static_cast<uint64_t>(_mm_cvtsi128_si64(folded)))) ^
+          static_cast<uint32_t>(c2);
+    p += 3 * kCrcStride;
+    n -= 3 * kCrcStride;
+  }
+  return ~crc32c_tail(crc, p, n);
+}
+
+bool cpu_has(unsigned ecx_bit) noexcept {
+  unsigned eax, ebx, ecx, edx;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & ecx_bit) != 0;
+}
+#endif
+
+bool supported(Global_::Crc32cImpl impl) noexcept {
+  switch (impl) {
+    case Global_::Crc32cImpl::kPortable:
+      return true;
+#ifdef TINYDB_CRC32C_X86
+    case Global_::Crc32cImpl::kSse42:
+      return cpu_has(bit_SSE4_2);
+    case Global_::Crc32cImpl::kPclmul:
+      return cpu_has(bit_SSE4_2) && cpu_has(bit_PCLMUL);
+#endif
+    default:
+      return false;
+  }
+}
+
+Crc32cFn impl_fn(Global_::Crc32cImpl impl) noexcept {
+  if (!supported(impl))
+    return Global_::crc32c_portable;
+  switch (impl) {
+#ifdef TINYDB_CRC32C_X86
+    case Global_::Crc32cImpl::kSse42:
+      return crc32c_sse42;
+    case Global_::Crc32cImpl::kPclmul:
+      return crc32c_pclmul;
+#endif
+    default:
+      return Global_::crc32c_portable;
+  }
+}
+
+Global_::Crc32cImpl pick_impl() noexcept {
+  for (auto impl : {Global_::Crc32cImpl::kPclmul, Global_::Crc32cImpl::kSse42}) {
+    if (supported(impl))
+      return impl;
+  }
+  return Global_::Crc32cImpl::kPortable;
+}
+
+struct Crc32cChoice {
+  Global_::Crc32cImpl impl;
+  Crc32cFn            fn;
+};
+
+// 第一次调用时选定, 之后只读. 不用命名空间级的全局变量: 别的翻译单元的静态初始化
+// 可能先于这里调用 crc32c, 那时全局变量还没初始化
+const Crc32cChoice& choice() noexcept {
+  static const Crc32cChoice chosen = [] {
+    const auto impl = pick_impl();
+    return Crc32cChoice{impl, impl_fn(impl)};
+  }();
+  return chosen;
+}
+
+}  // namespace
+
+Global_::Crc32cImpl Global_::crc32c_impl() noexcept {
+  return choice().impl;
+}
+
+bool Global_::crc32c_supported(Crc32cImpl impl) noexcept {
+  return supported(impl);
+}
+
+uint32_t Global_::crc32c(Crc32cImpl impl, std::span<const uint8_t> data) noexcept {
+  return impl_fn(impl)(data);
+}
+
+uint32_t Global_::crc32c(std::span<const uint8_t> data) noexcept {
+  return choice().fn(data);
+}
@@ -0,0 +1,158 @@
+#include "../../include/core/HashTableRep.h"
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+namespace {
+// 与 Skiplist 相同的排序: key 升序, 同 key 时 transaction_id 降序
+bool node_before(const Node* n, std::string_view key, uint64_t prefix, uint64_t transaction_id) {
+  int res = n->compare_key(key, prefix);
+  return res < 0 || (res == 0 && n->transaction_id > transaction_id);
+}
+}  // namespace
+
+HashTableRep::HashTableRep(size_t bucket_count, WriteBufferManager* wbm)
+    : arena_(std::make_unique<Arena>(wbm)),
+      buckets_(std::make_unique<std::atomic<Node*>[]>(std::bit_ceil(std::max<size_t>(bucket_count, 1)))),
+      mask_(std::bit_ceil(std::max<size_t>(bucket_count, 1)) - 1),
+      size_bytes_(0),
+      nodecount_(0),
+      num_shard_(0) {
+  arena_->charge((mask_ + 1) * sizeof(std::atomic<Node*>));
+}
+
+std::atomic<Node*>& HashTableRep::bucket_of(std::string_view key) const {
+  // 分片已经用 fast_hash 的低位选过了, 这里换一个哈希函数, 避免桶号与分片号相关
+  return buckets_[std::hash<std::string_view>{}(key) & mask_];
+}
+
+bool HashTableRep::Insert(std::string_view key, std::string_view value,
+                          const uint64_t transaction_id) {
+  auto           node   = Node::create(*arena_, key, value, transaction_id, 1);
+  auto&          bucket = bucket_of(key);
+  const uint64_t prefix = node->prefix();
+  Node*          prev   = nullptr;
+  Node*          next   = bucket.load(std::memory_order_acquire);
+  for (;;) {
+    while (next && node_before(next, key, prefix, transaction_id)) {
+      prev = next;
+      next = next->next(0);
+    }
+    node->no_barrier_set_next(0, next);
+    // CAS 失败时 next 被更新成前驱当前的后继, 从 prev 继续往后找即可
+    const bool linked = prev ? prev->cas_next(0, next, node)
+                             : bucket.compare_exchange_strong(next, node, std::memory_order_acq_rel,
+                                                              std::memory_order_acquire);
+    if (linked) {
+      break;
+    }
+  }
+  size_bytes_ += node->size();
+  nodecount_++;
+  return true;
+}
+
+Node* HashTableRep::find_first(std::string_view key) const {
+  const uint64_t prefix = Node::key_prefix(key);
+  for (auto current = bucket_of(key).load(std::memory_order_acquire); current;
+       current      = current->next(0)) {
+    int res = current->compare_key(key, prefix);
+    if (res == 0) {
+      return current;
+    }
+    if (res > 0) {
+      break;
+    }
+  }
+  return nullptr;
+}
+
+std::optional<LookupResult> HashTableRep::Get(std::string_view key,
+                                              const uint64_t   transaction_id) {
+  for (auto current = find_first(key); current && cmp(current->key(), key) == 0;
+       current      = current->next(0)) {
+    if (transaction_id == 0 || current->transaction_id <= transaction_id) {
+      return LookupResult(std::string(current->value()), current->transaction_id);
+    }
+  }
+  return std::nullopt;
+}
+
+Node* HashTableRep::get_node(std::string_view key, const uint64_t transaction_id) {
+  for (auto current = find_first(key); current && cmp(current->key(), key) == 0;
+       current      = current->next(0)) {
+    if (transaction_id == 0) {
+      return current;
+    }
+    if (current->transaction_id <= transaction_id) {
+      return current->value().empty() ? nullptr : current;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<std::tuple<std::string, std::string, uint64_t>> HashTableRep::get_prefix_range(
+    std::string_view prefix, uint64_t tranc_id) {
+  std::vector<std::tuple<std::string, std::string, uint64_t>> result;
+  for (size_t i = 0; i <= mask_; ++i) {
+    for (auto current = buckets_[i].load(std::memory_order_acquire); current;
+         current      = current->next(0)) {
+      if (tranc_id != 0 && current->transaction_id > tranc_id) {
+        continue;
+      }
+      if (current->key().starts_with(prefix)) {
+        result.emplace_back(current->key(), current->value(), current->transaction_id);
+      }
+    }
+  }
+  std::ranges::sort(result, [](const auto& a, const auto& b) {
+    return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) < std::get<0>(b)
+                                            : std::get<2>(a) > std::get<2>(b);
+  });
+  return result;
+}
+
+std::size_t HashTableRep::get_size() {
+  return size_bytes_;
+}
+
+std::size_t HashTableRep::memory_usage() {
+  return arena_->memory_usage();
+}
+
+std::size_t HashTableRep::getnodecount() {
+  return nodecount_;
+}
+
+void HashTableRep::set_num_shard(int num_shard) {
+  num_shard_ = num_shard;
+}
+
+int HashTableRep::get_num_shard() const {
+  return num_shard_;
+}
+
+std::unique_ptr<Skiplist> HashTableRep::to_skiplist(VersionCollapser* collapser) {
+  std::vector<Node*> nodes;
+  nodes.reserve(nodecount_.load(std::memory_order_relaxed));
+  for (size_t i = 0; i <= mask_; ++i) {
+    for (auto current = buckets_[i].load(std::memory_order_acquire); current;
+         current      = current->next(0)) {
+      nodes.push_back(current);
+    }
+  }
+  // 同一个 key 只会出现在同一个桶里, 桶内顺序已经是最终顺序 (同 id 时后插入的在前),
+  // 稳定排序保留这一点
+  std::ranges::stable_sort(nodes, [](const Node* a, const Node* b) {
+    return node_before(a, b->key(), b->prefix(), b->transaction_id);
+  });
+  auto table = std::make_unique<Skiplist>(Global_::MAX_LEVEL, arena_->write_buffer_manager());
+  table->set_num_shard(num_shard_);
+  for (auto node : nodes) {
+    if (collapser && !collapser->keep(node->key(), node->transaction_id)) {
+      continue;
+    }
+    table->Append(node->key(), node->value(), node->transaction_id);
+  }
+  return table;
+}
@@ -1,11 +1,45 @@
 #include "../../include/core/Skiplist.h"
 #include <algorithm>
+#include <bit>
 #include <cstddef>
+#include <cstring>
+#include <new>
 #include <memory>
 #include <string_view>
 
 auto Node::operator<=>(const Node& other) const {
-  return key_ <=> other.key_;
+  return key() <=> other.key();
+}
+
+uint64_t Node::key_prefix(std::string_view key) {
+  uint64_t prefix = 0;
+  std::memcpy(&prefix, key.data(), std::min(key.size(), sizeof(prefix)));
+  if constexpr (std::endian::native == std::endian::little) {
+    prefix = std::byteswap(prefix);
+  }
+  return prefix;
+}
+
+size_t Node::alloc_size(int height, size_t key_size, size_t value_size) {
+  // forward 是最后一个成员, sizeof(Node) 已经包含了 forward[0]
+  return sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1) + key_size + value_size;
+}
+
+Node* Node::create(Arena& arena, std::string_view key, std::string_view value,
+                   uint64_t transaction_id, int height) {
+  char* mem  = arena.allocate(alloc_size(height, key.size(), value.size()));
+  auto  node = new (mem) Node(transaction_id, key_prefix(key), key.size(), value.size(), height);
+  for (int i = 1; i < height; ++i) {
+    new (&node->forward[i]) std::atomic<Node*>(nullptr);
+  }
+  node->forward[0].store(nullptr, std::memory_order_relaxed);
+  if (!key.empty()) {
+    std::memcpy(node->payload(), key.data(), key.size());
+  }
+  if (!value.empty()) {
+    std::memcpy(node->payload() + key.size(), value.data(), value.size());
+  }
+  return node;
 }
 
 SkiplistIterator::SkiplistIterator(Node* skiplist) {
@@ -14,7 +48,7 @@ SkiplistIterator::SkiplistIterator(Node* skiplist) {
 SkiplistIterator::SkiplistIterator() : current(nullptr) {}
 BaseIterator& SkiplistIterator::operator++() {
   if (current) {
-    current = current->next_.get();
+    current = current->next(0);
   }
   return *this;
 }
@@ -27,7 +61,7 @@ bool operator==(const SkiplistIterator& lhs, const SkiplistIterator& rhs) noexce
 
 SkiplistIterator::valuetype SkiplistIterator::operator*() const {
   if (current) {
-    return {current->key_, current->value_};
+    return {std::string(current->key()), std::string(current->value())};
   }
   return {};
 }
@@ -55,86 +89,159 @@ uint64_t SkiplistIterator::get_tranc_id() const {
 }
 SkiplistIterator::valuetype SkiplistIterator::getValue() const {
   if (current) {
-    return {current->key_, current->value_};
+    return {std::string(current->key()), std::string(current->value())};
   }
   return {};
 }
+std::string_view SkiplistIterator::key() const {
+  return current ? current->key() : std::string_view{};
+}
+std::string_view SkiplistIterator::value() const {
+  return current ? current->value() : std::string_view{};
+}
 std::tuple<std::string, std::string, uint64_t> SkiplistIterator::get_value_tranc_id() const {
   if (current) {
-    return {current->key_, current->value_, current->transaction_id};
+    return {std::string(current->key()), std::string(current->value()), current->transaction_id};
   }
   return {std::string(), std::string(), 0};
 }
 
-bool Skiplist::Insert(std::string key, std::string value, const uint64_t transaction_id) {
-  std::array<Node*, Global_::FIX_LEVEL> update;
-  update.fill(nullptr);
-  auto current = head.get();
+// 预取下一跳要读的节点; 比较 key_prefix 时它所在的缓存行大概率已经到了
+static inline void prefetch_node(const Node* node) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(node, 0, 1);
+#endif
+}
+
+// 节点 n 是否应排在 (key, transaction_id) 之前: key 升序, 同 key 时 transaction_id 降序
+static bool node_before(const Node* n, std::string_view key, uint64_t prefix,
+                        uint64_t transaction_id) {
+  int res = n->compare_key(key, prefix);
+  return res < 0 || (res == 0 && n->transaction_id > transaction_id);
+}
 
-  // 查找插入位置
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, key) == -1) {
-      current = current->forward[i];
+void Skiplist::find_splice_for_level(std::string_view key, uint64_t prefix,
+                                     uint64_t transaction_id, Node* before, int level, Node** prev,
+                                     Node** next) {
+  for (;;) {
+    Node* after = before->next(level);
+    if (after) {
+      prefetch_node(after->next(level));
     }
-    update[i] = current;  // 记录需要更新的节点
+    if (after == nullptr || !node_before(after, key, prefix, transaction_id)) {
+      *prev = before;
+      *next = after;
+      return;
+    }
+    before = after;
   }
-  // 拿到新的节点的高度
-  int Newlevel = random_level();
-  if (Newlevel > current_level) {
-    for (int i = current_level; i < Newlevel; i++) {
-      update[i] = head.get();
+}
+
+Node* Skiplist::find_greater_or_equal(std::string_view key) const {
+  const uint64_t prefix  = Node::key_prefix(key);
+  Node*          current = head;
+  for (int i = current_level.load(std::memory_order_relaxed) - 1; i >= 0; i--) {
+    Node* next = current->next(i);
+    while (next) {
+      Node* after = next->next(i);
+      if (after) {
+        prefetch_node(after);
+      }
+      if (next->compare_key(key, prefix) >= 0) {
+        break;
+      }
+      current = next;
+      next    = after;
     }
-    current_level = Newlevel;  // 提前更新 current_level
   }
- 
-  // 创建新节点
-  auto NewNode = std::make_unique<Node>(key, value, transaction_id);
-  // 插入新节点 
-  size_bytes += (key.size() + value.size() + sizeof(uint64_t) + 8 * (Global_::FIX_LEVEL + 1));
+  return current->next(0);
+}
+
+bool Skiplist::Insert(std::string_view key, std::string_view value, const uint64_t transaction_id) {
+  // 拿到新的节点的高度, 必要时抬高 current_level
+  const int Newlevel  = random_level();
+  int       max_level = current_level.load(std::memory_order_relaxed);
+  while (Newlevel > max_level &&
+         !current_level.compare_exchange_weak(max_level, Newlevel, std::memory_order_relaxed)) {
+  }
+
+  // 查找插入位置: 自顶向下逐层记录前驱/后继
+  std::array<Node*, Global_::MAX_LEVEL> prev{};
+  std::array<Node*, Global_::MAX_LEVEL> next{};
+  const uint64_t                        prefix  = Node::key_prefix(key);
+  auto                                  current = head;
+  for (int i = std::max(Newlevel, max_level) - 1; i >= 0; i--) {
+    find_splice_for_level(key, prefix, transaction_id, current, i, &prev[i], &next[i]);
+    current = prev[i];
+  }
+
+  // key/value/tranc_id 与按实际高度分配的 forward 一次性放进 Arena
+  auto NewNode = Node::create(*arena_, key, value, transaction_id, Newlevel);
+  size_bytes += NewNode->size();
+  // 自底向上逐层 CAS 挂链; 第 0 层成功后节点即对读者可见.
+  // CAS 失败说明有并发写者插在了前面, 从原前驱开始重新定位该层
   for (int i = 0; i < Newlevel; i++) {
-    NewNode->forward[i]   = update[i]->forward[i];
-    update[i]->forward[i] = NewNode.get();
+    for (;;) {
+      NewNode->no_barrier_set_next(i, next[i]);
+      if (prev[i]->cas_next(i, next[i], NewNode)) {
+        break;
+      }
+      find_splice_for_level(key, prefix, transaction_id, prev[i], i, &prev[i], &next[i]);
+    }
   }
-  NewNode->next_   = std::move(update[0]->next_);
-  update[0]->next_ = std::move(NewNode);
-  // 更新当前层级
-  current_level = std::max(current_level, Newlevel);
   nodecount++;
   return true;
 }
 
+void Skiplist::Append(std::string_view key, std::string_view value,
+                      const uint64_t transaction_id) {
+  const int height = random_level();
+  if (height > current_level.load(std::memory_order_relaxed)) {
+    current_level.store(height, std::memory_order_relaxed);
+  }
+  auto node = Node::create(*arena_, key, value, transaction_id, height);
+  for (int i = 0; i < height; ++i) {
+    (append_tail_[i] ? append_tail_[i] : head)->set_next(i, node);
+    append_tail_[i] = node;
+  }
+  size_bytes += node->size();
+  nodecount++;
+}
+
 bool Skiplist::Delete(std::string_view key) {
-  auto                                  current = head.get();
-  std::array<Node*, Global_::FIX_LEVEL> update{};
+  auto                                  current = head;
+  std::array<Node*, Global_::MAX_LEVEL> update{};
+  int                                   level = current_level.load(std::memory_order_relaxed);
+  const uint64_t                        prefix = Node::key_prefix(key);
 
   // 查找删除位置
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && current->forward[i]->key_ < key) {
-      current = current->forward[i];
+  for (int i = level - 1; i >= 0; --i) {
+    while (current->next(i) && current->next(i)->compare_key(key, prefix) < 0) {
+      current = current->next(i);
     }
     update[i] = current;  // 记录需要更新的节点
   }
   // 删除节点
-  auto target = current->forward[0];
-  if (target && target->key_ == key) {
-    for (int i = 0; i < current_level; ++i) {
-      if (update[i]) {
-        update[i]->forward[i] = target->forward[i];
+  auto target = current->next(0);
+  if (target && target->key() == key) {
+    for (int i = 0; i < target->height(); ++i) {
+      if (update[i] && update[i]->next(i) == target) {
+        update[i]->set_next(i, target->next(i));
       }
     }
-    size_bytes -= (target->key_.size() + target->value_.size() + sizeof(uint64_t) +
-                   8 * (Global_::FIX_LEVEL + 1));
-    update[0]->next_ = std::move(target->next_);
+    // 节点内存留在 Arena 里随跳表一起释放, 这里只摘链并扣掉占用
+    size_bytes -= target->size();
     nodecount--;
   }
 
   // 更新当前层级
   // 如果当前层级的节点为空，则需要更新当前层级
-  for (int i = current_level - 1; i >= 0; --i) {
-    if (head->forward[i] == nullptr && nodecount) {
-      current_level--;
+  for (int i = level - 1; i >= 0; --i) {
+    if (head->next(i) == nullptr && nodecount) {
+      level--;
     }
   }
+  current_level.store(level, std::memory_order_relaxed);
   return true;
 }
   void Skiplist::set_num_shard(int num_shard){
@@ -144,56 +251,21 @@ bool Skiplist::Delete(std::string_view key) {
 return num_shard_;
   }
 std::optional<std::string> Skiplist::Contain(std::string_view key, const uint64_t transaction_id) {
-  auto current = head.get();
-  // 从最高层开始查找
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, key) == -1) {
-      current = current->forward[i];
-    }
-  }
-  if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0) {
-    if (transaction_id == 0) {
-      return current->forward[0]->value_;
-    } else {
-      while (current->forward[0] && cmp(current->forward[0]->key_, key) == 0 &&
-             current->forward[0]->transaction_id > transaction_id) {
-        current = current->forward[0];
-      }
-      if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0) {
-        return current->forward[0]->value_;
-      } else if (cmp(current->key_, key) == 0 && current->transaction_id <= transaction_id) {
-        return current->value_;
-      }
-      return std::nullopt;
+  // 同 key 的版本按 transaction_id 降序排列, 第一个不超过 transaction_id 的就是可见版本
+  for (auto current = find_greater_or_equal(key); current && cmp(current->key(), key) == 0;
+       current      = current->next(0)) {
+    if (transaction_id == 0 || current->transaction_id <= transaction_id) {
+      return std::string(current->value());
     }
   }
   return std::nullopt;  // 如果没有找到，返回空值
 }
 
 std::optional<LookupResult> Skiplist::Get(std::string_view key, const uint64_t transaction_id) {
-  auto current = head.get();
-  // 从最高层开始查找
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, key) == -1) {
-      current = current->forward[i];
-    }
-  }
-  if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0) {
-    if (transaction_id == 0) {
-      current = current->forward[0];
-      return LookupResult(current->value_, current->transaction_id);
-    } else {
-      while (current->forward[0] && cmp(current->forward[0]->key_, key) == 0 &&
-             current->forward[0]->transaction_id > transaction_id) {
-        current = current->forward[0];
-      }
-      if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0) {
-        current = current->forward[0];
-        return LookupResult(current->value_, current->transaction_id);
-      } else if (cmp(current->key_, key) == 0 && current->transaction_id <= transaction_id) {
-        return LookupResult(current->value_, current->transaction_id);
-      }
-      return std::nullopt;
+  for (auto current = find_greater_or_equal(key); current && cmp(current->key(), key) == 0;
+       current      = current->next(0)) {
+    if (transaction_id == 0 || current->transaction_id <= transaction_id) {
+      return LookupResult(std::string(current->value()), current->transaction_id);
     }
   }
   return std::nullopt;  // 如果没有找到，返回空值
@@ -201,39 +273,22 @@ std::optional<LookupResult> Skiplist::Get(std::string_view key, const uint64_t t
 
 std::vector<std::pair<std::string, std::string>> Skiplist::flush() {
   std::vector<std::pair<std::string, std::string>> result;
-  auto                                             current = head->forward[0];
+  auto                                             current = head->next(0);
   while (current) {
-    result.emplace_back(current->key_, current->value_);
-    current = current->forward[0];
+    result.emplace_back(current->key(), current->value());
+    current = current->next(0);
   }
   return result;
 }
 Node* Skiplist::get_node(std::string_view key, const uint64_t transaction_id) {
-  auto current = head.get();
-  // 从最高层开始查找
-  for (int i = current_level - 1; i >= 0; i--) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, key) == -1) {
-      current = current->forward[i];
-    }
-  }
-  if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0) {
+  for (auto current = find_greater_or_equal(key); current && cmp(current->key(), key) == 0;
+       current      = current->next(0)) {
     if (transaction_id == 0) {
-      current = current->forward[0];
       return current;
-    } else {
-      while (current->forward[0] && cmp(current->forward[0]->key_, key) == 0 &&
-             current->forward[0]->transaction_id > transaction_id) {
-        current = current->forward[0];
-      }
-      if (current->forward[0] && cmp(current->forward[0]->key_, key) == 0 &&
-          (!current->forward[0]->value_.empty())) {
-        current = current->forward[0];
-        return current;
-      } else if (cmp(current->key_, key) == 0 && current->transaction_id <= transaction_id &&
-                 (!current->value_.empty())) {
-        return current;
-      }
-      return nullptr;
+    }
+    if (current->transaction_id <= transaction_id) {
+      // 可见版本是删除标记时视为不存在
+      return current->value().empty() ? nullptr : current;
     }
   }
   return nullptr;  // 如果没有找到，返回空值
@@ -243,58 +298,55 @@ std::size_t Skiplist::get_size() {
   return size_bytes;
 }
 
+std::size_t Skiplist::memory_usage() {
+  return arena_->memory_usage();
+}
+
 std::size_t Skiplist::getnodecount() {
   return nodecount;
 }
 
-auto Skiplist::seekToFirst() {
-  return head->forward[0];
+Node* Skiplist::seekToFirst() {
+  return head->next(0);
 }  // 定位到第一个元素
-auto Skiplist::seekToLast() {
-  auto current = head->forward[0];
-  while (current->forward[0]) {
-    current = current->forward[0];
+Node* Skiplist::seekToLast() {
+  auto current = head;
+  for (int i = current_level.load(std::memory_order_relaxed) - 1; i >= 0; i--) {
+    while (current->next(i)) {
+      current = current->next(i);
+    }
   }
-  return current;
+  return current == head ? nullptr : current;
 }
 SkiplistIterator Skiplist::end() {
   return SkiplistIterator(nullptr);
 }
 SkiplistIterator Skiplist::begin() {
-  return SkiplistIterator(head->forward[0]);
+  return SkiplistIterator(head->next(0));
 }
 
 SkiplistIterator Skiplist::prefix_serach_begin(std::string_view key) {
-  auto current = head.get();
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, key) == -1) {
-      current = current->forward[i];
-    }
-  }
-  if (current && current->key_.starts_with(key)) {
+  auto current = find_greater_or_equal(key);
+  if (current && current->key().starts_with(key)) {
     return SkiplistIterator(current);
   }
-  if (current->forward[0] && current->forward[0]->key_.starts_with(key)) {
-    return SkiplistIterator(current->forward[0]);
-  }
   return SkiplistIterator(nullptr);
 }
 SkiplistIterator Skiplist::prefix_serach_end(std::string_view key) {
   std::string Newkey{key};
   Newkey += '\xFF';
-  auto current = head.get();
-  for (int i = current_level - 1; i >= 0; --i) {
-    while (current->forward[i] && cmp(current->forward[i]->key_, Newkey) == -1) {
-      current = current->forward[i];
-    }
-  }
-  return SkiplistIterator(current->forward[0]);
+  return SkiplistIterator(find_greater_or_equal(Newkey));
 }
 std::vector<std::tuple<std::string, std::string, uint64_t>> Skiplist::get_prefix_range(
     std::string_view prefix, uint64_t tranc_id) {
   auto                                                        end = prefix_serach_end(prefix);
   std::vector<std::tuple<std::string, std::string, uint64_t>> result;
-  for (auto begin = prefix_serach_begin(prefix); begin != end; ++begin) {
+  // 没有该前缀时 begin 为空而 end 可能指向更大的 key, 不能只比较 begin != end
+  for (auto begin = prefix_serach_begin(prefix); begin.valid() && begin != end; ++begin) {
+    // 跳过读取时还不可见的版本 (id 已分配但尚未发布)
+    if (tranc_id != 0 && begin.get_tranc_id() > tranc_id) {
+      continue;
+    }
     result.emplace_back(begin.get_value_tranc_id());
   }
   return result;
@@ -307,12 +359,108 @@ Global_::SkiplistStatus Skiplist::get_status() const {
   return cur_status;
 }
 
+std::unique_ptr<Skiplist> Skiplist::collapse_versions(const VersionCollapser& collapser) const {
+  // 先数一遍, 大多数表没有可丢的版本, 不必复制
+  auto   probe   = collapser;
+  size_t dropped = 0;
+  for (auto cur = head->next(0); cur; cur = cur->next(0)) {
+    dropped += probe.keep(cur->key(), cur->transaction_id) ? 0 : 1;
+  }
+  if (dropped == 0) {
+    return nullptr;
+  }
+  auto filter = collapser;
+  auto table  = std::make_unique<Skiplist>(max_level, arena_->write_buffer_manager());
+  table->set_num_shard(num_shard_);
+  for (auto cur = head->next(0); cur; cur = cur->next(0)) {
+    if (filter.keep(cur->key(), cur->transaction_id)) {
+      table->Append(cur->key(), cur->value(), cur->transaction_id);
+    }
+  }
+  return table;
+}
+
+std::unique_ptr<Skiplist> Skiplist::to_skiplist(VersionCollapser* collapser) {
+  auto table = std::make_unique<Skiplist>(max_level, arena_->write_buffer_manager());
+  table->set_num_shard(num_shard_);
+  for (auto cur = head->next(0); cur; cur = cur->next(0)) {
+    if (collapser && !collapser->keep(cur->key(), cur->transaction_id)) {
+      continue;
+    }
+    table->Append(cur->key(), cur->value(), cur->transaction_id);
+  }
+  return table;
+}
+
+void Skiplist::freeze() {
+  if (auto first = seekToFirst()) {
+    first_key_ = first->key();
+    last_key_  = seekToLast()->key();
+    // 按节点数定容量; 同 key 的多个版本相邻, 只加一次
+    filter_ = std::make_unique<BloomFilter>(std::max<size_t>(nodecount, 1),
+                                            Global_::bloom_filter_expected_error_rate_);
+    std::string_view prev;
+    for (auto cur = first; cur; cur = cur->next(0)) {
+      if (cur == first || cur->key() != prev) {
+        filter_->add(cur->key());
+        prev = cur->key();
+      }
+    }
+  }
+  arena_->done_allocating();
+  cur_status = Global_::SkiplistStatus::kFrozen;
+}
+std::string_view Skiplist::first_key() const {
+  return first_key_;
+}
+std::string_view Skiplist::last_key() const {
+  return last_key_;
+}
+bool Skiplist::covers(std::string_view key) const {
+  // 未冻结 (范围未知) 时保守地返回 true
+  if (cur_status == Global_::SkiplistStatus::kNormal) {
+    return true;
+  }
+  return nodecount > 0 && first_key_ <= key && key <= last_key_;
+}
+bool Skiplist::may_contain(std::string_view key) const {
+  return covers(key) && (filter_ == nullptr || filter_->possibly_contains(key));
+}
+bool Skiplist::overlaps(std::string_view lo, std::string_view hi) const {
+  if (cur_status == Global_::SkiplistStatus::kNormal) {
+    return true;
+  }
+  return nodecount > 0 && last_key_ >= lo && (hi.empty() || first_key_ < hi);
+}
+
+std::vector<std::string> Skiplist::sample_keys(size_t n) const {
+  std::vector<std::string> res;
+  if (n == 0 || nodecount == 0) {
+    return res;
+  }
+  // 第 i 层大约有 nodecount / 4^i 个节点, 选节点数仍不少于 n 的最高层
+  int    level = 0;
+  size_t count = static_cast<size_t>(nodecount.load());
+  while (level + 1 < current_level.load(std::memory_order_relaxed) && count / 4 >= n) {
+    count /= 4;
+    ++level;
+  }
+  const size_t stride = std::max<size_t>(1, count / n);
+  size_t       i      = 0;
+  for (auto cur = head->next(level); cur; cur = cur->next(level), ++i) {
+    if (i % stride == 0 && (res.empty() || res.back() != cur->key())) {
+      res.emplace_back(cur->key());
+    }
+  }
+  return res;
+}
+
 thread_local std::mt19937 Skiplist::gen(std::random_device{}());
 int                       Skiplist::random_level() {
-  static constexpr double P     = 0.25;  // 每一层的概率
-  int                     level = 1;
-  while (dis(gen) < P && level < Global_::FIX_LEVEL) {
+  // 每一层的概率为 1/4; gen 是 thread_local 的, 并发 Insert 无需同步
+  int level = 1;
+  while (level < max_level && (gen() & 3) == 0) {
     ++level;
   }
   return level;
-}
\ No newline at end of file
+}
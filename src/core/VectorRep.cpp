@@ -0,0 +1,203 @@
+#include "../../include/core/VectorRep.h"
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <ranges>
+#include <utility>
+
+namespace {
+std::atomic_uint64_t next_rep_id{1};
+
+// 与 Skiplist 相同的排序: key 升序, 同 key 时 transaction_id 降序
+bool node_less(const Node* a, const Node* b) {
+  int res = a->compare_key(b->key(), b->prefix());
+  return res < 0 || (res == 0 && a->transaction_id > b->transaction_id);
+}
+
+// 切成 chunks 段各自稳定排序, 再逐轮两两归并; 每一步都是稳定的, 整体等价于 stable_sort
+void parallel_stable_sort(std::vector<Node*>& nodes, size_t chunks) {
+  if (chunks <= 1) {
+    std::ranges::stable_sort(nodes, node_less);
+    return;
+  }
+  std::vector<size_t> bounds;
+  for (size_t i = 0; i <= chunks; ++i) {
+    bounds.push_back(nodes.size() * i / chunks);
+  }
+  {
+    std::vector<std::jthread> workers;
+    for (size_t i = 0; i < chunks; ++i) {
+      workers.emplace_back([&, i] {
+        std::stable_sort(nodes.begin() + bounds[i], nodes.begin() + bounds[i + 1], node_less);
+      });
+    }
+  }
+  while (bounds.size() > 2) {
+    std::vector<size_t> merged;
+    {
+      std::vector<std::jthread> workers;
+      for (size_t i = 0; i + 2 < bounds.size(); i += 2) {
+        workers.emplace_back([&, i] {
+          std::inplace_merge(nodes.begin() + bounds[i], nodes.begin() + bounds[i + 1],
+                             nodes.begin() + bounds[i + 2], node_less);
+        });
+      }
+    }
+    for (size_t i = 0; i < bounds.size(); i += 2) {
+      merged.push_back(bounds[i]);
+    }
+    if (merged.back() != bounds.back()) {
+      merged.push_back(bounds.back());
+    }
+    bounds = std::move(merged);
+  }
+}
+}  // namespace
+
+VectorRep::VectorRep(WriteBufferManager* wbm)
+    : id_(next_rep_id.fetch_add(1, std::memory_order_relaxed)),
+      arena_(std::make_unique<Arena>(wbm)),
+      size_bytes_(0),
+      nodecount_(0),
+      num_shard_(0) {}
+
+VectorRep::ThreadBuffer& VectorRep::local_buffer() {
+  // 按 id 取模的小缓存: 同一线程交替写几个分片时不用每次都加锁查表.
+  // id 不会复用, 已析构的 VectorRep 留下的旧项只会被覆盖, 不会被误用
+  static thread_local std::array<std::pair<uint64_t, ThreadBuffer*>, 64> cache{};
+  auto& slot = cache[id_ % cache.size()];
+  if (slot.first == id_) {
+    return *slot.second;
+  }
+  std::lock_guard lk(buffers_mutex_);
+  const auto      self = std::this_thread::get_id();
+  auto            it   = std::ranges::find(buffers_, self, &ThreadBuffer::owner);
+  if (it == buffers_.end()) {
+    it        = buffers_.emplace(buffers_.end());
+    it->owner = self;
+  }
+  slot = {id_, &*it};
+  return *it;
+}
+
+bool VectorRep::Insert(std::string_view key, std::string_view value,
+                       const uint64_t transaction_id) {
+  auto  node   = Node::create(*arena_, key, value, transaction_id, 1);
+  auto& buffer = local_buffer();
+  size_t grown = 0;
+  {
+    std::lock_guard lk(buffer.mutex);
+    const size_t    capacity = buffer.nodes.capacity();
+    buffer.nodes.push_back(node);
+    grown = buffer.nodes.capacity() - capacity;
+  }
+  // 缓冲区扩容的内存不在 Arena 里, 单独记账
+  if (grown != 0) {
+    arena_->charge(grown * sizeof(Node*));
+  }
+  size_bytes_ += node->size();
+  nodecount_++;
+  return true;
+}
+
+Node* VectorRep::find_visible(std::string_view key, uint64_t transaction_id) {
+  Node*           best = nullptr;
+  std::lock_guard lk(buffers_mutex_);
+  for (auto& buffer : buffers_) {
+    std::lock_guard buffer_lk(buffer.mutex);
+    for (auto node : buffer.nodes) {
+      if (node->key() != key) continue;
+      if (transaction_id != 0 && node->transaction_id > transaction_id) continue;
+      // 同一缓冲区内后追加的更新, 用 >= 让它覆盖前面的同 id 版本
+      if (!best || node->transaction_id >= best->transaction_id) {
+        best = node;
+      }
+    }
+  }
+  return best;
+}
+
+std::optional<LookupResult> VectorRep::Get(std::string_view key, const uint64_t transaction_id) {
+  if (auto node = find_visible(key, transaction_id)) {
+    return LookupResult(std::string(node->value()), node->transaction_id);
+  }
+  return std::nullopt;
+}
+
+Node* VectorRep::get_node(std::string_view key, const uint64_t transaction_id) {
+  auto node = find_visible(key, transaction_id);
+  if (node && transaction_id != 0 && node->value().empty()) {
+    return nullptr;
+  }
+  return node;
+}
+
+std::vector<std::tuple<std::string, std::string, uint64_t>> VectorRep::get_prefix_range(
+    std::string_view prefix, uint64_t tranc_id) {
+  std::vector<Node*> nodes;
+  {
+    std::lock_guard lk(buffers_mutex_);
+    for (auto& buffer : buffers_) {
+      std::lock_guard buffer_lk(buffer.mutex);
+      for (auto node : buffer.nodes | std::views::reverse) {
+        if (tranc_id != 0 && node->transaction_id > tranc_id) continue;
+        if (node->key().starts_with(prefix)) {
+          nodes.push_back(node);
+        }
+      }
+    }
+  }
+  std::ranges::stable_sort(nodes, node_less);
+  std::vector<std::tuple<std::string, std::string, uint64_t>> result;
+  result.reserve(nodes.size());
+  for (auto node : nodes) {
+    result.emplace_back(node->key(), node->value(), node->transaction_id);
+  }
+  return result;
+}
+
+std::size_t VectorRep::get_size() {
+  return size_bytes_;
+}
+
+std::size_t VectorRep::memory_usage() {
+  return arena_->memory_usage();
+}
+
+std::size_t VectorRep::getnodecount() {
+  return nodecount_;
+}
+
+void VectorRep::set_num_shard(int num_shard) {
+  num_shard_ = num_shard;
+}
+
+int VectorRep::get_num_shard() const {
+  return num_shard_;
+}
+
+std::unique_ptr<Skiplist> VectorRep::to_skiplist(VersionCollapser* collapser) {
+  std::vector<Node*> nodes;
+  nodes.reserve(nodecount_.load(std::memory_order_relaxed));
+  {
+    std::lock_guard lk(buffers_mutex_);
+    // 每个缓冲区倒序放入, 稳定排序后同 (key, tranc_id) 中后追加的排在前面
+    for (auto& buffer : buffers_) {
+      std::lock_guard buffer_lk(buffer.mutex);
+      std::ranges::copy(buffer.nodes | std::views::reverse, std::back_inserter(nodes));
+    }
+  }
+  const size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  parallel_stable_sort(nodes,
+                       std::min(threads, nodes.size() / Global_::VECTOR_REP_PARALLEL_SORT_MIN));
+
+  auto table = std::make_unique<Skiplist>(Global_::MAX_LEVEL, arena_->write_buffer_manager());
+  table->set_num_shard(num_shard_);
+  for (auto node : nodes) {
+    if (collapser && !collapser->keep(node->key(), node->transaction_id)) {
+      continue;
+    }
+    table->Append(node->key(), node->value(), node->transaction_id);
+  }
+  return table;
+}
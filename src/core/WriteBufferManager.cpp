@@ -0,0 +1,78 @@
+#include "../../include/core/WriteBufferManager.h"
+#include <utility>
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size)
+    : buffer_size_(buffer_size),
+      mutable_limit_(buffer_size * 7 / 8),
+      memory_used_(0),
+      memory_active_(0) {}
+
+void WriteBufferManager::set_block_cache_usage(UsageProbe probe) {
+  cache_usage_ = std::move(probe);
+}
+
+void WriteBufferManager::reserve_mem(size_t bytes) {
+  memory_used_.fetch_add(bytes, std::memory_order_relaxed);
+  memory_active_.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::schedule_free_mem(size_t bytes) {
+  memory_active_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void WriteBufferManager::free_mem(size_t bytes) {
+  memory_used_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+size_t WriteBufferManager::buffer_size() const {
+  return buffer_size_;
+}
+
+size_t WriteBufferManager::memory_usage() const {
+  return memtable_memory_usage() + (cache_usage_ ? cache_usage_() : 0);
+}
+
+size_t WriteBufferManager::memtable_memory_usage() const {
+  return memory_used_.load(std::memory_order_relaxed);
+}
+
+size_t WriteBufferManager::mutable_memtable_memory_usage() const {
+  return memory_active_.load(std::memory_order_relaxed);
+}
+
+bool WriteBufferManager::should_flush() const {
+  const size_t active = mutable_memtable_memory_usage();
+  if (active > mutable_limit_) {
+    return true;
+  }
+  return memory_usage() >= buffer_size_ && active >= buffer_size_ / 2;
+}
+
+AllocTracker::AllocTracker(WriteBufferManager* wbm) : wbm_(wbm), bytes_(0), done_(false) {}
+
+AllocTracker::~AllocTracker() {
+  if (wbm_ == nullptr) {
+    return;
+  }
+  // 没冻结就析构的表 (clear / 转换后丢弃的活跃表) 先从活跃部分扣掉
+  done_allocating();
+  wbm_->free_mem(bytes_.load(std::memory_order_relaxed));
+}
+
+void AllocTracker::allocate(size_t bytes) {
+  if (wbm_ == nullptr) {
+    return;
+  }
+  bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  wbm_->reserve_mem(bytes);
+  if (done_.load(std::memory_order_acquire)) {
+    wbm_->schedule_free_mem(bytes);
+  }
+}
+
+void AllocTracker::done_allocating() {
+  if (wbm_ == nullptr || done_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  wbm_->schedule_free_mem(bytes_.load(std::memory_order_relaxed));
+}
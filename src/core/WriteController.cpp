@@ -0,0 +1,108 @@
+#include "../../include/core/WriteController.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+WriteController::WriteController(Probe probe)
+    : probe_(std::move(probe)),
+      next_write_(std::chrono::steady_clock::now()),
+      state_(WriteStallState::kNormal),
+      delayed_writes_(0),
+      stopped_writes_(0),
+      delay_micros_(0),
+      stop_micros_(0) {}
+
+double WriteController::severity(const WriteStallInputs& inputs) {
+  // 单个指标: slowdown 以下为 0, 到 stop 为 1, 中间线性
+  auto level = [](size_t value, size_t slowdown, size_t stop) {
+    if (value < slowdown) {
+      return 0.0;
+    }
+    if (value >= stop) {
+      return 1.0;
+    }
+    // 刚越过 slowdown 也要有一点减速, 否则越界和不越界没有区别
+    return std::max(0.01, static_cast<double>(value - slowdown) / (stop - slowdown));
+  };
+  return std::max({
+      level(inputs.imm_bytes, Global_::WRITE_SLOWDOWN_IMM_BYTES, Global_::WRITE_STOP_IMM_BYTES),
+      level(inputs.l0_files, Global_::WRITE_SLOWDOWN_L0_FILES, Global_::WRITE_STOP_L0_FILES),
+      level(inputs.pending_compaction_bytes, Global_::WRITE_SLOWDOWN_PENDING_BYTES,
+            Global_::WRITE_STOP_PENDING_BYTES),
+  });
+}
+
+void WriteController::maybe_stall(size_t write_bytes) {
+  double sev = severity(probe_());
+  if (sev == 0.0) {
+    state_.store(WriteStallState::kNormal, std::memory_order_relaxed);
+    return;
+  }
+
+  if (sev >= 1.0) {
+    // 停写: 等后台把指标降下来. notify 会提前唤醒, 超时兜底防止漏掉通知
+    state_.store(WriteStallState::kStopped, std::memory_order_relaxed);
+    stopped_writes_.fetch_add(1, std::memory_order_relaxed);
+    const auto start = std::chrono::steady_clock::now();
+    {
+      std::unique_lock lk(mutex_);
+      while ((sev = severity(probe_())) >= 1.0) {
+        cv_.wait_for(lk, std::chrono::milliseconds(10));
+      }
+    }
+    stop_micros_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count(),
+                           std::memory_order_relaxed);
+    if (sev == 0.0) {
+      state_.store(WriteStallState::kNormal, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  state_.store(WriteStallState::kDelayed, std::memory_order_relaxed);
+  delayed_writes_.fetch_add(1, std::memory_order_relaxed);
+  if (auto delay = reserve_delay(write_bytes, sev); delay.count() > 0) {
+    std::this_thread::sleep_for(delay);
+    delay_micros_.fetch_add(delay.count(), std::memory_order_relaxed);
+  }
+}
+
+std::chrono::microseconds WriteController::reserve_delay(size_t write_bytes, double sev) {
+  // 允许的速率随严重程度从 DELAYED_WRITE_RATE 线性降到它的 1/10
+  const double rate  = Global_::DELAYED_WRITE_RATE * (1.0 - 0.9 * std::min(sev, 1.0));
+  const auto   bytes = std::max<size_t>(write_bytes, 1);
+  const auto   cost  = std::chrono::microseconds(static_cast<int64_t>(bytes * 1e6 / rate));
+
+  std::lock_guard lk(mutex_);
+  const auto      now = std::chrono::steady_clock::now();
+  // 空闲期间攒下的额度不保留, 否则一次积压会在之后被一口气写完
+  if (next_write_ < now) {
+    next_write_ = now;
+  }
+  const auto wait = next_write_ - now;
+  next_write_ += cost;
+  return std::chrono::duration_cast<std::chrono::microseconds>(wait);
+}
+
+void WriteController::notify() {
+  {
+    std::lock_guard lk(mutex_);
+  }
+  cv_.notify_all();
+}
+
+WriteStallState WriteController::state() const {
+  return state_.load(std::memory_order_relaxed);
+}
+
+WriteStallStats WriteController::stats() const {
+  return WriteStallStats{
+      .delayed_writes = delayed_writes_.load(std::memory_order_relaxed),
+      .stopped_writes = stopped_writes_.load(std::memory_order_relaxed),
+      .delay_micros   = delay_micros_.load(std::memory_order_relaxed),
+      .stop_micros    = stop_micros_.load(std::memory_order_relaxed),
+  };
+}
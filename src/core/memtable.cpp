@@ -1,4 +1,6 @@
 #include "../../include/core/memtable.h"
+#include "../../include/core/HashTableRep.h"
+#include "../../include/core/VectorRep.h"
 #include <spdlog/logger.h>
 #include "spdlog/spdlog.h"
 #include <algorithm>
@@ -139,30 +141,207 @@ bool MemTableIterator::top_value_legal() const {
   }
 }
 
-MemTable::MemTable()
-    :fixed_bytes(0), cur_status(Global_::SkiplistStatus::kNormal) {
-  for (auto it=0;it<current_table.size();it++) {
-    current_table[it] = std::move(std::make_unique<Skiplist>());
-    current_table[it]->set_num_shard(it);
+MemTable::MemTable(Global_::MemTableShardMode mode, Global_::MemTableRepType rep,
+                   std::shared_ptr<WriteBufferManager> wbm)
+    : mode_(mode),
+      rep_(rep),
+      wbm_(wbm ? std::move(wbm) : std::make_shared<WriteBufferManager>()),
+      fixed_bytes(0),
+      unclaimed_tables_(0),
+      cur_status(Global_::SkiplistStatus::kNormal) {
+  for (size_t it = 0; it < current_table.size(); it++) {
+    current_table[it] = new_rep(it);
+    active_[it].store(current_table[it].get(), std::memory_order_relaxed);
+  }
+  // 还没有样本时按首字节均分, 第一次换表后由 rebalance 按实际分布调整
+  for (size_t i = 0; i < bounds_.size(); ++i) {
+    bounds_[i][0].store(((i + 1) * 256 / Global_::NUMS_SHARDS) << 56, std::memory_order_relaxed);
+    bounds_[i][1].store(0, std::memory_order_relaxed);
   }
 }
 
+Global_::MemTableShardMode MemTable::shard_mode() const {
+  return mode_;
+}
+
+Global_::MemTableRepType MemTable::rep_type() const {
+  return rep_;
+}
+
+std::unique_ptr<MemTableRep> MemTable::new_rep(size_t index) const {
+  std::unique_ptr<MemTableRep> table;
+  switch (rep_) {
+    case Global_::MemTableRepType::kHashTable:
+      table = std::make_unique<HashTableRep>(Global_::HASH_REP_BUCKETS, wbm_.get());
+      break;
+    case Global_::MemTableRepType::kVector:
+      table = std::make_unique<VectorRep>(wbm_.get());
+      break;
+    default:
+      table = std::make_unique<Skiplist>(Global_::MAX_LEVEL, wbm_.get());
+      break;
+  }
+  table->set_num_shard(static_cast<int>(index));
+  return table;
+}
+
+void MemTable::set_snapshot_source(SnapshotSource source) {
+  snapshot_source_ = std::move(source);
+}
+
+size_t MemTable::collapsed_versions() const {
+  return collapsed_versions_.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<Skiplist> MemTable::convert(MemTableRep& rep) {
+  std::optional<VersionCollapser> collapser;
+  if (snapshot_source_) {
+    collapser.emplace(snapshot_source_());
+  }
+  std::unique_ptr<Skiplist> table;
+  if (auto skiplist = rep.as_skiplist()) {
+    if (collapser) {
+      table = skiplist->collapse_versions(*collapser);
+    }
+  } else {
+    table = rep.to_skiplist(collapser ? &*collapser : nullptr);
+  }
+  if (table) {
+    collapsed_versions_.fetch_add(rep.getnodecount() - table->getnodecount(),
+                                  std::memory_order_relaxed);
+  }
+  return table;
+}
+
+std::unique_ptr<Skiplist> MemTable::seal(std::unique_ptr<MemTableRep> rep) {
+  if (auto table = convert(*rep)) {
+    return table;
+  }
+  return std::unique_ptr<Skiplist>(rep.release()->as_skiplist());
+}
+
+MemTableRep* MemTable::retire(std::unique_ptr<MemTableRep> rep) {
+  auto*                               raw   = rep.get();
+  const size_t                        bytes = raw->get_size();
+  std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  fixed_bytes += bytes;
+  fixed_tables.push_back(FrozenTable{std::move(rep), nullptr, bytes});
+  return raw;
+}
+
+void MemTable::seal_retired(MemTableRep* rep, KeySamples* samples) {
+  // 表已经挂在 fixed_tables 里, 读者照常查它; 这里只读, 与读者并发
+  auto  table  = convert(*rep);
+  auto& sealed = table ? *table : *rep->as_skiplist();
+  sealed.freeze();
+  // 换进 fixed_tables 以后随时可能被 flush 释放, 只能在这之前取样
+  if (samples) {
+    sample(sealed, *samples);
+  }
+
+  std::unique_ptr<MemTableRep>        replaced;  // 放开锁以后再析构
+  std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  auto it = std::ranges::find_if(fixed_tables,
+                                 [&](const FrozenTable& frozen) { return frozen.rep.get() == rep; });
+  if (table) {
+    replaced = std::move(it->rep);
+    it->table = std::move(table);
+  } else {
+    it->table.reset(it->rep.release()->as_skiplist());
+  }
+  fixed_bytes -= it->bytes;
+  it->bytes = it->table->get_size();
+  fixed_bytes += it->bytes;
+  count_claimable();
+}
+
+void MemTable::count_claimable() {
+  size_t count = 0;
+  for (const auto& frozen : fixed_tables) {
+    if (!frozen.table) {
+      break;
+    }
+    count += frozen.table->get_status() == Global_::SkiplistStatus::kFrozen ? 1 : 0;
+  }
+  unclaimed_tables_.store(count, std::memory_order_release);
+}
+
+MemTable::RangeBound MemTable::make_bound(std::string_view key) {
+  // 不足 16 字节的部分补 0; 只取前 16 字节意味着前缀相同的 key 总在同一分片
+  uint64_t part[2] = {0, 0};
+  for (size_t i = 0; i < 16 && i < key.size(); ++i) {
+    part[i / 8] |= static_cast<uint64_t>(static_cast<uint8_t>(key[i])) << (56 - 8 * (i % 8));
+  }
+  return {part[0], part[1]};
+}
+
+size_t MemTable::shard_of(std::string_view key) const {
+  if (mode_ == Global_::MemTableShardMode::kHash) {
+    return Global_::fast_hash(key);
+  }
+  // 分界单调不减, 落在第几个分片 == 不大于 key 的分界个数
+  const auto bound = make_bound(key);
+  size_t     index = 0;
+  while (index < bounds_.size() &&
+         RangeBound{bounds_[index][0].load(std::memory_order_acquire),
+                    bounds_[index][1].load(std::memory_order_acquire)} <= bound) {
+    ++index;
+  }
+  return index;
+}
+
+size_t MemTable::route(std::string_view key, MemTableRep*& table) const {
+  for (;;) {
+    auto index = shard_of(key);
+    table      = active_[index].load(std::memory_order_seq_cst);
+    // 取到的是旧表也没关系: 旧表在换下之前已经挂进 fixed_tables, 读者按 key 范围能找到
+    if (mode_ == Global_::MemTableShardMode::kHash || shard_of(key) == index) {
+      return index;
+    }
+  }
+}
+
+MemTableRep* MemTable::swap_active(size_t index) {
+  auto retired = retire(std::exchange(current_table[index], new_rep(index)));
+  active_[index].store(current_table[index].get(), std::memory_order_seq_cst);
+  return retired;
+}
+
 bool MemTableIterator::valid() const {
   return !queue_.empty();
 }
 std::vector<std::tuple<std::string, std::string, uint64_t>> MemTable::get_prefix_range(
     std::string_view prefix, uint64_t tranc_id) {
 std::vector<std::tuple<std::string, std::string, uint64_t>> res;
- for (auto index=0; index<current_table.size();index++) {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_[index]);
-  auto res1= current_table[index]->get_prefix_range(prefix, tranc_id);
-  if (!res1.empty()) {
-  std::ranges::move(res1,std::back_inserter(res));
+  // 前缀的上界: 最右侧非 0xFF 字节 +1 后截断; 全 0xFF 时无上界 (空串)
+  std::string prefix_end(prefix);
+  while (!prefix_end.empty() && static_cast<uint8_t>(prefix_end.back()) == 0xFF) {
+    prefix_end.pop_back();
+  }
+  if (!prefix_end.empty()) {
+    ++prefix_end.back();
+  }
+  // 范围模式只需访问与前缀相交的那几个分片
+  size_t first = 0, last = current_table.size() - 1;
+  if (mode_ == Global_::MemTableShardMode::kRange) {
+    first = shard_of(prefix);
+    if (!prefix_end.empty()) {
+      last = shard_of(prefix_end);
+    }
+  }
+ {
+  auto pin = epoch_.pin();
+  for (auto index = first; index <= last; index++) {
+    auto res1 = active_[index].load(std::memory_order_seq_cst)->get_prefix_range(prefix, tranc_id);
+    std::ranges::move(res1, std::back_inserter(res));
   }
  }
        std::shared_lock<std::shared_mutex> lock_fix(fix_lock_);
   for (auto &it:fixed_tables) {
-  auto res2=it->get_prefix_range(prefix, tranc_id);
+  if (it.table && !it.table->overlaps(prefix, prefix_end)) {
+    continue;
+  }
+  auto res2=it.readable()->get_prefix_range(prefix, tranc_id);
   if (!res2.empty()) {
   std::ranges::move(res2,std::back_inserter(res));
   }
@@ -171,71 +350,130 @@ std::vector<std::tuple<std::string, std::string, uint64_t>> res;
 }
 void MemTable::clear() {
   // Sharding mode: clear all shards
-  for (auto& table : current_table) {
-    table = std::move(std::make_unique<Skiplist>());
+  for (size_t index = 0; index < current_table.size(); ++index) {
+    current_table[index] = new_rep(index);
+    active_[index].store(current_table[index].get(), std::memory_order_seq_cst);
   }
   fixed_tables.clear();
   fixed_bytes = 0;
+  unclaimed_tables_ = 0;
+  next_bounds_.reset();
 }
 void MemTable::put(const std::string& key, const std::string& value, const uint64_t transaction_id,
                    const size_t shard_idx) {
-    current_table[shard_idx]->Insert(key, value, transaction_id);
+  auto pin = epoch_.pin();
+  active_[shard_idx].load(std::memory_order_seq_cst)->Insert(key, value, transaction_id);
 }
 
 void MemTable::put_mutex(const std::string& key, const std::string& value,
                          const uint64_t transaction_id) {
-  auto index = Global_::fast_hash(key);
-   bool need_freeze = false;
+   size_t index;
     {
-      std::unique_lock<std::shared_mutex> lock(cur_lock_[index]);
-      current_table[index]->Insert(key, value, transaction_id);
-      if (current_table[index]->get_size() >= Global_::MAX_MEMTABLE_SIZE_PER_TABLE) {
-        need_freeze = true;
-      }
-    }
-    if (need_freeze) {
-      frozen_cur_table(false,index);  
+      // 活跃表支持并发写入; pin 住 epoch_ 保证换表后等这次写入结束才封存旧表
+      auto         pin = epoch_.pin();
+      MemTableRep* table;
+      index = route(key, table);
+      table->Insert(key, value, transaction_id);
     }
+    maybe_freeze(index);
   return;
 }
+
+void MemTable::maybe_freeze(size_t index) {
+  // 无锁读取只是初判, 真正冻结前在分片锁内复查
+  if (IsFull(index)) {
+    frozen_cur_table(false, index);
+  } else if (wbm_->should_flush()) {
+    freeze_largest();
+  }
+}
+
+bool MemTable::freeze_largest() {
+  size_t largest = 0, largest_bytes = 0;
+  {
+    auto pin = epoch_.pin();
+    for (size_t index = 0; index < active_.size(); ++index) {
+      const auto bytes = active_[index].load(std::memory_order_seq_cst)->memory_usage();
+      if (bytes > largest_bytes) {
+        largest       = index;
+        largest_bytes = bytes;
+      }
+    }
+  }
+  if (mode_ == Global_::MemTableShardMode::kRange) {
+    return rotate_all(false, largest, true);
+  }
+  return freeze_shard(largest, true);
+}
 void MemTable::put_batch(const std::vector<std::pair<std::string, std::string>>& key_value_pairs,
                          const uint64_t                                          transaction_id) {
 
     // Sharding mode: distribute to appropriate shards
-    for (const auto& pair : key_value_pairs) {
-      auto index = Global_::fast_hash(pair.first);
-      std::unique_lock<std::shared_mutex> lock(cur_lock_[index]);
-      current_table[index]->Insert(pair.first, pair.second, transaction_id);
-  }
+    std::array<bool, Global_::NUMS_SHARDS> touched{};
+    {
+      auto pin = epoch_.pin();
+      for (const auto& pair : key_value_pairs) {
+        MemTableRep* table;
+        auto         index = route(pair.first, table);
+        table->Insert(pair.first, pair.second, transaction_id);
+        touched[index] = true;
+      }
+    }
+    for (size_t index = 0; index < touched.size(); ++index) {
+      if (touched[index]) maybe_freeze(index);
+    }
 }
 std::optional<std::pair<std::string, uint64_t>> MemTable::get(std::string_view key,
                                                               const uint64_t   transaction_id) {
-      auto index = Global_::fast_hash(key);
-std::shared_lock<std::shared_mutex> lock(cur_lock_[index]);
-    auto                                result = current_table[index]->Get(key, transaction_id);
+  size_t index;
+  {
+    auto         pin = epoch_.pin();
+    MemTableRep* table;
+    index       = route(key, table);
+    auto result = table->Get(key, transaction_id);
     if (result.has_value()) {
       return std::make_pair(std::move(result->value), result->transaction_id);
     }
-lock.unlock();
+  }
   // Check fixed tables
   std::shared_lock<std::shared_mutex> second_lock(fix_lock_);
-  for (const auto& fixed_table : fixed_tables) {
-    if(fixed_table->get_num_shard()==index){
-      auto res=fixed_table->Get(key);
-      if (res.has_value()) {
+  // 新冻结的表在尾部, 从新到旧找第一个可见版本; 哈希模式先按分片号过滤,
+  // 范围模式每轮重划分后分片号不再对应固定范围, 只靠 key 范围过滤.
+  // 剩下的候选先查冻结时建的布隆过滤器, 未命中就不必下降跳表
+  // 还没封存的表没有布隆过滤器, 直接查
+  for (auto it = fixed_tables.rbegin(); it != fixed_tables.rend(); ++it) {
+    const auto fixed_table = it->readable();
+    if (mode_ == Global_::MemTableShardMode::kHash &&
+        static_cast<size_t>(fixed_table->get_num_shard()) != index) {
+      continue;
+    }
+    if (it->table && !it->table->may_contain(key)) {
+      continue;
+    }
+    auto res = fixed_table->Get(key, transaction_id);
+    if (res.has_value()) {
       return std::make_pair(std::move(res->value), res->transaction_id);
-    } 
     }
   }
   return std::nullopt;
 }
 SkiplistIterator MemTable::cur_get(std::string_view key, const uint64_t transaction_id) {
-  std::shared_lock<std::shared_mutex> lock(cur_lock_[0]);
-  return SkiplistIterator(current_table[0]->get_node(key, transaction_id));
+  auto pin = epoch_.pin();
+  return SkiplistIterator(active_[0].load(std::memory_order_seq_cst)->get_node(key, transaction_id));
 }
 SkiplistIterator MemTable::fix_get(std::string_view key, const uint64_t transaction_id) {
   std::shared_lock<std::shared_mutex> lock(fix_lock_);
-  for (const auto& result : fixed_tables) {
+  for (auto it = fixed_tables.rbegin(); it != fixed_tables.rend(); ++it) {
+    if (!it->table) {
+      if (auto node = it->rep->get_node(key, transaction_id)) {
+        return SkiplistIterator(node);
+      }
+      continue;
+    }
+    const auto& result = it->table;
+    if (!result->may_contain(key)) {
+      continue;
+    }
     if (result->Contain(key, transaction_id).has_value()) {
       return SkiplistIterator(result->get_node(key, transaction_id));
     }
@@ -259,11 +497,14 @@ std::vector<std::tuple<std::string, std::optional<std::string>, uint64_t>> MemTa
 }
 std::size_t MemTable::get_node_num() const {
   std::size_t result = 0;
-  for (auto& it : current_table) {
-    result += it->getnodecount();
+  {
+    auto pin = epoch_.pin();
+    for (auto& it : active_) {
+      result += it.load(std::memory_order_seq_cst)->getnodecount();
+    }
   }
   for (auto& it : fixed_tables) {
-    result += it->getnodecount();
+    result += it.readable()->getnodecount();
   }
   return result;
 }
@@ -272,14 +513,21 @@ std::size_t MemTable::get_fixed_size() {
 }
 std::size_t MemTable::get_cur_size() {
   std::size_t result = 0;
-  for (auto& it : current_table) {
-    result += it->get_size();
+  auto        pin    = epoch_.pin();
+  for (auto& it : active_) {
+    result += it.load(std::memory_order_seq_cst)->get_size();
   }
   return result;
 }
 std::size_t MemTable::get_total_size() {
   return get_cur_size() + get_fixed_size();
 }
+std::size_t MemTable::get_memory_usage() const {
+  return wbm_->memtable_memory_usage();
+}
+const std::shared_ptr<WriteBufferManager>& MemTable::write_buffer_manager() const {
+  return wbm_;
+}
 
 void MemTable::remove(std::string key, const uint64_t transaction_id) {
 put(key, std::string(), transaction_id);
@@ -291,26 +539,70 @@ void MemTable::remove_mutex(std::string key, const uint64_t transaction_id) {
 void MemTable::remove_batch(const std::vector<std::string>& key_value_pairs,
                             const uint64_t                  transaction_id) {
     // Sharding mode: distribute to appropriate shards
-    for (const auto& pair : key_value_pairs) {
-      auto index = std::hash<std::string_view>{}(pair) % Global_::NUMS_SHARDS;
-      std::unique_lock<std::shared_mutex> lock(cur_lock_[index]);
-      current_table[index]->Insert(pair, std::string(), transaction_id);
+    std::array<bool, Global_::NUMS_SHARDS> touched{};
+    {
+      auto pin = epoch_.pin();
+      for (const auto& pair : key_value_pairs) {
+        MemTableRep* table;
+        auto         index = route(pair, table);
+        table->Insert(pair, std::string(), transaction_id);
+        touched[index] = true;
+      }
+    }
+    for (size_t index = 0; index < touched.size(); ++index) {
+      if (touched[index]) maybe_freeze(index);
     }
 }
 bool MemTable::IsFull(size_t target) {
-  return current_table[target]->get_size() >= Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
+  auto pin = epoch_.pin();
+  return active_[target].load(std::memory_order_seq_cst)->memory_usage() >=
+         Global_::MAX_MEMTABLE_SIZE_PER_TABLE;
 }
 std::unique_ptr<Skiplist> MemTable::flushtodisk() {
   std::unique_lock<std::shared_mutex> lock(fix_lock_);
-  if (fixed_tables.empty()) {
+  // 最旧的表还在封存时先不给
+  if (fixed_tables.empty() || !fixed_tables.front().table) {
     return nullptr;
   }
-  auto temp = std::move(fixed_tables.front());
+  auto temp = std::move(fixed_tables.front().table);
+  fixed_bytes -= fixed_tables.front().bytes;
   fixed_tables.pop_front();
-  fixed_bytes -= temp->get_size();
+  count_claimable();
   return temp;
 }
 
+std::vector<Skiplist*> MemTable::claim_frozen_tables() {
+  std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  std::vector<Skiplist*>              res;
+  // 按冻结顺序认领, 保证较新的表不会先于较旧的表装进 L0
+  for (auto& frozen : fixed_tables) {
+    if (!frozen.table) {
+      break;
+    }
+    if (frozen.table->get_status() == Global_::SkiplistStatus::kFrozen) {
+      frozen.table->set_status(Global_::SkiplistStatus::kFlushing);
+      res.push_back(frozen.table.get());
+    }
+  }
+  count_claimable();
+  return res;
+}
+
+void MemTable::release_flushed_tables(const std::vector<Skiplist*>& tables) {
+  std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  std::erase_if(fixed_tables, [&](const FrozenTable& frozen) {
+    if (!frozen.table || std::ranges::find(tables, frozen.table.get()) == tables.end()) {
+      return false;
+    }
+    fixed_bytes -= frozen.bytes;
+    return true;
+  });
+}
+
+bool MemTable::has_unclaimed_frozen() const {
+  return unclaimed_tables_.load(std::memory_order_acquire) > 0;
+}
+
 // This function is used to flush the current memtable to disk,just for test
 std::list<std::unique_ptr<Skiplist>> MemTable::flush() {
 std::list<std::unique_ptr<Skiplist>> res;
@@ -318,100 +610,201 @@ for (auto &it:current_table) {
 if (it->getnodecount()==0) {
 continue;
 }
-res.emplace_back(std::move(it));
+res.emplace_back(seal(std::move(it)));
+}
+// 只用于测试, 之后不再写入
+for (auto &it:active_) {
+it.store(nullptr, std::memory_order_seq_cst);
 }
 return res;
 }
 std::list<std::unique_ptr<Skiplist>> MemTable::flushsync() {
-  std::unique_lock<std::shared_mutex> lock(cur_lock_[0]);
-  auto                                new_table = std::make_unique<Skiplist>();
-  fixed_bytes += current_table[0]->get_size();
-  fixed_tables.emplace_back(std::move(current_table[0]));
-  current_table[0] = std::move(new_table);
-  return std::move(fixed_tables);
+  std::unique_lock<std::mutex> lock(cur_lock_[0]);
+  auto                         old = std::exchange(current_table[0], new_rep(0));
+  active_[0].store(current_table[0].get(), std::memory_order_seq_cst);
+  lock.unlock();
+  epoch_.synchronize();
+  auto                                 sealed = seal(std::move(old));
+  std::unique_lock<std::shared_mutex>  lk2(fix_lock_);
+  // 全部交给调用方; 只在没有并发写入时调用, 不会有还没封存的表
+  std::list<std::unique_ptr<Skiplist>> res;
+  for (auto& frozen : fixed_tables) {
+    res.push_back(std::move(frozen.table));
+  }
+  res.push_back(std::move(sealed));
+  fixed_tables.clear();
+  fixed_bytes       = 0;
+  unclaimed_tables_ = 0;
+  return res;
 }
 bool MemTable::frozen_cur_table(bool force, size_t target) {
+  if (mode_ == Global_::MemTableShardMode::kRange) {
+    return rotate_all(force, target);
+  }
   if (!force) {
     // ── non-force: freeze only the target shard ───────────────────────────
-    std::unique_lock<std::shared_mutex> lock(cur_lock_[target]);
-    if (current_table[target]->getnodecount()==0||current_table[target]->get_size() == 0) return false;
-    if (current_table[target]->get_size() < Global_::MAX_MEMTABLE_SIZE_PER_TABLE)
-      return false;
-
-    auto new_table = std::make_unique<Skiplist>();
-    auto temp      = std::move(current_table[target]);
-    new_table->set_num_shard(target);
-    current_table[target] = std::move(new_table);
-    lock.unlock();          // released once, correctly
-
-    temp->set_status(Global_::SkiplistStatus::kFrozen);
-    std::unique_lock<std::shared_mutex> lk2(fix_lock_);
-    fixed_bytes += temp->get_size();
-    fixed_tables.push_back(std::move(temp));
-    return true;
+    return freeze_shard(target, false);
   }
 
   // ── force: freeze every non-empty shard independently ────────────────────
   for (size_t index = 0; index < current_table.size(); ++index) {
-    std::unique_ptr<Skiplist> temp;
-    {
-      std::unique_lock<std::shared_mutex> lock(cur_lock_[index]); // one lock per shard
-      if (current_table[index]->getnodecount() == 0) continue;
-      auto new_table = std::make_unique<Skiplist>();
-      new_table->set_num_shard(index);
-      temp = std::move(current_table[index]);
-      current_table[index] = std::move(new_table);
-    }  // ← lock released here, once, correctly
-    temp->set_status(Global_::SkiplistStatus::kFrozen);
+    std::unique_lock<std::mutex> lock(cur_lock_[index]);  // one lock per shard
+    if (current_table[index]->getnodecount() == 0) continue;
+    auto retired = swap_active(index);
+    lock.unlock();
+    epoch_.synchronize();
+    seal_retired(retired);
+  }
+  return true;
+}
+
+bool MemTable::freeze_shard(size_t target, bool budget) {
+  std::unique_lock<std::mutex> lock(cur_lock_[target]);
+  if (current_table[target]->getnodecount()==0||current_table[target]->get_size() == 0) return false;
+  // 等锁期间可能已经被别的写者换过了, 或者别的分片的冻结已经把预算降下来
+  if (budget ? !wbm_->should_flush()
+             : current_table[target]->memory_usage() < Global_::MAX_MEMTABLE_SIZE_PER_TABLE)
+    return false;
+
+  // 旧表先挂进 fixed_tables 再换下, 读者任何时候都能找到它; 换下以后等还在旧表上
+  // 写入的写者退出, 再在锁外转换、回收旧版本和建布隆过滤器, 不挡住这个分片的写者
+  auto retired = swap_active(target);
+  lock.unlock();
+  epoch_.synchronize();
+  seal_retired(retired);
+  return true;
+}
+
+bool MemTable::rotate_all(bool force, size_t target, bool budget) {
+  // 按分片号顺序拿全部分片的换表锁, 与单分片换表串行
+  std::array<std::unique_lock<std::mutex>, Global_::NUMS_SHARDS> locks;
+  for (size_t index = 0; index < locks.size(); ++index) {
+    locks[index] = std::unique_lock<std::mutex>(cur_lock_[index]);
+  }
+  // 等锁期间可能已经被别的写者换过了
+  if (!force && (budget ? !wbm_->should_flush()
+                        : current_table[target]->memory_usage() <
+                              Global_::MAX_MEMTABLE_SIZE_PER_TABLE)) {
+    return false;
+  }
+  if (std::ranges::all_of(current_table, [](const auto& t) { return t->getnodecount() == 0; })) {
+    return false;
+  }
+  std::optional<std::array<RangeBound, Global_::NUMS_SHARDS - 1>> bounds;
+  {
     std::unique_lock<std::shared_mutex> lk2(fix_lock_);
-    fixed_bytes += temp->get_size();
-    fixed_tables.push_back(std::move(temp));
+    bounds = std::exchange(next_bounds_, std::nullopt);
   }
+  // 分界要变时每个分片都换, 空表也换: 写者不拿锁, 空表此刻也可能正被写入
+  std::vector<MemTableRep*> retired;
+  for (size_t index = 0; index < current_table.size(); ++index) {
+    if (!bounds && current_table[index]->getnodecount() == 0) continue;
+    retired.push_back(retire(std::exchange(current_table[index], new_rep(index))));
+  }
+  // 分界用上一轮封存好的表估计: 这一轮的表要等写者退出才能封存.
+  // 先改分界再发布新表, 写者拿到新表后复查路由时一定看到新分界
+  if (bounds) {
+    for (size_t i = 0; i < bounds_.size(); ++i) {
+      bounds_[i][0].store((*bounds)[i].first, std::memory_order_release);
+      bounds_[i][1].store((*bounds)[i].second, std::memory_order_release);
+    }
+  }
+  for (size_t index = 0; index < current_table.size(); ++index) {
+    active_[index].store(current_table[index].get(), std::memory_order_seq_cst);
+  }
+  for (auto& lock : locks) {
+    lock.unlock();
+  }
+  epoch_.synchronize();
+
+  KeySamples samples;
+  for (auto rep : retired) {
+    seal_retired(rep, &samples);
+  }
+  rebalance(std::move(samples));
   return true;
 }
 
+void MemTable::sample(Skiplist& table, KeySamples& samples) {
+  // 每个样本代表所在分片 size / 样本数 的字节
+  auto keys = table.sample_keys(Global_::RANGE_SHARD_SAMPLES);
+  if (keys.empty()) return;
+  const double weight = static_cast<double>(table.get_size()) / keys.size();
+  for (auto& key : keys) {
+    samples.emplace_back(std::move(key), weight);
+  }
+}
+
+void MemTable::rebalance(KeySamples samples) {
+  // 按累计字节数取 NUMS_SHARDS 等分点
+  if (samples.empty()) {
+    return;
+  }
+  double total = 0;
+  for (const auto& [key, weight] : samples) {
+    total += weight;
+  }
+  std::ranges::sort(samples, {}, &std::pair<std::string, double>::first);
+  std::array<RangeBound, Global_::NUMS_SHARDS - 1> bounds;
+
+  double cum  = 0;
+  size_t next = 0;
+  for (const auto& [key, weight] : samples) {
+    while (next < bounds.size() && cum >= total * (next + 1) / Global_::NUMS_SHARDS) {
+      bounds[next++] = make_bound(key);
+    }
+    cum += weight;
+  }
+  // 样本不足以切出全部分界时, 其余分界都取最大样本, 比它大的 key 进最后一个分片
+  const auto last = make_bound(samples.back().first);
+  for (; next < bounds.size(); ++next) {
+    bounds[next] = last;
+  }
+  std::unique_lock<std::shared_mutex> lock(fix_lock_);
+  next_bounds_ = bounds;
+}
+
 MemTableIterator MemTable::begin() {
-  return MemTableIterator(fixed_tables.begin()->get()->begin(), 0);
+  return MemTableIterator(fixed_tables.begin()->table->begin(), 0);
 }
 MemTableIterator MemTable::end() {
-  return MemTableIterator(fixed_tables.end()->get()->end(), 0);
+  return MemTableIterator(fixed_tables.end()->table->end(), 0);
 }
 // 迭代器
 
 MemTableIterator MemTable::prefix_serach(std::string_view key, const uint64_t transaction_id) {
-  std::vector<SerachIterator>         iter;
-  std::shared_lock<std::shared_mutex> lock(cur_lock_[0]);
-  if (!current_table[0]) {
-    spdlog::info("current_table is null");
-    return MemTableIterator(iter, transaction_id);
-  }
-  auto begin_iter = current_table[0]->prefix_serach_begin(key);
-  auto end_iter   = current_table[0]->prefix_serach_end(key);
-  if (!begin_iter.valid()) {
-    return MemTableIterator(iter, transaction_id);
-  }
-  for (auto begin = begin_iter; begin != end_iter; ++begin) {
-    iter.push_back(
-        SerachIterator(begin.getValue().first, begin.getValue().second, transaction_id, 0));
+  std::vector<SerachIterator> iter;
+  {
+    auto pin   = epoch_.pin();
+    auto table = active_[0].load(std::memory_order_seq_cst);
+    if (!table) {
+      spdlog::info("current_table is null");
+      return MemTableIterator(iter, transaction_id);
+    }
+    auto entries = table->get_prefix_range(key, transaction_id);
+    if (entries.empty()) {
+      return MemTableIterator(iter, transaction_id);
+    }
+    for (auto& [k, v, tid] : entries) {
+      iter.push_back(SerachIterator(std::move(k), std::move(v), transaction_id, 0));
+    }
   }
-  lock.unlock();
   std::shared_lock<std::shared_mutex> second_lock(fix_lock_);
   if (fixed_tables.empty()) {
     return MemTableIterator(iter, transaction_id);
   }
   for (const auto& fixed_table : fixed_tables) {
-    for (auto begin = fixed_table->prefix_serach_begin(key);
-         begin != fixed_table->prefix_serach_end(key); ++begin) {
-      iter.push_back(
-          SerachIterator(begin.getValue().first, begin.getValue().second, transaction_id, 0));
+    for (auto& [k, v, tid] : fixed_table.readable()->get_prefix_range(key, transaction_id)) {
+      iter.push_back(SerachIterator(std::move(k), std::move(v), transaction_id, 0));
     }
   }
   return MemTableIterator(iter, transaction_id);
 }
 std::vector<size_t> MemTable::getShardNodeCounts() const {
   std::vector<size_t> counts;
-    for (const auto& table : current_table) {
-      counts.push_back(table->getnodecount());
+  auto                pin = epoch_.pin();
+    for (const auto& table : active_) {
+      counts.push_back(table.load(std::memory_order_seq_cst)->getnodecount());
     }
   return counts;
 }
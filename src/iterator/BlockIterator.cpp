@@ -48,8 +48,10 @@ BlockIterator::con_pointer BlockIterator::operator->() {
 }
 BlockIterator& BlockIterator::operator++() {
   if (block) {
+    // 前缀压缩的 key 在上一条 key 的基础上拼出来, 不必从重启点重新解码
+    std::optional<value_type> prev = std::move(cached_value);
     current_index++;
-    update_current();
+    update_current(prev ? &prev->first : nullptr);
   }
   return *this;
 }
@@ -92,13 +94,19 @@ uint64_t BlockIterator::get_cur_tranc_id() const {
 std::shared_ptr<Block> BlockIterator::get_block() const {
   return block;
 }
-void BlockIterator::update_current() {
+void BlockIterator::update_current(std::string* prev_key) {
   cached_value = std::nullopt;  // 每次都清空缓存
   if (block && current_index < block->Offset_.size()) {
-    auto offset  = block->Offset_[current_index];
-    auto entry   = block->get_entry(offset);
-    tranc_id_    = entry->tranc_id;
-    cached_value = std::make_pair(entry->key, entry->value);
+    std::string key;
+    if (prev_key != nullptr) {
+      key = std::move(*prev_key);
+      block->append_key(current_index, key);
+    } else {
+      key = block->get_key_at(current_index);
+    }
+    const auto entry = block->parse_entry(block->Offset_[current_index]);
+    tranc_id_        = entry.tranc_id;
+    cached_value     = std::make_pair(std::move(key), std::string(entry.value));
   }
   else {
   tranc_id_=0;
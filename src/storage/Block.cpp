@@ -1,10 +1,12 @@
 #include "../../include/storage/Block.h"
 #include <spdlog/spdlog.h>
 #include "../../include/iterator/BlockIterator.h"
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <format>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -19,34 +21,90 @@ Block::Block() : capcity(4096) {
   // 默认构造函数，初始化容量为4096
 }
 
-std::vector<uint8_t> Block::encode(bool with_hash) {
-  // Data_ + offsets(uint16_t) + num(uint16_t) [+ hash(uint32_t)]
-  size_t offsets_bytes = Offset_.size() * sizeof(uint16_t);
-  size_t total         = Data_.size() * sizeof(uint8_t) + offsets_bytes + sizeof(uint16_t) +
-                 (with_hash ? sizeof(uint32_t) : 0);
-  std::vector<uint8_t> encoded(total, 0);
+namespace {
+// 新格式 trailer: num_entries(u16) restart_interval(u16) version(u8) marker(u16)
+constexpr uint16_t kFormatMarker  = 0xFFFF;
+constexpr size_t   kPrefixTrailer = 2 * sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint16_t);
+// 哈希索引的桶: 重启点编号, 或下面两个标记; 所以最多索引 kBucketCollision 个重启点
+constexpr uint8_t kBucketCollision = 254;
+constexpr uint8_t kBucketEmpty     = 255;
+
+// 有 buckets 个桶的哈希索引在 block 里占的字节: 桶 + 桶数(u16)
+size_t index_bytes(size_t buckets) {
+  return buckets > 0 ? buckets + sizeof(uint16_t) : 0;
+}
 
-  std::memcpy(encoded.data(), Data_.data(), Data_.size() * sizeof(uint8_t));
+uint32_t key_hash(std::string_view key) {
+  return Global_::crc32c(
+      std::span(reinterpret_cast<const uint8_t*>(key.data()), key.size()));
+}
+
+// 上一条 key 为 prev 时, 由 shared + delta 拼出的 key 是否与它相同
+bool same_as_prev(std::string_view prev, size_t shared, std::string_view delta) {
+  return shared + delta.size() == prev.size() && prev.substr(shared) == delta;
+}
+}  // namespace
 
-  // write offsets as uint16_t (explicit conversion + check)
-  size_t off_pos = Data_.size() * sizeof(uint8_t);
-  memcpy(encoded.data() + off_pos, Offset_.data(), Offset_.size() * sizeof(uint16_t));
+std::vector<uint8_t> Block::encode(bool with_hash) {
+  // legacy: Data_ + offsets(uint16_t) + num(uint16_t)        [+ hash(uint32_t)]
+  // prefix: Data_ [+ buckets + num_buckets(uint16_t)] + trailer [+ hash(uint32_t)]
+  const size_t body = get_cur_size();
+  std::vector<uint8_t> encoded(body + (with_hash ? sizeof(uint32_t) : 0), 0);
 
-  // write num elements
-  size_t   num_pos      = Data_.size() * sizeof(uint8_t) + Offset_.size() * sizeof(uint16_t);
+  std::memcpy(encoded.data(), Data_.data(), Data_.size() * sizeof(uint8_t));
+  size_t   pos          = Data_.size();
   uint16_t num_elements = Offset_.size();
-  memcpy(encoded.data() + num_pos, &num_elements, sizeof(uint16_t));
+  if (version_ == kFormatLegacy) {
+    memcpy(encoded.data() + pos, Offset_.data(), Offset_.size() * sizeof(uint16_t));
+    pos += Offset_.size() * sizeof(uint16_t);
+    memcpy(encoded.data() + pos, &num_elements, sizeof(uint16_t));
+  } else {
+    // 哈希索引: 每个 key 只记它第一次出现 (最新版本) 所在的重启点
+    const uint16_t num_buckets = hash_bucket_count(Offset_.size(), distinct_keys_);
+    if (num_buckets > 0) {
+      uint8_t* buckets = encoded.data() + pos;
+      std::memset(buckets, kBucketEmpty, num_buckets);
+      std::string key;
+      for (size_t i = 0; i < Offset_.size(); ++i) {
+        const auto e = parse_entry(Offset_[i]);
+        if (i > 0 && same_as_prev(key, e.shared, e.delta)) {
+          continue;
+        }
+        key.resize(e.shared);
+        key.append(e.delta);
+        const uint8_t restart = i / restart_interval_;
+        uint8_t&      bucket  = buckets[key_hash(key) % num_buckets];
+        if (bucket == kBucketEmpty) {
+          bucket = restart;
+        } else if (bucket != restart) {
+          bucket = kBucketCollision;
+        }
+      }
+      pos += num_buckets;
+      memcpy(encoded.data() + pos, &num_buckets, sizeof(uint16_t));
+      pos += sizeof(uint16_t);
+    }
+    const uint16_t interval = restart_interval_;
+    memcpy(encoded.data() + pos, &num_elements, sizeof(uint16_t));
+    memcpy(encoded.data() + pos + 2, &interval, sizeof(uint16_t));
+    encoded[pos + 4] = num_buckets > 0 ? kFormatPrefixHash : kFormatPrefix;
+    memcpy(encoded.data() + pos + 5, &kFormatMarker, sizeof(uint16_t));
+  }
 
-  // write hash if needed (hash over everything before hash)
+  // write checksum if needed (over everything before it)
   if (with_hash) {
-    uint32_t hash_value = std::hash<std::string_view>{}(std::string_view(
-        reinterpret_cast<const char*>(encoded.data()), encoded.size() - sizeof(uint32_t)));
-    std::memcpy(encoded.data() + encoded.size() - sizeof(uint32_t), &hash_value, sizeof(uint32_t));
+    // 旧格式按原样写回, 校验和也保持旧算法
+    const std::span<const uint8_t> covered(encoded.data(), encoded.size() - sizeof(uint32_t));
+    const uint32_t                 checksum = version_ == kFormatLegacy
+                                                  ? Global_::legacy_block_checksum(covered)
+                                                  : Global_::block_checksum(covered);
+    std::memcpy(encoded.data() + encoded.size() - sizeof(uint32_t), &checksum, sizeof(uint32_t));
   }
   return encoded;
 }
 
-std::shared_ptr<Block> Block::decode(const std::vector<uint8_t>& encoded, bool with_hash) {
+std::shared_ptr<Block> Block::decode(const std::vector<uint8_t>& encoded, bool with_hash,
+                                     bool verify_checksum) {
   // 使用 make_shared 创建对象
   auto block = std::make_shared<Block>();
 
@@ -58,58 +116,253 @@ std::shared_ptr<Block> Block::decode(const std::vector<uint8_t>& encoded, bool w
     return nullptr;
   }
 
-  // 2. 读取元素个数
-  uint16_t num_elements;
-  size_t   num_elements_pos = encoded.size() - sizeof(uint16_t);
-  if (with_hash) {
-    num_elements_pos -= sizeof(uint32_t);
-    auto     hash_pos = encoded.size() - sizeof(uint32_t);
-    uint32_t hash_value;
-    memcpy(&hash_value, encoded.data() + hash_pos, sizeof(uint32_t));
-
-    uint32_t compute_hash = std::hash<std::string_view>{}(std::string_view(
-        reinterpret_cast<const char*>(encoded.data()), encoded.size() - sizeof(uint32_t)));
-    if (hash_value != compute_hash) {
-      throw std::runtime_error("Block hash verification failed");
+  // 2. 定位 trailer 末尾, 按格式标记校验 checksum: 没有 0xFFFF 标记的旧格式写于改用
+  //    crc32c 之前, 用旧算法. 不校验时 entry 的长度检查仍然保证不越界
+  size_t body_end = encoded.size() - (with_hash ? sizeof(uint32_t) : 0);
+  if (body_end < sizeof(uint16_t)) {
+    throw std::runtime_error("Block trailer truncated");
+  }
+  uint16_t marker;
+  memcpy(&marker, encoded.data() + body_end - sizeof(uint16_t), sizeof(uint16_t));
+  if (with_hash && verify_checksum) {
+    uint32_t checksum;
+    memcpy(&checksum, encoded.data() + body_end, sizeof(uint32_t));
+    if (!Global_::block_checksum_matches(std::span(encoded.data(), body_end), checksum,
+                                         marker != kFormatMarker)) {
+      throw std::runtime_error("Block checksum verification failed");
     }
   }
-  memcpy(&num_elements, encoded.data() + num_elements_pos, sizeof(uint16_t));
 
-  // 4. 计算各段位置
-  size_t offsets_section_start = num_elements_pos - num_elements * sizeof(uint16_t);
+  if (marker != kFormatMarker) {
+    // 3a. 旧格式: 偏移数组 + 元素个数
+    const uint16_t num_elements    = marker;
+    const size_t   offsets_bytes   = num_elements * sizeof(uint16_t);
+    if (body_end < sizeof(uint16_t) + offsets_bytes) {
+      throw std::runtime_error("Block trailer truncated");
+    }
+    size_t offsets_section_start = body_end - sizeof(uint16_t) - offsets_bytes;
+    block->version_          = kFormatLegacy;
+    block->restart_interval_ = 1;
+    block->Offset_.resize(num_elements);
+    memcpy(block->Offset_.data(), encoded.data() + offsets_section_start, offsets_bytes);
+    block->Data_.assign(encoded.begin(), encoded.begin() + offsets_section_start);
+    return block;
+  }
+
+  // 3b. 前缀压缩格式
+  if (body_end < kPrefixTrailer) {
+    throw std::runtime_error("Block trailer truncated");
+  }
+  size_t   data_end = body_end - kPrefixTrailer;
+  uint16_t num_elements, interval;
+  memcpy(&num_elements, encoded.data() + data_end, sizeof(uint16_t));
+  memcpy(&interval, encoded.data() + data_end + 2, sizeof(uint16_t));
+  const uint8_t version = encoded[data_end + 4];
+  if ((version != kFormatPrefix && version != kFormatPrefixHash) || interval == 0) {
+    throw std::runtime_error(std::format("Unsupported block format version {}", version));
+  }
+  block->version_          = kFormatPrefix;  // entry 布局相同, 内存里不区分
+  block->restart_interval_ = interval;
+
+  // 3c. 哈希索引在 entry 和 trailer 之间
+  if (version == kFormatPrefixHash) {
+    uint16_t num_buckets = 0;
+    if (data_end >= sizeof(uint16_t)) {
+      memcpy(&num_buckets, encoded.data() + data_end - sizeof(uint16_t), sizeof(uint16_t));
+    }
+    if (num_buckets == 0 || data_end < sizeof(uint16_t) + num_buckets) {
+      throw std::runtime_error("Block hash index truncated");
+    }
+    data_end -= sizeof(uint16_t) + num_buckets;
+    block->hash_buckets_.assign(encoded.begin() + data_end,
+                                encoded.begin() + data_end + num_buckets);
+    const size_t restarts = (num_elements + interval - 1) / interval;
+    for (uint8_t bucket : block->hash_buckets_) {
+      if (bucket >= restarts && bucket < kBucketCollision) {
+        throw std::runtime_error("Block hash index corrupted");
+      }
+    }
+  }
+  block->Data_.assign(encoded.begin(), encoded.begin() + data_end);
+
+  // 4. 顺序扫一遍重建每条 entry 的偏移, 顺带检查长度不越界, 前缀不超过上一条 key;
+  //    同时数出不同 key 的个数, 重新 encode 时哈希索引的桶数与写入时一致
+  block->Offset_.reserve(num_elements);
+  size_t      offset = 0, prev_key_len = 0;
+  std::string key;
+  for (size_t i = 0; i < num_elements; ++i) {
+    uint16_t shared, unshared, value_len;
+    if (data_end - offset < 3 * sizeof(uint16_t) + sizeof(uint64_t)) {
+      throw std::runtime_error("Block entry truncated");
+    }
+    memcpy(&shared, block->Data_.data() + offset, sizeof(uint16_t));
+    memcpy(&unshared, block->Data_.data() + offset + 2, sizeof(uint16_t));
+    if ((i % interval == 0 && shared != 0) || shared > prev_key_len ||
+        data_end - offset < 3 * sizeof(uint16_t) + unshared + sizeof(uint64_t)) {
+      throw std::runtime_error("Block entry corrupted");
+    }
+    memcpy(&value_len, block->Data_.data() + offset + 4 + unshared, sizeof(uint16_t));
+    const size_t size = 3 * sizeof(uint16_t) + unshared + value_len + sizeof(uint64_t);
+    if (data_end - offset < size || offset > UINT16_MAX) {
+      throw std::runtime_error("Block entry truncated");
+    }
+    const std::string_view delta(reinterpret_cast<const char*>(block->Data_.data() + offset + 4),
+                                 unshared);
+    if (i == 0 || !same_as_prev(key, shared, delta)) {
+      ++block->distinct_keys_;
+      key.resize(shared);
+      key.append(delta);
+    }
+    block->Offset_.push_back(offset);
+    offset += size;
+    prev_key_len = shared + unshared;
+  }
+  if (offset != data_end) {
+    throw std::runtime_error("Block entry count mismatch");
+  }
+  return block;
+}
 
-  // 5. 读取偏移数组
-  block->Offset_.resize(num_elements);
-  memcpy(block->Offset_.data(), encoded.data() + offsets_section_start,
-         num_elements * sizeof(uint16_t));
+// ─── entry 访问 ───────────────────────────────────────────────────────────────
 
-  // 6. 复制数据段
-  block->Data_.reserve(offsets_section_start);  // 优化内存分配
-  block->Data_.assign(encoded.begin(), encoded.begin() + offsets_section_start);
+Block::EntryView Block::parse_entry(const std::size_t offset) const {
+  const uint8_t* p = Data_.data() + offset;
+  EntryView      e{};
+  uint16_t       key_len, value_len;
+  size_t         pos = 0;
+  if (version_ == kFormatLegacy) {
+    memcpy(&key_len, p, sizeof(uint16_t));
+    pos = sizeof(uint16_t);
+  } else {
+    memcpy(&e.shared, p, sizeof(uint16_t));
+    memcpy(&key_len, p + sizeof(uint16_t), sizeof(uint16_t));
+    pos = 2 * sizeof(uint16_t);
+  }
+  e.delta = std::string_view(reinterpret_cast<const char*>(p + pos), key_len);
+  pos += key_len;
+  memcpy(&value_len, p + pos, sizeof(uint16_t));
+  pos += sizeof(uint16_t);
+  e.value = std::string_view(reinterpret_cast<const char*>(p + pos), value_len);
+  pos += value_len;
+  memcpy(&e.tranc_id, p + pos, sizeof(uint64_t));
+  e.size = pos + sizeof(uint64_t);
+  return e;
+}
 
-  return block;
+void Block::append_key(std::size_t index, std::string& key) const {
+  const auto e = parse_entry(Offset_[index]);
+  key.resize(e.shared);
+  key.append(e.delta);
 }
 
-// safe get_key/get_value/get_tranc_id with bounds checks
-std::string_view Block::get_key_view(const std::size_t offset) const {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    spdlog::info(" Block::get_key(const std::size_t offset) {} Invaild offset to much{}", offset,
-                 Offset_[Offset_.size() - 1]);
+std::string Block::get_key_at(std::size_t index) const {
+  std::string key;
+  for (size_t i = index - index % restart_interval_; i <= index; ++i) {
+    append_key(i, key);
   }
-  uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
-  return std::string_view(reinterpret_cast<const char*>(Data_.data() + offset + sizeof(uint16_t)),
-                     key_len);
+  return key;
 }
-std::string Block::get_key(const std::size_t offset) const {
-  if (offset > Offset_[Offset_.size() - 1]) {
-    spdlog::info(" Block::get_key(const std::size_t offset) {} Invaild offset to much{}", offset,
-                 Offset_[Offset_.size() - 1]);
+
+std::string_view Block::restart_key(std::size_t restart) const {
+  return parse_entry(Offset_[restart * restart_interval_]).delta;
+}
+
+std::size_t Block::index_of(std::size_t offset) const {
+  auto it = std::ranges::lower_bound(Offset_, offset);
+  if (it == Offset_.end() || *it != offset) {
+    throw std::out_of_range(std::format("Block: {} is not an entry offset", offset));
+  }
+  return static_cast<size_t>(it - Offset_.begin());
+}
+
+template <class Pred>
+std::size_t Block::partition_index(Pred pred, std::string* key_out) const {
+  const size_t n        = Offset_.size();
+  const size_t restarts = (n + restart_interval_ - 1) / restart_interval_;
+  // 重启点上是完整 key: 先二分出第一个不满足 pred 的重启点
+  size_t lo = 0, hi = restarts;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (pred(restart_key(mid))) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  // 答案在重启点 lo - 1 的区间里, 或者就是重启点 lo 本身
+  if (lo > 0) {
+    std::string key;
+    const size_t end = std::min(n, lo * restart_interval_);
+    for (size_t i = (lo - 1) * restart_interval_; i < end; ++i) {
+      append_key(i, key);
+      if (!pred(std::string_view(key))) {
+        if (key_out) *key_out = std::move(key);
+        return i;
+      }
+    }
+  }
+  const size_t idx = lo * restart_interval_;
+  if (key_out && idx < n) *key_out = std::string(restart_key(lo));
+  return std::min(idx, n);
+}
+
+std::size_t Block::hash_bucket_count(std::size_t entries, std::size_t distinct) const {
+  if (!Global_::BLOCK_HASH_INDEX || version_ == kFormatLegacy || distinct == 0) {
+    return 0;
+  }
+  const size_t restarts = (entries + restart_interval_ - 1) / restart_interval_;
+  if (restarts > kBucketCollision) {
+    return 0;
   }
-  uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
-  return std::string(reinterpret_cast<const char*>(Data_.data() + offset + sizeof(uint16_t)),
-                     key_len);
+  const auto buckets = static_cast<size_t>(distinct / Global_::BLOCK_HASH_INDEX_UTIL_RATIO);
+  return std::clamp<size_t>(buckets, 1, UINT16_MAX);
+}
+
+std::optional<std::size_t> Block::hash_seek(std::string_view key) const {
+  if (hash_buckets_.empty()) {
+    return std::nullopt;
+  }
+  const uint8_t bucket = hash_buckets_[key_hash(key) % hash_buckets_.size()];
+  if (bucket == kBucketEmpty) {
+    return Offset_.size();
+  }
+  if (bucket == kBucketCollision) {
+    return std::nullopt;
+  }
+  // 在重启点区间内顺序比较; matched 是当前 key 与目标 key 的公共前缀长度.
+  // 当前 key 的前 shared 字节与上一条相同, 上一条又小于目标, 所以:
+  //   shared >  matched: 与目标在 matched 处的比较结果同上一条, 仍然小于目标
+  //   shared <  matched: 在 shared 处比上一条大, 也就比目标大, key 不存在
+  //   shared == matched: 比较 delta 与目标剩下的部分
+  const size_t end     = std::min(Offset_.size(), (bucket + size_t{1}) * restart_interval_);
+  size_t       matched = 0;
+  for (size_t i = bucket * restart_interval_; i < end; ++i) {
+    const auto e = parse_entry(Offset_[i]);
+    if (e.shared > matched) {
+      continue;
+    }
+    if (e.shared < matched) {
+      break;
+    }
+    const std::string_view rest = key.substr(matched);
+    const size_t           cp   = std::ranges::mismatch(e.delta, rest).in1 - e.delta.begin();
+    matched += cp;
+    if (cp == rest.size()) {
+      if (cp == e.delta.size()) {
+        return i;
+      }
+      break;  // 目标是当前 key 的前缀
+    }
+    if (cp < e.delta.size() &&
+        static_cast<uint8_t>(e.delta[cp]) > static_cast<uint8_t>(rest[cp])) {
+      break;
+    }
+  }
+  return Offset_.size();
+}
+
+std::string Block::get_key(const std::size_t offset) const {
+  return get_key_at(index_of(offset));
 }
 std::optional<std::pair<std::string, uint64_t>> Block::get_value(const std::size_t offset) const {
   if (offset > Offset_[Offset_.size() - 1]) {
@@ -117,39 +370,17 @@ std::optional<std::pair<std::string, uint64_t>> Block::get_value(const std::size
                  Offset_[Offset_.size() - 1]);
     return std::nullopt;
   }
-
-  // 获取底层字节数据指针（unsigned char 类型）
-  const char* base = reinterpret_cast<const char*>(Data_.data());
-
-  // 读取 key_len
-  uint16_t key_len;
-  std::memcpy(&key_len, base + offset, sizeof(uint16_t));
-
-  // value_len 紧跟在 key 数据之后
-  const char* value_len_ptr = base + offset + sizeof(uint16_t) + key_len;
-  uint16_t    value_len;
-  std::memcpy(&value_len, value_len_ptr, sizeof(uint16_t));
-
-  // value 数据的起始位置
-  const char* value_start = value_len_ptr + sizeof(uint16_t);
-
-  // tr 紧跟在 value 数据之后
-  const char* tr_ptr = value_start + value_len;
-  uint64_t    tr;
-  std::memcpy(&tr, tr_ptr, sizeof(uint64_t));
-
-  std::string value(reinterpret_cast<const char*>(value_start), value_len);
-  return std::make_pair(value, tr);
+  const auto e = parse_entry(offset);
+  return std::make_pair(std::string(e.value), e.tranc_id);
 }
 std::shared_ptr<Block::Entry> Block::get_entry(std::size_t offset) {
   if (offset > Offset_[Offset_.size() - 1]) {
     spdlog::info("Block::get_entry(std::size_t offset) {} Invaild offset to much{}", offset,
                  Offset_[Offset_.size() - 1]);
   }
-  auto key            = get_key(offset);
-  auto value_tranc_id = get_value(offset);
+  const auto e = parse_entry(offset);
   return std::make_shared<Block::Entry>(
-      Block::Entry{key, std::string(value_tranc_id->first), value_tranc_id->second});
+      Block::Entry{get_key(offset), std::string(e.value), e.tranc_id});
 }
 
 std::optional<uint64_t> Block::get_tranc_id(const std::size_t offset) const {
@@ -157,21 +388,13 @@ std::optional<uint64_t> Block::get_tranc_id(const std::size_t offset) const {
     spdlog::info("Block::get_tranc_id(const std::size_t offset) {} Invaild offset {}", offset,
                  Offset_[Offset_.size() - 1]);
   }
-  uint16_t key_len;
-  std::memcpy(&key_len, Data_.data() + offset, sizeof(uint16_t));
-  size_t   pos = offset + sizeof(uint16_t) + key_len;
-  uint16_t value_len;
-  std::memcpy(&value_len, Data_.data() + pos, sizeof(uint16_t));
-  pos += sizeof(uint16_t) + value_len;
-  uint64_t tr;
-  std::memcpy(&tr, Data_.data() + pos, sizeof(uint64_t));
-  return tr;
+  return parse_entry(offset).tranc_id;
 }
 std::string Block::get_first_key() {
   if (Offset_.empty()) {
     return std::string();
   }
-  return get_key(Offset_[0]);
+  return get_key_at(0);
 }
 
 std::optional<std::pair<size_t, size_t>> Block::get_offset_binary(std::string_view key,
@@ -179,43 +402,34 @@ std::optional<std::pair<size_t, size_t>> Block::get_offset_binary(std::string_vi
   if (Offset_.empty()) {
     return std::nullopt;
   }
-  // 二分查找任意一个命中的 key。
-  int left = 0;
-  int right = static_cast<int>(Offset_.size()) - 1;
-  int found = -1;
-  while (left <= right) {
-    int         mid     = left + (right - left) / 2;
-    auto mid_key = get_key_view(Offset_[mid]);
-    if (mid_key == key) {
-      found = mid;
-      break;
-    } else if (mid_key < key) {
-      left = mid + 1;
-    } else {
-      right = mid - 1;
+  // 第一个 >= key 的位置, 即 key 最新的版本 (同 key 的版本按新到旧连续存放);
+  // 哈希索引能确定时不用二分
+  size_t first;
+  if (auto hit = hash_seek(key)) {
+    first = *hit;
+    if (first == Offset_.size()) {
+      return std::nullopt;
+    }
+  } else {
+    std::string cur;
+    first = partition_index([key](std::string_view k) { return k < key; }, &cur);
+    if (first == Offset_.size() || cur != key) {
+      return std::nullopt;
     }
-  }
-  if (found == -1) {
-    return std::nullopt;
-  }
-
-  // 同 key 的版本是连续存放的，并且按新到旧的顺序写入。
-  int first = found;
-  while (first > 0 && get_key_view(Offset_[first - 1]) == key) {
-    --first;
   }
 
   if (tranc_id == 0) {
-    return std::make_pair<size_t, size_t>(Offset_[first], first);
+    return std::make_pair<size_t, size_t>(Offset_[first], size_t{first});
   }
 
-  for (size_t idx = static_cast<size_t>(first); idx < Offset_.size(); ++idx) {
-    if (get_key(Offset_[idx]) != key) {
+  // 后面的条目只要拼出来等于 key 就是同 key 的旧版本, 直接和 key 比较, 不用拼接
+  for (size_t idx = first; idx < Offset_.size(); ++idx) {
+    const auto e = parse_entry(Offset_[idx]);
+    if (idx != first && !same_as_prev(key, e.shared, e.delta)) {
       break;
     }
-    auto cur_tranc_id = get_tranc_id(Offset_[idx]);
-    if (cur_tranc_id.has_value() && cur_tranc_id.value() <= tranc_id) {
-      return std::make_pair(Offset_[idx], idx);
+    if (e.tranc_id <= tranc_id) {
+      return std::make_pair(size_t{Offset_[idx]}, idx);
     }
   }
   return std::nullopt;
@@ -226,34 +440,12 @@ std::optional<std::pair<size_t, size_t>> Block::get_prefix_begin_offset_binary(
   if (Offset_.empty())
     return std::nullopt;
 
-  // 优先检查完全匹配（并传入 tranc_id）
-  auto exact = get_offset_binary(key_prefix);
-  if (exact.has_value()) {
-    auto index = exact.value().second;
-    while (index != 0 && get_key_view(Offset_[index - 1]) == key_prefix) {
-      index--;
-    }
-    return std::make_optional<std::pair<size_t, size_t>>(Offset_[index], index);
-  }
-
-  // 二分查找插入点（第一个 >= key_prefix）
-  int left       = 0;
-  int right      = Offset_.size() - 1;
-  int result_idx = -1;
-  while (left <= right) {
-    int         mid     = left + (right - left) / 2;
-    auto mid_key = get_key_view(Offset_[mid]);
-    if (mid_key.starts_with(key_prefix)) {
-      result_idx = mid;
-      right      = mid - 1;  // 继续查找可能更早的匹配项
-    } else if (mid_key < key_prefix) {
-      left = mid + 1;
-    } else {
-      right = mid - 1;
-    }
-  }
-  if (result_idx != -1) {
-    return std::make_pair(Offset_[result_idx], result_idx);
+  // 第一个 >= key_prefix 的 key; 以前缀开头才算命中
+  std::string  first_key;
+  const size_t idx =
+      partition_index([key_prefix](std::string_view k) { return k < key_prefix; }, &first_key);
+  if (idx < Offset_.size() && first_key.starts_with(key_prefix)) {
+    return std::make_pair(size_t{Offset_[idx]}, idx);
   }
   return std::nullopt;
 }
@@ -262,34 +454,21 @@ std::optional<std::pair<size_t, size_t>> Block::get_prefix_end_offset_binary(
     std::string_view key_prefix) {
   if (Offset_.empty()) return std::nullopt;
 
-  size_t left = 0;
-  size_t right = Offset_.size();
-  size_t res_idx = Offset_.size();
-
-  while (left < right) {
-    size_t mid = left + (right - left) / 2;
-    auto mid_key = get_key_view(Offset_[mid]);
-
-    // 只要当前 mid_key 还是以前缀开头，或者是小于前缀的
-    // 我们就往右找，直到找到第一个“大于前缀且不以前缀开头”的键
-    if (mid_key.starts_with(key_prefix) || mid_key < key_prefix) {
-      left = mid + 1;
-    } else {
-      res_idx = mid;
-      right = mid;
-    }
-  }
+  // 只要 key 还是以前缀开头，或者是小于前缀的就往右找，
+  // 直到第一个“大于前缀且不以前缀开头”的键
+  const size_t res_idx = partition_index([key_prefix](std::string_view k) {
+    return k.starts_with(key_prefix) || k < key_prefix;
+  });
 
   // res_idx 现在是第一个不属于该前缀的元素的索引
   // 我们返回它，作为 [begin, end) 的开区间终点
   if (res_idx > 0) {
     // 检查一下前一个元素是否真的匹配前缀，如果不匹配，说明整个 block 都没有
-    auto last_match_key = get_key_view(Offset_[res_idx - 1]);
-    if (last_match_key.starts_with(key_prefix)) {
-      return std::make_pair(Offset_[res_idx - 1], res_idx);
+    if (get_key_at(res_idx - 1).starts_with(key_prefix)) {
+      return std::make_pair(size_t{Offset_[res_idx - 1]}, res_idx);
     }
   }
-  
+
   return std::nullopt;
 }
 
@@ -337,7 +516,10 @@ std::optional<size_t> Block::get_offset(const std::size_t index) {
   return Offset_[index];
 }
 size_t Block::get_cur_size() const {
-  return Data_.size() + Offset_.size() * sizeof(uint16_t) + sizeof(uint16_t);
+  if (version_ == kFormatLegacy) {
+    return Data_.size() + Offset_.size() * sizeof(uint16_t) + sizeof(uint16_t);
+  }
+  return Data_.size() + kPrefixTrailer + index_bytes(hash_bucket_count(Offset_.size(), distinct_keys_));
 }
 
 std::optional<std::pair<std::string, uint64_t>> Block::get_value_binary(std::string_view key,
@@ -358,42 +540,79 @@ std::pair<std::string, std::string> Block::get_first_and_last_key() {
   if (Offset_.empty()) {
     return {std::string(), std::string()};
   }
-  std::string first_key = get_key(Offset_[0]);
-  std::string last_key  = get_key(Offset_[Offset_.size() - 1]);
+  std::string first_key = get_key_at(0);
+  std::string last_key  = get_key_at(Offset_.size() - 1);
   return {first_key, last_key};
 }
-bool Block::add_entry(const std::string& key, const std::string& value, const uint64_t tranc_id,
+bool Block::add_entry(std::string_view key, std::string_view value, const uint64_t tranc_id,
                       bool force_write) {
-  if ((!force_write) &&
-      (get_cur_size() + key.size() + value.size() + 3 * sizeof(uint16_t) > capcity) &&
-      !Offset_.empty()) {
+  if (!has_last_key_ && !Offset_.empty()) {
+    last_key_     = get_key_at(Offset_.size() - 1);  // decode 出来的 block 上追加
+    has_last_key_ = true;
+  }
+  const bool new_key = !has_last_key_ || last_key_ != key;
+
+  // 与上一条 key 共享的前缀长度; 重启点和旧格式 block 存完整 key
+  size_t shared = 0;
+  if (version_ == kFormatPrefix && Offset_.size() % restart_interval_ != 0) {
+    const size_t limit = std::min({last_key_.size(), key.size(), size_t{UINT16_MAX}});
+    while (shared < limit && last_key_[shared] == key[shared]) {
+      ++shared;
+    }
+  }
+  const size_t key_bytes = key.size() - shared;
+
+  // 计算entry大小：[shared(2B)] + key长度(2B) + key + value长度(2B) + value + tranc_id,
+  // 旧格式另有一个 2B 的偏移
+  const size_t header_bytes = version_ == kFormatLegacy ? sizeof(uint16_t) : 2 * sizeof(uint16_t);
+  const size_t entry_size =
+      header_bytes + key_bytes + sizeof(uint16_t) + value.size() + sizeof(uint64_t);
+  // 加入后的 block 大小: 旧格式另有一个 2B 的偏移, 新格式的哈希索引可能随之变大
+  const size_t distinct   = distinct_keys_ + (new_key ? 1 : 0);
+  size_t       size_after = get_cur_size() + entry_size;
+  if (version_ == kFormatLegacy) {
+    size_after += sizeof(uint16_t);
+  } else {
+    size_after = size_after - index_bytes(hash_bucket_count(Offset_.size(), distinct_keys_)) +
+                 index_bytes(hash_bucket_count(Offset_.size() + 1, distinct));
+  }
+  if ((!force_write) && (size_after > capcity) && !Offset_.empty()) {
     return false;
   }
-  // 计算entry大小：key长度(2B) + key + value长度(2B) + value + tranc_id
-  size_t entry_size =
-      sizeof(uint16_t) + key.size() + sizeof(uint16_t) + value.size() + sizeof(const uint64_t);
   size_t old_size = Data_.size();
   Data_.resize(old_size + entry_size);
+  uint8_t* p = Data_.data() + old_size;
 
-  // 写入key长度
-  uint16_t key_len = key.size();
-  memcpy(Data_.data() + old_size, &key_len, sizeof(uint16_t));
+  // 写入共享前缀长度和 key 剩余部分的长度
+  if (version_ == kFormatPrefix) {
+    uint16_t shared_len = shared;
+    memcpy(p, &shared_len, sizeof(uint16_t));
+    p += sizeof(uint16_t);
+  }
+  uint16_t key_len = key_bytes;
+  memcpy(p, &key_len, sizeof(uint16_t));
+  p += sizeof(uint16_t);
 
   // 写入key
-  memcpy(Data_.data() + old_size + sizeof(uint16_t), key.data(), key_len);
+  memcpy(p, key.data() + shared, key_len);
+  p += key_len;
 
   // 写入value长度
   uint16_t value_len = value.size();
-  memcpy(Data_.data() + old_size + sizeof(uint16_t) + key_len, &value_len, sizeof(uint16_t));
+  memcpy(p, &value_len, sizeof(uint16_t));
+  p += sizeof(uint16_t);
 
   // 写入value
-  memcpy(Data_.data() + old_size + sizeof(uint16_t) + key_len + sizeof(uint16_t), value.data(),
-         value_len);
+  memcpy(p, value.data(), value_len);
+  p += value_len;
   // 写入tranc_id
-  memcpy(Data_.data() + old_size + sizeof(uint16_t) + key_len + sizeof(uint16_t) + value_len,
-         &tranc_id, sizeof(const uint64_t));
+  memcpy(p, &tranc_id, sizeof(const uint64_t));
   // 记录偏移
   Offset_.push_back(old_size);
+  last_key_.assign(key);
+  has_last_key_ = true;
+  distinct_keys_ = distinct;
+  hash_buckets_.clear();  // 解码来的索引不再覆盖新加的 entry
   return true;
 }
 bool Block::is_empty() const {
@@ -403,20 +622,11 @@ void Block::print_debug() const {
   if (is_empty()) {
     return;
   }
+  std::string key;
   for (size_t i = 0; i < Offset_.size(); i++) {
-    uint16_t key_len;
-    std::memcpy(&key_len, Data_.data() + Offset_[i], sizeof(uint16_t));
-    auto key = std::string(
-        reinterpret_cast<const char*>(Data_.data() + Offset_[i] + sizeof(uint16_t)), key_len);
-    size_t   pos = Offset_[i] + sizeof(uint16_t) + key_len;
-    uint16_t value_len;
-    std::memcpy(&value_len, Data_.data() + pos, sizeof(uint16_t));
-    pos += sizeof(uint16_t);
-    auto value = std::string(reinterpret_cast<const char*>(Data_.data() + pos), value_len);
-    pos += value_len;
-    uint64_t tr;
-    std::memcpy(&tr, Data_.data() + pos, sizeof(uint64_t));
-    std::print("Block Entry {}: key={}, value={}, tranc_id={}\n", i, key, value, tr);
+    append_key(i, key);
+    const auto e = parse_entry(Offset_[i]);
+    std::print("Block Entry {}: key={}, value={}, tranc_id={}\n", i, key, e.value, e.tranc_id);
   }
 }
 
@@ -1,9 +1,17 @@
 #include "../../include/storage/BlockMeta.h"
+#include "../../include/core/Global.h"
 #include <cstring>
+#include <span>
 #include <stdexcept>
 #include <string_view>
 #include <vector>
 
+namespace {
+// num 字段里格式版本所在的位
+constexpr unsigned kVersionShift = 56;
+constexpr size_t   kNumMask      = (size_t{1} << kVersionShift) - 1;
+}  // namespace
+
 BlockMeta::BlockMeta() : first_key_(""), last_key_(""), offset_(0) {}
 BlockMeta::BlockMeta(std::string first_key, std::string last_key, size_t offset)
     : first_key_(first_key), last_key_(last_key), offset_(offset) {}
@@ -21,8 +29,9 @@ std::vector<uint8_t> BlockMeta::encode_meta_to_slice(std::vector<BlockMeta>& met
   }
   total_size += sizeof(uint32_t);  // hash
   slice.resize(total_size);
-  uint8_t* ptr = slice.data();
-  memcpy(ptr, &num_meta, sizeof(size_t));
+  uint8_t*     ptr    = slice.data();
+  const size_t header = num_meta | size_t{kFormatCrc32c} << kVersionShift;
+  memcpy(ptr, &header, sizeof(size_t));
   ptr += sizeof(size_t);
   for (const auto& metas : meta) {
     auto offset = metas.offset_;
@@ -43,8 +52,7 @@ std::vector<uint8_t> BlockMeta::encode_meta_to_slice(std::vector<BlockMeta>& met
   uint8_t* hash_start = slice.data() + sizeof(size_t);
   uint8_t* hash_end   = ptr;
   size_t   hash_size  = hash_end - hash_start;  //==data.size();
-  uint32_t hash       = std::hash<std::string_view>{}(
-      std::string_view(reinterpret_cast<const char*>(hash_start), hash_size));
+  uint32_t hash       = Global_::block_checksum(std::span(hash_start, hash_size));
   memcpy(ptr, &hash, sizeof(uint32_t));
   ptr += sizeof(uint32_t);
   return slice;
@@ -59,9 +67,14 @@ std::vector<BlockMeta> BlockMeta::decode_meta_from_slice(std::vector<uint8_t>& s
   }
   uint8_t* ptr        = slice.data();
   size_t   total_size = slice.size();
-  size_t   num_meta   = 0;
-  memcpy(&num_meta, slice.data(), sizeof(size_t));
+  size_t   header     = 0;
+  memcpy(&header, slice.data(), sizeof(size_t));
   ptr += sizeof(size_t);
+  const auto   version  = static_cast<uint8_t>(header >> kVersionShift);
+  const size_t num_meta = header & kNumMask;
+  if (version != kFormatLegacy && version != kFormatCrc32c) {
+    throw std::runtime_error("Unknown block meta format version");
+  }
   std::vector<BlockMeta> meta;
   for (int i{}; i < num_meta; i++) {
     size_t offset = 0;
@@ -85,10 +98,9 @@ std::vector<BlockMeta> BlockMeta::decode_meta_from_slice(std::vector<uint8_t>& s
   uint8_t* hash_start = slice.data() + sizeof(size_t);
   uint8_t* hash_end   = ptr;
   ptr += sizeof(uint32_t);
-  size_t   hash_size = hash_end - hash_start;
-  uint32_t hash2     = std::hash<std::string_view>{}(
-      std::string_view(reinterpret_cast<const char*>(hash_start), hash_size));
-  if (hash != hash2) {
+  size_t hash_size = hash_end - hash_start;
+  if (!Global_::block_checksum_matches(std::span(hash_start, hash_size), hash,
+                                       version == kFormatLegacy)) {
     throw std::runtime_error("Hash mismatch: data may be corrupted");
   }
   return meta;
@@ -37,16 +37,19 @@ void BlockCache::put(int sst_id, int block_id, std::shared_ptr<Block> block) {
       // 移除最久未使用的缓存项
       if (!cache_list_less_k.empty()) {
         // 优先从 cache_list_less_k 中移除
+        charge_bytes_ -= charge_of(cache_list_less_k.back().cache_block);
         cache_map_.erase(
             std::make_pair(cache_list_less_k.back().sst_id, cache_list_less_k.back().block_id));
         cache_list_less_k.pop_back();
       } else {
+        charge_bytes_ -= charge_of(cache_list_greater_k.back().cache_block);
         cache_map_.erase(std::make_pair(cache_list_greater_k.back().sst_id,
                                         cache_list_greater_k.back().block_id));
         cache_list_greater_k.pop_back();
       }
     }
 
+    charge_bytes_ += charge_of(block);
     CacheItem item = {sst_id, block_id, block, 1};
     cache_list_less_k.push_front(item);
     cache_map_[key] = cache_list_less_k.begin();
@@ -58,6 +61,14 @@ double BlockCache::hit_rate() const {
   return total_requests == 0 ? 0.0 : static_cast<double>(hits_requests) / total_requests;
 }
 
+size_t BlockCache::memory_usage() const {
+  return charge_bytes_.load(std::memory_order_relaxed);
+}
+
+size_t BlockCache::charge_of(const std::shared_ptr<Block>& block) {
+  return block ? block->get_cur_size() : 0;
+}
+
 void BlockCache::update_access_count(std::list<CacheItem>::iterator it) {
   ++it->access_count;
   if (it->access_count < k_) {
@@ -2,6 +2,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <span>
 #include <stdexcept>
 
 // ─── 内联哈希实现（无外部依赖）────────────────────────────────────────────
@@ -113,21 +114,29 @@ void BloomFilter::clear() noexcept {
 
 // ─── 序列化（磁盘格式）─────────────────────────────────────
 // 布局：[expected_elements_ : size_t][false_positive_rate_ : double]
-//        [num_bits_ : size_t][num_hashes_ : size_t][bit_data : N bytes]
+//        [num_bits_ : size_t][num_hashes_ : size_t][bit_data : N bytes][checksum : uint32_t]
+// expected_elements_ 的最高字节是格式版本：kFormatCrc32c 带末尾的 checksum，
+// kFormatLegacy（旧版，这个字节总是 0）没有 checksum
+namespace {
+constexpr unsigned kVersionShift = 56;
+constexpr size_t   kElementsMask = (size_t{1} << kVersionShift) - 1;
+}  // namespace
 
 size_t BloomFilter::encode_size() const noexcept {
     return sizeof(expected_elements_)    // size_t
          + sizeof(false_positive_rate_)  // double
          + sizeof(num_bits_)             // uint64_t（兼容旧 size_t，在 64 位系统上等价）
          + sizeof(num_hashes_)           // uint32_t（注意：旧版是 size_t，见下方注释）
-         + bits_.size();                 // ceil(num_bits_ / 8) 字节
+         + bits_.size()                  // ceil(num_bits_ / 8) 字节
+         + sizeof(uint32_t);             // checksum
 }
 
 size_t BloomFilter::encode_into(uint8_t* dst) const {
     uint8_t* ptr = dst;
 
     // Header
-    std::memcpy(ptr, &expected_elements_, sizeof(expected_elements_)); ptr += sizeof(expected_elements_);
+    const size_t header = (expected_elements_ & kElementsMask) | size_t{kFormatCrc32c} << kVersionShift;
+    std::memcpy(ptr, &header, sizeof(header)); ptr += sizeof(header);
     std::memcpy(ptr, &false_positive_rate_, sizeof(false_positive_rate_)); ptr += sizeof(false_positive_rate_);
     std::memcpy(ptr, &num_bits_, sizeof(num_bits_));   ptr += sizeof(num_bits_);
     std::memcpy(ptr, &num_hashes_, sizeof(num_hashes_)); ptr += sizeof(num_hashes_);
@@ -136,6 +145,9 @@ size_t BloomFilter::encode_into(uint8_t* dst) const {
     std::memcpy(ptr, bits_.data(), bits_.size());
     ptr += bits_.size();
 
+    const uint32_t checksum = Global_::block_checksum(std::span<const uint8_t>(dst, ptr));
+    std::memcpy(ptr, &checksum, sizeof(checksum)); ptr += sizeof(checksum);
+
     return static_cast<size_t>(ptr - dst);
 }
 
@@ -157,7 +169,10 @@ BloomFilter BloomFilter::decode(const std::vector<uint8_t>& data) {
  BloomFilter bf(DecodeTag{}); 
     const uint8_t* ptr = data.data();
 
-    std::memcpy(&bf.expected_elements_, ptr, sizeof(bf.expected_elements_)); ptr += sizeof(bf.expected_elements_);
+    size_t header;
+    std::memcpy(&header, ptr, sizeof(header)); ptr += sizeof(header);
+    const auto version    = static_cast<uint8_t>(header >> kVersionShift);
+    bf.expected_elements_ = header & kElementsMask;
     std::memcpy(&bf.false_positive_rate_, ptr, sizeof(bf.false_positive_rate_)); ptr += sizeof(bf.false_positive_rate_);
     std::memcpy(&bf.num_bits_, ptr, sizeof(bf.num_bits_));   ptr += sizeof(bf.num_bits_);
     std::memcpy(&bf.num_hashes_, ptr, sizeof(bf.num_hashes_)); ptr += sizeof(bf.num_hashes_);
@@ -165,11 +180,23 @@ BloomFilter BloomFilter::decode(const std::vector<uint8_t>& data) {
     const size_t expected_bytes = (bf.num_bits_ + 7u) / 8u;
     const size_t consumed       = static_cast<size_t>(ptr - data.data());
 
-    if (data.size() != consumed + expected_bytes) {
+    if (version != kFormatLegacy && version != kFormatCrc32c) {
+        throw std::runtime_error("BloomFilter::decode: unknown format version " +
+                                 std::to_string(version));
+    }
+    const size_t body_size = consumed + expected_bytes;
+    const size_t total     = body_size + (version == kFormatCrc32c ? sizeof(uint32_t) : 0);
+    if (data.size() != total) {
         throw std::invalid_argument(
             "BloomFilter::decode: data size mismatch, expected " +
-            std::to_string(consumed + expected_bytes) +
-            " got " + std::to_string(data.size()));
+            std::to_string(total) + " got " + std::to_string(data.size()));
+    }
+    if (version == kFormatCrc32c) {
+        uint32_t checksum;
+        std::memcpy(&checksum, data.data() + body_size, sizeof(checksum));
+        if (Global_::block_checksum(std::span(data.data(), body_size)) != checksum) {
+            throw std::runtime_error("BloomFilter::decode: checksum mismatch");
+        }
     }
 
     // 直接 memcpy 到 uint8_t 位压缩数组
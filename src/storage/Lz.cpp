@@ -0,0 +1,171 @@
+#include "../../include/storage/Lz.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+constexpr size_t kMinMatch  = 4;
+constexpr size_t kHashBits  = 14;  // 16K 项, 覆盖 64KB 的字典窗口
+constexpr size_t kNibbleMax = 15;
+// 窗口 / 历史超过这个长度时只保留最后 kMaxOffset 字节, 摊薄搬移的开销
+constexpr size_t kWindowTrim = 4 * Lz::kMaxOffset;
+
+uint32_t load32(const uint8_t* p) noexcept {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+uint32_t hash4(uint32_t v) noexcept {
+  return (v * 2654435761u) >> (32 - kHashBits);
+}
+
+// 长度超出 token 里 4 位能表示的部分: 255 255 ... 余数
+void put_extra_length(std::vector<uint8_t>& out, size_t len) {
+  for (; len >= 255; len -= 255) out.push_back(255);
+  out.push_back(static_cast<uint8_t>(len));
+}
+
+// match_len == 0 表示最后一个只有字面量的 sequence
+void emit_sequence(std::vector<uint8_t>& out, const uint8_t* lit, size_t lit_len, size_t offset,
+                   size_t match_len) {
+  const size_t ml = match_len ? match_len - kMinMatch : 0;
+  out.push_back(static_cast<uint8_t>((std::min(lit_len, kNibbleMax) << 4) |
+                                     std::min(ml, kNibbleMax)));
+  if (lit_len >= kNibbleMax) put_extra_length(out, lit_len - kNibbleMax);
+  out.insert(out.end(), lit, lit + lit_len);
+  if (match_len == 0) return;
+  out.push_back(static_cast<uint8_t>(offset & 0xFF));
+  out.push_back(static_cast<uint8_t>(offset >> 8));
+  if (ml >= kNibbleMax) put_extra_length(out, ml - kNibbleMax);
+}
+
+// 压缩 p[start, n), 匹配可以回退到 start 之前的字典部分.
+// table 里的位置可能是过期的 (来自没 commit 的记录), 所以候选必须在当前位置之前且字节相等
+void compress_range(const uint8_t* p, size_t start, size_t n, uint32_t* table,
+                    std::vector<uint8_t>& out) {
+  size_t anchor = start;
+  size_t i      = start;
+  while (i + kMinMatch <= n) {
+    const uint32_t v    = load32(p + i);
+    auto&          slot = table[hash4(v)];
+    const size_t   cand = slot;
+    slot                = static_cast<uint32_t>(i + 1);
+    if (cand == 0 || cand - 1 >= i || i - (cand - 1) > Lz::kMaxOffset ||
+        load32(p + cand - 1) != v) {
+      ++i;
+      continue;
+    }
+    const size_t match = cand - 1;
+    size_t       len   = kMinMatch;
+    while (i + len < n && p[match + len] == p[i + len]) ++len;
+    emit_sequence(out, p + anchor, i - anchor, i - match, len);
+    i += len;
+    anchor = i;
+  }
+  emit_sequence(out, p + anchor, n - anchor, 0, 0);
+}
+
+bool get_extra_length(std::span<const uint8_t> src, size_t& ip, size_t& len) {
+  uint8_t b;
+  do {
+    if (ip >= src.size()) return false;
+    b = src[ip++];
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+// 解压到 base[start, start + raw_size), 匹配可以回退到 base 的开头
+bool decode_into(std::span<const uint8_t> src, uint8_t* base, size_t start, size_t raw_size) {
+  const size_t end = start + raw_size;
+  size_t       ip  = 0;
+  size_t       op  = start;
+  while (ip < src.size()) {
+    const uint8_t token = src[ip++];
+
+    size_t lit = token >> 4;
+    if (lit == kNibbleMax && !get_extra_length(src, ip, lit)) return false;
+    if (lit > src.size() - ip || lit > end - op) return false;
+    std::memcpy(base + op, src.data() + ip, lit);
+    ip += lit;
+    op += lit;
+    if (ip == src.size()) break;  // 最后一个 sequence 没有匹配部分
+
+    if (src.size() - ip < 2) return false;
+    const size_t offset = src[ip] | (static_cast<size_t>(src[ip + 1]) << 8);
+    ip += 2;
+    if (offset == 0 || offset > op) return false;
+    size_t ml = token & kNibbleMax;
+    if (ml == kNibbleMax && !get_extra_length(src, ip, ml)) return false;
+    ml += kMinMatch;
+    if (ml > end - op) return false;
+    // 匹配可以和输出重叠 (offset < ml), 这时只能逐字节复制
+    uint8_t* dst = base + op;
+    if (offset >= ml) {
+      std::memcpy(dst, dst - offset, ml);
+    } else {
+      for (size_t k = 0; k < ml; ++k) dst[k] = dst[k - offset];
+    }
+    op += ml;
+  }
+  return op == end;
+}
+
+}  // namespace
+
+void Lz::compress(std::span<const uint8_t> src, std::vector<uint8_t>& out) {
+  std::vector<uint32_t> table(size_t{1} << kHashBits);
+  compress_range(src.data(), 0, src.size(), table.data(), out);
+}
+
+bool Lz::decompress(std::span<const uint8_t> src, size_t raw_size, std::vector<uint8_t>& out) {
+  out.resize(raw_size);
+  return decode_into(src, out.data(), 0, raw_size);
+}
+
+// ─── Encoder ──────────────────────────────────────────────────────────────────
+
+Lz::Encoder::Encoder() : table_(size_t{1} << kHashBits) {}
+
+void Lz::Encoder::compress(std::span<const uint8_t> src, std::vector<uint8_t>& out) {
+  window_.resize(committed_);
+  window_.insert(window_.end(), src.begin(), src.end());
+  compress_range(window_.data(), committed_, window_.size(), table_.data(), out);
+}
+
+void Lz::Encoder::commit() {
+  committed_ = window_.size();
+  if (committed_ <= kWindowTrim) return;
+  // 只留最后 kMaxOffset 字节, 哈希表里的位置跟着平移, 移出窗口的作废
+  const size_t shift = committed_ - kMaxOffset;
+  window_.erase(window_.begin(), window_.begin() + static_cast<std::ptrdiff_t>(shift));
+  committed_ = window_.size();
+  for (auto& pos : table_) pos = pos > shift ? static_cast<uint32_t>(pos - shift) : 0;
+}
+
+void Lz::Encoder::reset() {
+  window_.clear();
+  committed_ = 0;
+  std::ranges::fill(table_, 0);
+}
+
+// ─── Decoder ──────────────────────────────────────────────────────────────────
+
+std::optional<std::span<const uint8_t>> Lz::Decoder::decompress(std::span<const uint8_t> src,
+                                                                size_t                   raw_size) {
+  if (history_.size() > kWindowTrim)
+    history_.erase(history_.begin(),
+                   history_.end() - static_cast<std::ptrdiff_t>(kMaxOffset));
+  const size_t start = history_.size();
+  history_.resize(start + raw_size);
+  if (!decode_into(src, history_.data(), start, raw_size)) {
+    history_.resize(start);
+    return std::nullopt;
+  }
+  return std::span<const uint8_t>{history_}.subspan(start);
+}
+
+void Lz::Decoder::reset() {
+  history_.clear();
+}
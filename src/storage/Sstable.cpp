@@ -86,7 +86,7 @@ std::shared_ptr<Sstable> Sstable::create_sst_with_meta_only(
   return sst;
 }
 
-std::shared_ptr<Block> Sstable::read_block(size_t block_idx) {
+std::shared_ptr<Block> Sstable::read_block(size_t block_idx, const ReadOptions& options) {
   if (!is_block_index_vaild(block_idx)) {
     spdlog::info("Sstable::read_block(size_t block_idx) Block index out of range {}",
                  block_metas.size());
@@ -115,9 +115,12 @@ std::shared_ptr<Block> Sstable::read_block(size_t block_idx) {
 
   // 读取block数据
   auto block_data = file_obj.read_to_slice(meta.offset_, block_size);
-  auto block_res  = Block::decode(block_data);
+  auto block_res  = Block::decode(block_data, true, options.verify_checksums);
 
-  block_cache->put(sst_id, block_idx, block_res);
+  // 没校验过的 block 不进缓存: 迭代器和 compaction 从缓存拿到的 block 不再校验
+  if (block_cache != nullptr && options.verify_checksums) {
+    block_cache->put(sst_id, block_idx, block_res);
+  }
   return block_res;
 }
 
@@ -221,8 +224,9 @@ std::string Sstable::get_last_key() const {
 bool Sstable::is_block_index_vaild(size_t block_idx) const {
   return block_idx < block_metas.size() ? true : false;
 }
-std::optional<std::pair<std::string, uint64_t>> Sstable::KeyExists(std::string_view key,
-                                                                        uint64_t         tranc_id) {
+std::optional<std::pair<std::string, uint64_t>> Sstable::KeyExists(std::string_view   key,
+                                                                   uint64_t           tranc_id,
+                                                                   const ReadOptions& options) {
   if (key < first_key || key > last_key) {
     return std::nullopt;
   }
@@ -230,7 +234,7 @@ std::optional<std::pair<std::string, uint64_t>> Sstable::KeyExists(std::string_v
   if (!block_idx_opt.has_value()) {
     return std::nullopt;
   }
-  auto block = read_block(block_idx_opt.value());
+  auto block = read_block(block_idx_opt.value(), options);
   return block->get_value_binary(key, tranc_id);
 }
 SstIterator Sstable::get_Iterator(std::string_view key, uint64_t tranc_id, bool is_prefix) {
@@ -317,8 +321,10 @@ void Sstbuild::clean() {
                                                  Global_::bloom_filter_expected_error_rate_);
 block_=std::make_shared<Block>();
   block_metas.clear();
+  data.clear();
+  is_first_key_set_ = false;
 }
-void Sstbuild::add(const std::string& key, const std::string& value, uint64_t tranc_id) {
+void Sstbuild::add(std::string_view key, std::string_view value, uint64_t tranc_id) {
   // 在布隆过滤器中添加key
   if (bloom_filter != nullptr) {
     bloom_filter->add(key);
@@ -332,7 +338,10 @@ void Sstbuild::add(const std::string& key, const std::string& value, uint64_t tr
         current_block_first_key_ = key;
         is_first_key_set_ = true;
     }
-  if (block_->add_entry(key, value, tranc_id)) {
+  // 同一个 key 的所有版本必须落在同一个 block 里, 否则按 key 定位 block 时
+  // 可能只命中旧版本; 因此与上一条同 key 时强制写入当前 block
+  const bool same_key = !block_->is_empty() && key == current_block_last_key_;
+  if (block_->add_entry(key, value, tranc_id, same_key)) {
       current_block_last_key_ =key; // 每次 add 都更新 last_key
     return;
   }
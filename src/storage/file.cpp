@@ -112,6 +112,14 @@ bool FileObj::write(size_t offset, std::vector<uint8_t>& buffer) {
   return m_file->write(offset, buffer.data(), buffer.size());
 }
 
+bool FileObj::writev(size_t offset, std::span<const std::span<const uint8_t>> bufs) {
+  if (!m_file) {
+    return false;
+  }
+
+  return m_file->writev(offset, bufs);
+}
+
 bool FileObj::append(std::vector<uint8_t>& buffer) {
   if (!m_file) {
     return false;
@@ -141,6 +149,31 @@ bool FileObj::sync() {
 
   return m_file->sync();
 }
+bool FileObj::sync_data() {
+  if (!m_file) {
+    return false;
+  }
+  return m_file->sync_data();
+}
+
+bool FileObj::allocate(size_t size) {
+  if (!m_file) {
+    return false;
+  }
+  return m_file->allocate(size);
+}
+
+bool FileObj::rename(const std::string& new_path) {
+  if (!m_file) {
+    return false;
+  }
+  return m_file->rename(new_path);
+}
+
+bool FileObj::sync_dir(const std::string& dir) {
+  return StdFile::sync_dir(dir);
+}
+
 void FileObj::close() {
   if (m_file) {
     m_file->close();
@@ -1,7 +1,10 @@
 #include "../../include/storage/file.h"
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/uio.h>
 #include <sys/stat.h>
+#include <algorithm>
+#include <array>
 #include <filesystem>
 #include <stdexcept>
 #include <iostream>
@@ -76,10 +79,69 @@ bool StdFile::write(size_t offset, const void* data, size_t sz) {
   return n == static_cast<ssize_t>(sz);
 }
 
+bool StdFile::writev(size_t offset, std::span<const std::span<const uint8_t>> bufs) {
+  constexpr size_t           kMaxIov = 64;  // 每次系统调用最多带这么多段
+  std::array<iovec, kMaxIov> iov;
+  while (!bufs.empty()) {
+    const size_t count = std::min(bufs.size(), kMaxIov);
+    size_t       total = 0;
+    for (size_t i = 0; i < count; ++i) {
+      iov[i] = {const_cast<uint8_t*>(bufs[i].data()), bufs[i].size()};
+      total += bufs[i].size();
+    }
+    const ssize_t n =
+        ::pwritev(fd_, iov.data(), static_cast<int>(count), static_cast<off_t>(offset));
+    if (n < 0)
+      return false;
+    if (static_cast<size_t>(n) < total) {
+      // 短写: 没写完的部分逐段用 pwrite 补上
+      size_t written = static_cast<size_t>(n);
+      size_t pos     = offset;
+      for (size_t i = 0; i < count; ++i) {
+        const auto& b = bufs[i];
+        if (written < b.size() && !write(pos + written, b.data() + written, b.size() - written))
+          return false;
+        written -= std::min(written, b.size());
+        pos += b.size();
+      }
+    }
+    offset += total;
+    bufs = bufs.subspan(count);
+  }
+  return true;
+}
+
 bool StdFile::sync() {
   return ::fsync(fd_) == 0;
 }
 
+bool StdFile::sync_data() {
+  return ::fdatasync(fd_) == 0;
+}
+
+bool StdFile::allocate(size_t size) {
+  return ::posix_fallocate(fd_, 0, static_cast<off_t>(size)) == 0;
+}
+
+// fd 保持打开, 只是换个名字
+bool StdFile::rename(const std::string& new_filename) {
+  if (std::rename(filename_.c_str(), new_filename.c_str()) != 0) {
+    return false;
+  }
+  filename_ = new_filename;
+  return true;
+}
+
+bool StdFile::sync_dir(const std::string& dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+}
+
 bool StdFile::remove() {
   close();
   return std::remove(filename_.c_str()) == 0;
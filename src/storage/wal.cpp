@@ -1,45 +1,264 @@
 #include "../../include/storage/wal.h"
 #include "../../include/core/Global.h"
+#include "spdlog/spdlog.h"
 #include <algorithm>
 #include <array>
+#include <cstring>
 #include <filesystem>
+#include <optional>
+#include <ranges>
+#include <stdexcept>
 
-// ─── CRC-32C (Castagnoli) ─────────────────────────────────────────────────────
 namespace {
 
-// Generate lookup table at compile time.
-
-
 // ─── Block / record constants ─────────────────────────────────────────────────
 inline constexpr size_t kBlockSize  = Global_::WAL_BLOCK_SIZE;  // 32 KB
-inline constexpr size_t kHeaderSize = 7;                        // crc(4)+len(2)+type(1)
+inline constexpr size_t kHeaderSize = 11;  // crc(4)+len(2)+type(1)+log_number(4)
 
-inline constexpr uint8_t kRecZero   = 0;  // padding / empty
+inline constexpr uint8_t kRecZero   = 0;  // preallocated space / logical end
 inline constexpr uint8_t kRecFull   = 1;  // fits in one block
 inline constexpr uint8_t kRecFirst  = 2;  // first fragment
 inline constexpr uint8_t kRecMiddle = 3;  // interior fragment
 inline constexpr uint8_t kRecLast   = 4;  // last fragment
 
+inline constexpr uint8_t kRecCompressed = 0x80;  // type flag: payload is LZ-compressed
+inline constexpr size_t  kRawLengthSize = 4;     // raw_length prefix of a compressed payload
+
+// ─── Segment header (block 0) ─────────────────────────────────────────────────
+inline constexpr uint32_t kSegmentMagic      = 0x4C415754;  // "TWAL"
+inline constexpr uint32_t kSegmentVersion    = 2;
+inline constexpr size_t   kSegmentHeaderSize = 4 + 4 + 8 + 8 + 8 + 8 + 4 + 4;
+inline constexpr uint32_t kSegmentSealed     = 1;  // header flag: range is final
+inline constexpr size_t   kDataStart         = kBlockSize;  // records start at block 1
+inline constexpr size_t   kReadSize          = Global_::WAL_RECOVERY_READ_SIZE;
+inline constexpr size_t   kMaxRetainedBlocks = 128;  // block buffers (4 MB) kept between groups
+static_assert(kReadSize % kBlockSize == 0, "recovery reads whole blocks");
+
+inline constexpr std::string_view kSegmentPrefix  = "wal.";
+inline constexpr std::string_view kRecyclePrefix  = "recycled_wal.";
+
+struct SegmentHeader {
+  uint64_t log_number;
+  uint64_t logical_end;
+  uint64_t min_tranc_id;  // UINT64_MAX / 0 while the segment is empty
+  uint64_t max_tranc_id;
+  bool     sealed;
+};
+
+std::vector<uint8_t> encode_segment_header(const SegmentHeader& h) {
+  std::vector<uint8_t> buf;
+  buf.reserve(kSegmentHeaderSize);
+  Global_::write_le(buf, kSegmentMagic);
+  Global_::write_le(buf, kSegmentVersion);
+  Global_::write_le(buf, h.log_number);
+  Global_::write_le(buf, h.logical_end);
+  Global_::write_le(buf, h.min_tranc_id);
+  Global_::write_le(buf, h.max_tranc_id);
+  Global_::write_le(buf, h.sealed ? kSegmentSealed : 0u);
+  Global_::write_le(buf, Global_::crc32c(std::span{buf}));
+  return buf;
+}
+
+// nullopt when the header is missing, torn or from an unknown version
+// (version 1 headers had no tranc_id range; such segments are read as if
+// headerless).
+std::optional<SegmentHeader> read_segment_header(FileObj& file) {
+  if (file.size() < kDataStart)
+    return std::nullopt;
+  const auto raw = file.read_to_slice(0, kSegmentHeaderSize);
+  const auto buf = std::span<const uint8_t>{raw};
+  if (Global_::read_le<uint32_t>(buf, 0) != kSegmentMagic ||
+      Global_::read_le<uint32_t>(buf, 4) != kSegmentVersion ||
+      Global_::read_le<uint32_t>(buf, 44) != Global_::crc32c(buf.first(44)))
+    return std::nullopt;
+  return SegmentHeader{Global_::read_le<uint64_t>(buf, 8), Global_::read_le<uint64_t>(buf, 16),
+                       Global_::read_le<uint64_t>(buf, 24), Global_::read_le<uint64_t>(buf, 32),
+                       (Global_::read_le<uint32_t>(buf, 40) & kSegmentSealed) != 0};
+}
+
+// Number after `prefix` in a file name, nullopt for anything else.
+std::optional<uint64_t> parse_segment_number(std::string_view name, std::string_view prefix) {
+  if (!name.starts_with(prefix) || name.size() == prefix.size())
+    return std::nullopt;
+  uint64_t n = 0;
+  for (char c : name.substr(prefix.size())) {
+    if (c < '0' || c > '9')
+      return std::nullopt;
+    n = n * 10 + static_cast<uint64_t>(c - '0');
+  }
+  return n;
+}
+
+// (log_number, path) of every file named <prefix><n> in dir, ascending.
+std::vector<std::pair<uint64_t, std::string>> list_segments(const std::string& dir,
+                                                            std::string_view   prefix) {
+  namespace fs = std::filesystem;
+  std::vector<std::pair<uint64_t, std::string>> segments;
+  for (const auto& de : fs::directory_iterator(dir)) {
+    if (!de.is_regular_file())
+      continue;
+    if (auto n = parse_segment_number(de.path().filename().string(), prefix))
+      segments.emplace_back(*n, de.path().string());
+  }
+  std::ranges::sort(segments);
+  return segments;
+}
+
+// ─── Segment reader ───────────────────────────────────────────────────────────
+//  Hands every complete record payload of one segment to fn, in order, and
+//  stops at the logical end (see wal.h).  Inside the range the header vouches
+//  for, a record that would mark the end is returned as an error instead.
+//  A segment whose header names another log number was renamed for reuse
+//  but never rewritten; it holds nothing of this log number.
+template <class Fn>
+std::expected<void, WalError> read_segment(FileObj& file, uint64_t log_number, Fn&& fn) {
+  const size_t file_size = file.size();
+  const auto   header    = read_segment_header(file);
+  if (header && header->log_number != log_number)
+    return {};
+  const uint64_t trusted_end = header ? header->logical_end : kDataStart;
+  const auto     tag         = static_cast<uint32_t>(log_number);
+
+  std::vector<uint8_t> scratch;  // accumulates record fragments
+  Lz::Decoder          lz;  // history of the segment's compressed payloads
+  bool                 in_fragment = false;
+  bool                 compressed  = false;  // flag of the entry being assembled
+
+  // Hands one complete payload to fn, decompressing it first if flagged.
+  // The CRC already matched, so a payload that fails to decompress is
+  // corruption rather than the end of the log.
+  auto deliver = [&](std::span<const uint8_t> payload) -> std::expected<void, WalError> {
+    if (!compressed)
+      return fn(payload);
+    if (payload.size() < kRawLengthSize)
+      return std::unexpected(WalError::kCorrupted);
+    const auto raw =
+        lz.decompress(payload.subspan(kRawLengthSize), Global_::read_le<uint32_t>(payload, 0));
+    if (!raw)
+      return std::unexpected(WalError::kCorrupted);
+    return fn(*raw);
+  };
+
+  // Parses the records of one block; false once the logical end is reached.
+  auto parse_block = [&](std::span<const uint8_t> block,
+                         size_t                   block_start) -> std::expected<bool, WalError> {
+    size_t pos = 0;
+    // Tail shorter than a record header is never written.
+    while (block.size() - pos >= kHeaderSize) {
+      const bool trusted    = block_start + pos < trusted_end;
+      auto       end_of_log = [trusted](WalError e) -> std::expected<bool, WalError> {
+        if (trusted)
+          return std::unexpected(e);
+        return false;
+      };
+
+      const uint32_t stored_crc = Global_::unmask_crc(Global_::read_le<uint32_t>(block, pos));
+      const uint16_t rec_len    = Global_::read_le<uint16_t>(block, pos + 4);
+      const uint8_t  rec_type   = block[pos + 6] & ~kRecCompressed;
+      const bool     rec_lz     = (block[pos + 6] & kRecCompressed) != 0;
+      const uint32_t rec_tag    = Global_::read_le<uint32_t>(block, pos + 7);
+
+      if (rec_type == kRecZero || pos + kHeaderSize + rec_len > block.size())
+        return end_of_log(WalError::kCorrupted);
+      // CRC covers [type || log_number || data], checked in place
+      if (Global_::crc32c(block.subspan(pos + 6, 5 + rec_len)) != stored_crc)
+        return end_of_log(WalError::kChecksumMismatch);
+      if (rec_tag != tag)
+        return end_of_log(WalError::kCorrupted);
+
+      const auto data = block.subspan(pos + kHeaderSize, rec_len);
+      pos += kHeaderSize + rec_len;
+
+      switch (rec_type) {
+        case kRecFull:
+          if (in_fragment)
+            return end_of_log(WalError::kCorrupted);
+          compressed = rec_lz;
+          if (auto r = deliver(data); !r)
+            return std::unexpected(r.error());
+          break;
+        case kRecFirst:
+          if (in_fragment)
+            return end_of_log(WalError::kCorrupted);
+          scratch.assign(data.begin(), data.end());
+          in_fragment = true;
+          compressed  = rec_lz;
+          break;
+        case kRecMiddle:
+        case kRecLast:
+          if (!in_fragment || rec_lz != compressed)
+            return end_of_log(WalError::kCorrupted);
+          scratch.insert(scratch.end(), data.begin(), data.end());
+          if (rec_type == kRecLast) {
+            in_fragment = false;
+            if (auto r = deliver(std::span<const uint8_t>{scratch}); !r)
+              return std::unexpected(r.error());
+            scratch.clear();
+          }
+          break;
+        default:
+          return end_of_log(WalError::kCorrupted);
+      }
+    }
+    return true;
+  };
+
+  // One pread per kReadSize chunk instead of several per record.
+  for (size_t chunk_start = kDataStart; chunk_start < file_size; chunk_start += kReadSize) {
+    const auto raw   = file.read_to_slice(chunk_start, std::min(kReadSize, file_size - chunk_start));
+    const auto chunk = std::span<const uint8_t>{raw};
+    for (size_t off = 0; off < chunk.size(); off += kBlockSize) {
+      auto more = parse_block(chunk.subspan(off, std::min(kBlockSize, chunk.size() - off)),
+                              chunk_start + off);
+      if (!more)
+        return std::unexpected(more.error());
+      if (!*more)
+        return {};
+    }
+  }
+  // An unfinished kFirst/kMiddle sequence at the end is dropped (#12488).
+  return {};
+}
+
 }  // namespace
 
 WAL::WAL(std::string_view log_dir, uint64_t checkpoint_tranc_id, uint64_t clean_interval_s,
-         uint64_t file_size_limit)
-    : file_size_limit_(file_size_limit),
+         uint64_t file_size_limit, Global_::WalCompression compression)
+    : log_dir_(log_dir),
+      file_size_limit_(std::max<uint64_t>(file_size_limit, 2 * kBlockSize)),
+      compression_(compression),
       checkpoint_tranc_id_(checkpoint_tranc_id),
       clean_interval_s_(clean_interval_s) {
   namespace fs = std::filesystem;
-  if (!fs::exists(log_dir))
-    fs::create_directories(log_dir);
-
-  active_log_path_ = std::string(log_dir) + "/wal.0";
-  log_file_        = FileObj::open(active_log_path_, /*create=*/true);
-  // Resume at the correct position inside the last block.
-  block_offset_ = log_file_.size() % kBlockSize;
+  if (!fs::exists(log_dir_))
+    fs::create_directories(log_dir_);
+
+  // Existing segments are left alone for recover(); this log continues
+  // after the highest log number ever used, recycled ones included.
+  for (const auto& [n, path] : list_segments(log_dir_, kSegmentPrefix))
+    log_number_ = std::max(log_number_, n);
+  for (auto& [n, path] : list_segments(log_dir_, kRecyclePrefix)) {
+    log_number_ = std::max(log_number_, n);
+    if (recycled_.size() < Global_::WAL_RECYCLE_SEGMENTS)
+      recycled_.push_back(std::move(path));
+    else
+      fs::remove(path);
+  }
+  if (!open_segment())
+    throw std::runtime_error("WAL: failed to open segment " + active_log_path_);
 
+  async_thread_   = std::thread(&WAL::async_writer, this);
   cleaner_thread_ = std::thread(&WAL::cleaner, this);
 }
 
 WAL::~WAL() {
+  // Pending log_async() requests are still written before the final flush.
+  stop_async_.store(true, std::memory_order_release);
+  async_pushed_.fetch_add(1, std::memory_order_release);
+  async_pushed_.notify_one();
+  if (async_thread_.joinable())
+    async_thread_.join();
+
   if (auto result = flush(); !result) {
     // 记录错误，例如写入 stderr 或日志文件
     std::fprintf(stderr, "WAL flush failed during destruction: error %d\n",
@@ -54,13 +273,16 @@ WAL::~WAL() {
   if (cleaner_thread_.joinable())
     cleaner_thread_.join();
 
-  log_file_.close();
+  std::lock_guard lk(write_mutex_);
+  close_segment();
 }
 
 std::expected<void, WalError> WAL::flush() {
   std::lock_guard lk(write_mutex_);
-  if (!log_file_.sync())
+  if (!log_file_.sync_data())
     return std::unexpected(WalError::kSyncFailed);
+  if (!write_segment_header())
+    return std::unexpected(WalError::kIOError);
   return {};
 }
 
@@ -69,201 +291,334 @@ void WAL::set_checkpoint_tranc_id(uint64_t id) noexcept {
   checkpoint_tranc_id_ = id;
 }
 
-std::expected<void, WalError> WAL::log(const WalEntry& entry) {
-  if constexpr (Global_::WAL_WRITE_POLICY == Global_::WalWritePolicy::kPipelined) {
-    return log_pipelined(entry);
-  } else {
-    return log_unordered(entry);
+std::expected<void, WalError> WAL::log(const WalEntryRef& entry, bool sync) {
+  return log_batch(std::span{&entry, 1}, sync);
+}
+
+std::expected<void, WalError> WAL::log_batch(std::span<const WalEntry> entries, bool sync) {
+  const std::vector<WalEntryRef> refs(entries.begin(), entries.end());
+  return log_batch(std::span{refs}, sync);
 }
+
+// ─── log_async ────────────────────────────────────────────────────────────────
+//
+//  Producers never take write_mutex_: they push into async_ring_ and bump
+//  async_pushed_.  The writer thread pops everything that is there, hands it
+//  to write_group as one group and sleeps on async_pushed_ when the ring is
+//  empty.  notify_one is cheap while the writer is busy – it only enters the
+//  kernel when the writer is actually waiting.
+
+std::future<std::expected<void, WalError>> WAL::log_async(std::vector<WalEntry> entries,
+                                                          bool                  sync) {
+  auto req = std::make_unique<AsyncWrite>();
+  req->entries = std::move(entries);
+  req->refs.assign(req->entries.begin(), req->entries.end());
+  req->sync = sync;
+  auto fut  = req->done.get_future();
+  if (req->entries.empty()) {
+    req->done.set_value({});
+    return fut;
+  }
+  while (!async_ring_.try_push(req))
+    std::this_thread::yield();  // ring full: the writer is behind
+  async_pushed_.fetch_add(1, std::memory_order_release);
+  async_pushed_.notify_one();
+  return fut;
 }
+
+void WAL::async_writer() {
+  std::vector<std::unique_ptr<AsyncWrite>> batch;
+  std::vector<Writer>                      writers;
+  std::vector<Writer*>                     group;
+  for (;;) {
+    // Read before draining: a push that lands after the drain changes it, so
+    // the wait below returns at once instead of missing the entry.
+    const uint64_t              seen = async_pushed_.load(std::memory_order_acquire);
+    std::unique_ptr<AsyncWrite> req;
+    while (batch.size() < async_ring_.capacity() && async_ring_.try_pop(req))
+      batch.push_back(std::move(req));
+
+    if (batch.empty()) {
+      if (stop_async_.load(std::memory_order_acquire))
+        return;
+      async_pushed_.wait(seen, std::memory_order_acquire);
+      continue;
+    }
+
+    for (auto& b : batch)
+      writers.push_back(Writer{.entries = b->refs, .sync = b->sync});
+    for (auto& w : writers)
+      group.push_back(&w);
+    std::expected<void, WalError> res;
+    {
+      std::lock_guard lk(write_mutex_);
+      res = write_group(std::span{group});
+    }
+    for (auto& b : batch)
+      b->done.set_value(res);
+    batch.clear();
+    writers.clear();
+    group.clear();
+  }
+}
+
 // ─── log_batch ────────────────────────────────────────────────────────────────
 //
-//  Writes every entry in `entries` to the WAL and issues exactly one fsync,
-//  regardless of WAL_WRITE_POLICY.  Holding write_mutex_ for the full batch
-//  provides atomic durability: either all entries are fsynced or the call
-//  returns an error.
+//  Sync writes always take the write-group path so that concurrent sync
+//  writers share one fsync; buffered writes follow WAL_WRITE_POLICY.
 //
 //  Design notes:
-//  • Bypassing pipelining is intentional – a batch is already a "group write"
-//    and grouping groups adds no benefit.
-//  • Concurrent single log() calls in kPipelined mode will queue behind this
-//    batch's write_mutex_ hold, which is correct behaviour.
+//  • Either way the entries of one call are appended back to back under a
+//    single write_mutex_ hold, so a batch is never interleaved with others.
+//  • A buffered write that returned before a sync write started is covered by
+//    that sync write's fsync as well – it is the same file.
 //  • On error, entries already written to the kernel buffer are NOT rolled
 //    back.  Callers must treat a WAL write failure as fatal and stop accepting
 //    new writes.
 
-std::expected<void, WalError> WAL::log_batch(std::span<const WalEntry> entries) {
+std::expected<void, WalError> WAL::log_batch(std::span<const WalEntryRef> entries, bool sync) {
   if (entries.empty()) return {};
+  Writer w{.entries = entries, .sync = sync};
+  return submit(w);
+}
 
-  std::lock_guard lk(write_mutex_);
-
-  for (const auto& e : entries) {
-    if (auto r = write_entry_blocks(e); !r)
-      return r;
-  }
-
-  if (log_file_.size() > file_size_limit_) {
-    // Rolling the file here keeps each WAL segment bounded; the cleaner will
-    // eventually remove segments whose entries are all checkpointed.
-    reset_file();
-    // reset_file() does its own fsync on the old file before rotating.
+std::expected<void, WalError> WAL::log_batch(std::span<const WalEntryRef> entries, bool sync,
+                                             std::atomic<uint64_t>& next_tranc_id,
+                                             uint64_t&              tranc_id) {
+  if (entries.empty()) {
+    tranc_id = next_tranc_id.fetch_add(1, std::memory_order_relaxed);
     return {};
   }
-
-  if (!log_file_.sync())
-    return std::unexpected(WalError::kSyncFailed);
-
-  return {};
+  Writer w{.entries = entries, .sync = sync, .next_tranc_id = &next_tranc_id};
+  const auto res = submit(w);
+  tranc_id       = w.tranc_id;
+  return res;
 }
 
-// Each caller independently serialises through write_mutex_.
-// No grouping; lock is held only for one entry's write + fsync.
-
-std::expected<void, WalError> WAL::log_unordered(const WalEntry& entry) {
+std::expected<void, WalError> WAL::submit(Writer& w) {
+  if (w.sync || Global_::WAL_WRITE_POLICY == Global_::WalWritePolicy::kPipelined)
+    return log_pipelined(w);
+  // kUnordered: each caller independently serialises through write_mutex_,
+  // holding it only for its own entries; no grouping and no fsync.
   std::lock_guard lk(write_mutex_);
-  if (auto r = write_entry_blocks(entry); !r)
-    return r;
-  if (log_file_.size() > file_size_limit_)
-    reset_file();
- if constexpr (Global_::WAL_SYNC_ON_WRITE) {
-    if (!log_file_.sync())
-      return std::unexpected(WalError::kSyncFailed);
-  }
-  return {};
+  Writer*         self = &w;
+  return write_group(std::span{&self, 1});
 }
 
-std::expected<void, WalError> WAL::log_pipelined(const WalEntry& entry) {
-  Writer w{.entry = entry};
-
+std::expected<void, WalError> WAL::log_pipelined(Writer& w) {
   {
     std::lock_guard qlk(queue_mutex_);
     writer_queue_.push_back(&w);
   }
 
-  if (std::unique_lock wlk(write_mutex_, std::try_to_lock); wlk.owns_lock()) {
-    // ── Leader: drain queue and write the whole batch ─────────────────────
-    std::vector<Writer*> group;
-    {
-      std::lock_guard qlk(queue_mutex_);
-      group.assign(writer_queue_.begin(), writer_queue_.end());
-      writer_queue_.clear();
-    }
-
-    const auto res = write_group(std::span{group});
+  // Whoever gets write_mutex_ first is the leader.  A follower wakes up once
+  // the group that contains it is finished and finds itself done; a writer
+  // that enqueued after the previous leader drained the queue finds itself
+  // still pending and leads the next group.
+  std::lock_guard wlk(write_mutex_);
+  if (w.done)
+    return w.result;
 
-    // Signal every member *before* releasing write_mutex_ so that no
-    // member can observe a partially-written group.
-    for (auto* gw : group) {
-        std::lock_guard glk(gw->mu);
-        gw->result = res;
-        gw->done   = true;
-      gw->cv.notify_one();
-    }
-    // wlk destroyed here → write_mutex_ released → next leader unblocks.
+  std::vector<Writer*> group;
+  {
+    std::lock_guard qlk(queue_mutex_);
+    group.assign(writer_queue_.begin(), writer_queue_.end());
+    writer_queue_.clear();
   }
 
-  // Both leader and followers converge here and wait on their own cv.
-  // The leader's Writer was already signalled above, so it returns immediately.
-  std::unique_lock lk(w.mu);
-  w.cv.wait(lk, [&w] { return w.done; });
+  const auto res = write_group(std::span{group});
+
+  // Published under write_mutex_, which every follower takes before reading.
+  for (auto* gw : group) {
+    gw->result = res;
+    gw->done   = true;
+  }
   return w.result;
 }
 
 // ─── write_group ─────────────────────────────────────────────────────────────
 
+void WAL::assign_tranc_ids(std::span<Writer*> group) {
+  for (size_t i = 0; i < group.size(); ++i) {
+    auto* const ids = group[i]->next_tranc_id;
+    if (ids == nullptr || group[i]->tranc_id != 0)
+      continue;  // caller's own ids, or already done with an earlier allocator
+    const auto same = [ids](const Writer* w) { return w->next_tranc_id == ids; };
+    uint64_t   id   = ids->fetch_add(std::ranges::count_if(group.subspan(i), same),
+                                     std::memory_order_relaxed);
+    for (auto* w : group.subspan(i) | std::views::filter(same))
+      w->tranc_id = id++;
+  }
+}
+
 std::expected<void, WalError> WAL::write_group(std::span<Writer*> group) {
+  assign_tranc_ids(group);
+  bool need_sync = false;
   for (auto* w : group) {
-    if (auto r = write_entry_blocks(w->entry); !r)
-      return r;
+    for (const auto& e : w->entries) {
+      if (w->next_tranc_id)
+        write_entry_blocks(WalEntryRef{e.key, e.value, w->tranc_id});
+      else
+        write_entry_blocks(e);
+    }
+    need_sync |= w->sync;
   }
-  if (log_file_.size() > file_size_limit_) {
-    reset_file();
-    return {};
+  if (auto r = flush_write_buf(); !r)
+    return r;
+  if (write_offset_ >= file_size_limit_) {
+    // reset_file() syncs the old segment before rotating.
+    return reset_file();
   }
-  // ── 与 log_unordered 保持一致 ────────────────────────────────────────────
-  if constexpr (Global_::WAL_SYNC_ON_WRITE) {
-    if (!log_file_.sync())
+  // One fdatasync for every sync writer in the group.  The segment never
+  // grows, so it writes no metadata.  The header update afterwards is made
+  // durable by the next sync.
+  if (need_sync) {
+    if (!log_file_.sync_data())
       return std::unexpected(WalError::kSyncFailed);
+    if (!write_segment_header())
+      return std::unexpected(WalError::kIOError);
   }
   return {};
 }
 
-std::expected<void, WalError> WAL::write_entry_blocks(const WalEntry& entry) {
-  const auto               payload = encode_payload(entry);
-  std::span<const uint8_t> remaining{payload};
-  bool                     is_first = true;
+// ─── Record encoding ─────────────────────────────────────────────────────────
+
+// The payload of one entry (see WalEntry) as five pieces – the two length
+// prefixes, key, value and tranc_id – copied out one fragment at a time, so
+// key and value go from the caller's memory straight into the block buffer.
+class WAL::PayloadCursor {
+ public:
+  explicit PayloadCursor(const WalEntryRef& e) {
+    Global_::write_le(key_len_.data(), static_cast<uint32_t>(e.key.size()));
+    Global_::write_le(value_len_.data(), static_cast<uint32_t>(e.value.size()));
+    Global_::write_le(tranc_id_.data(), e.tranc_id);
+    pieces_ = {std::span<const uint8_t>{key_len_}, as_bytes(e.key),
+               std::span<const uint8_t>{value_len_}, as_bytes(e.value),
+               std::span<const uint8_t>{tranc_id_}};
+    remaining_ = 4 + e.key.size() + 4 + e.value.size() + 8;
+  }
 
-  while (!remaining.empty()) {
-    size_t avail = kBlockSize - block_offset_;
+  // An already serialised payload.
+  explicit PayloadCursor(std::span<const uint8_t> payload)
+      : pieces_{payload}, remaining_(payload.size()) {}
+
+  size_t remaining() const { return remaining_; }
+
+  void copy_to(uint8_t* dst, size_t n) {
+    remaining_ -= n;
+    while (n > 0) {
+      auto&        piece = pieces_[piece_];
+      const size_t take  = std::min(n, piece.size());
+      std::memcpy(dst, piece.data(), take);
+      dst += take;
+      n -= take;
+      piece = piece.subspan(take);
+      if (piece.empty())
+        ++piece_;
+    }
+  }
+
+ private:
+  static std::span<const uint8_t> as_bytes(std::string_view s) {
+    return {reinterpret_cast<const uint8_t*>(s.data()), s.size()};
+  }
+
+  std::array<uint8_t, 4>                  key_len_{};
+  std::array<uint8_t, 4>                  value_len_{};
+  std::array<uint8_t, 8>                  tranc_id_{};
+  std::array<std::span<const uint8_t>, 5> pieces_;
+  size_t                                  piece_{0};
+  size_t                                  remaining_;
+};
+
+void WAL::write_entry_blocks(const WalEntryRef& entry) {
+  min_tranc_id_ = std::min(min_tranc_id_, entry.tranc_id);
+  max_tranc_id_ = std::max(max_tranc_id_, entry.tranc_id);
+
+  PayloadCursor payload(entry);
+  const uint8_t flags = compress_payload(payload) ? kRecCompressed : 0;
+  bool          is_first = true;
+  do {
+    size_t avail = kBlockSize - write_offset_ % kBlockSize;
 
     if (avail < kHeaderSize) {
-      // Pad the tail of the current block with zeros so that recovery
-      // can unambiguously detect block boundaries.
-      std::vector<uint8_t> pad(avail, kRecZero);
-      if (!log_file_.append(pad))
-        return std::unexpected(WalError::kIOError);
-      block_offset_ = 0;
-      avail         = kBlockSize;
+      // Recovery never looks at a tail this short; zero it so the block
+      // goes out whole.
+      std::memset(block_at(write_offset_), 0, avail);
+      write_offset_ += avail;
+      avail = kBlockSize;
     }
 
-    const size_t data_avail = avail - kHeaderSize;
-    const size_t chunk_len  = std::min(data_avail, remaining.size());
-    const bool   is_last    = (chunk_len == remaining.size());
+    const size_t chunk_len = std::min(avail - kHeaderSize, payload.remaining());
+    const bool   is_last   = (chunk_len == payload.remaining());
 
     const uint8_t type = (is_first && is_last) ? kRecFull
                          : is_first            ? kRecFirst
                          : is_last             ? kRecLast
                                                : kRecMiddle;
 
-    if (auto r = write_physical_record(remaining.subspan(0, chunk_len), type); !r)
-      return r;
+    // A record never crosses a block, so it is contiguous in one buffer.
+    uint8_t* rec = block_at(write_offset_);
+    Global_::write_le(rec + 4, static_cast<uint16_t>(chunk_len));
+    rec[6] = type | flags;
+    Global_::write_le(rec + 7, static_cast<uint32_t>(log_number_));
+    payload.copy_to(rec + kHeaderSize, chunk_len);
+    // CRC-32C covers [type || log_number || data]
+    Global_::write_le(rec, Global_::mask_crc(Global_::crc32c(
+                               std::span<const uint8_t>{rec + 6, 5 + chunk_len})));
+
+    write_offset_ += kHeaderSize + chunk_len;
+    is_first = false;
+  } while (payload.remaining() > 0);
+}
 
-    remaining = remaining.subspan(chunk_len);
-    is_first  = false;
+bool WAL::compress_payload(PayloadCursor& payload) {
+  const size_t raw_size = payload.remaining();
+  if (compression_ != Global_::WalCompression::kLz || raw_size < Global_::WAL_COMPRESS_MIN_BYTES)
+    return false;
+  raw_scratch_.resize(raw_size);
+  payload.copy_to(raw_scratch_.data(), raw_size);
+  lz_scratch_.clear();
+  Global_::write_le(lz_scratch_, static_cast<uint32_t>(raw_size));
+  lz_.compress(std::span<const uint8_t>{raw_scratch_}, lz_scratch_);
+  // Not worth a decompression on recovery unless it saves an eighth.  A raw
+  // entry stays out of the history, exactly as on the read side.
+  if (lz_scratch_.size() > raw_size - raw_size / 8) {
+    payload = PayloadCursor(std::span<const uint8_t>{raw_scratch_});
+    return false;
   }
-  return {};
+  lz_.commit();
+  payload = PayloadCursor(std::span<const uint8_t>{lz_scratch_});
+  return true;
 }
 
-std::expected<void, WalError> WAL::write_physical_record(std::span<const uint8_t> data,
-                                                         uint8_t                  type) {
-  // CRC-32C covers [type || data]
-  std::vector<uint8_t> crc_input;
-  crc_input.reserve(1 + data.size());
-  crc_input.push_back(type);
-  crc_input.insert(crc_input.end(), data.begin(), data.end());
-
-  const uint32_t crc = Global_::mask_crc(Global_::crc32c(std::span{crc_input}));
-  const uint16_t len = static_cast<uint16_t>(data.size());
-
-  std::vector<uint8_t> record;
-  record.reserve(kHeaderSize + data.size());
-  Global_::write_le(record, crc);
-  Global_::write_le(record, len);
-  record.push_back(type);
-  record.insert(record.end(), data.begin(), data.end());
+uint8_t* WAL::block_at(size_t offset) {
+  const size_t index = offset / kBlockSize - pending_start_ / kBlockSize;
+  while (block_pool_.size() <= index)
+    block_pool_.push_back(std::make_unique_for_overwrite<uint8_t[]>(kBlockSize));
+  return block_pool_[index].get() + offset % kBlockSize;
+}
 
-  if (!log_file_.append(record))
+std::expected<void, WalError> WAL::flush_write_buf() {
+  if (write_offset_ == pending_start_)
+    return {};
+  iov_.clear();
+  for (size_t pos = pending_start_; pos < write_offset_;) {
+    const size_t block_end = std::min(write_offset_, (pos / kBlockSize + 1) * kBlockSize);
+    iov_.emplace_back(block_at(pos), block_end - pos);
+    pos = block_end;
+  }
+  const bool ok  = log_file_.writev(pending_start_, iov_);
+  pending_start_ = write_offset_;
+  // Don't pin the buffers of one huge group for the rest of the segment.
+  if (block_pool_.size() > kMaxRetainedBlocks)
+    block_pool_.resize(kMaxRetainedBlocks);
+  if (!ok)
     return std::unexpected(WalError::kIOError);
-
-  block_offset_ += kHeaderSize + data.size();
-  if (block_offset_ == kBlockSize)
-    block_offset_ = 0;
-
   return {};
 }
 
-// ─── encode_payload / decode_payload ─────────────────────────────────────────
-
-std::vector<uint8_t> WAL::encode_payload(const WalEntry& e) {
-  std::vector<uint8_t> buf;
-  buf.reserve(4 + e.key.size() + 4 + e.value.size() + 8);
-  Global_::write_le<uint32_t>(buf, static_cast<uint32_t>(e.key.size()));
-  buf.insert(buf.end(), e.key.begin(), e.key.end());
-  Global_::write_le<uint32_t>(buf, static_cast<uint32_t>(e.value.size()));
-  buf.insert(buf.end(), e.value.begin(), e.value.end());
-  Global_::write_le<uint64_t>(buf, e.tranc_id);
-  return buf;
-}
+// ─── decode_payload ──────────────────────────────────────────────────────────
 
 std::expected<WalEntry, WalError> WAL::decode_payload(std::span<const uint8_t> raw) {
   // Minimum: key_len(4) + value_len(4) + tranc_id(8) = 16 bytes
@@ -295,194 +650,201 @@ std::expected<WalEntry, WalError> WAL::decode_payload(std::span<const uint8_t> r
   return WalEntry{std::move(key), std::move(value), tranc_id};
 }
 
-// ─── recover ─────────────────────────────────────────────────────────────────
+// ─── replay / recover ────────────────────────────────────────────────────────
 //
-//  Reads all wal.N files in ascending sequence order.
-//  Stops (not errors) on a truncated record – this is the expected last-write
-//  scenario.  Returns kChecksumMismatch on a header-complete but corrupt
-//  record to allow the caller to make a recovery-mode decision (analogous to
-//  RocksDB issue #6963).
-
-std::expected<std::map<uint64_t, std::vector<WalEntry>>, WalError> WAL::recover(
-    std::string_view log_dir, uint64_t checkpoint_tranc_id) {
+//  Each worker claims the next wal.N segment (ascending log number), reads it
+//  in kReadSize chunks up to its logical end (see read_segment) and hands the
+//  decoded entries straight to apply.  A bad record inside the range a
+//  segment header vouches for yields kChecksumMismatch / kCorrupted so the
+//  caller can make a recovery-mode decision (analogous to RocksDB issue
+//  #6963).
+
+std::expected<size_t, WalError> WAL::replay(std::string_view log_dir,
+                                            uint64_t checkpoint_tranc_id, const ReplayFn& apply,
+                                            size_t threads) {
   namespace fs = std::filesystem;
-
-  std::map<uint64_t, std::vector<WalEntry>> result;
   if (!fs::exists(log_dir))
-    return result;
-
-  // Collect and sort by sequence number
-  std::vector<std::pair<uint64_t, std::string>> wal_files;
-  for (const auto& de : fs::directory_iterator(log_dir)) {
-    if (!de.is_regular_file())
-      continue;
-    const auto name = de.path().filename().string();
-    if (!name.starts_with("wal."))
-      continue;
-    try {
-      wal_files.emplace_back(std::stoull(name.substr(4)), de.path().string());
-    } catch (...) {
-    }
-  }
-  std::ranges::sort(wal_files);
-
-  for (const auto& [unused_sq, path] : wal_files) {
-    auto                 file      = FileObj::open(path, false);
-    size_t               file_size = file.size();
-    size_t               offset    = 0;
-    std::vector<uint8_t> scratch;  // accumulates record fragments
-
-    while (offset < file_size) {
-      // Skip block-tail padding (< kHeaderSize bytes left in this block)
-      const size_t block_off = offset % kBlockSize;
-      if (kBlockSize - block_off < kHeaderSize) {
-        offset += kBlockSize - block_off;
-        continue;
-      }
-      if (offset + kHeaderSize > file_size)
-        break;  // truncated header → stop
-
-      const uint32_t stored_crc = Global_::mask_crc(file.read_uint32(offset));
-      const uint16_t rec_len    = file.read_uint16(offset + 4);
-      const uint8_t  rec_type   = file.read_uint8(offset + 6);
-
-      if (offset + kHeaderSize + rec_len > file_size) {
-        // Partial data – clean truncation.  Per #12488 we stop here
-        // rather than silently accepting a zero-length tail.
-        break;
-      }
-
-      // Verify checksum
-      auto                 data = file.read_to_slice(offset + kHeaderSize, rec_len);
-      std::vector<uint8_t> check;
-      check.reserve(1 + rec_len);
-      check.push_back(rec_type);
-      check.insert(check.end(), data.begin(), data.end());
-      if (Global_::crc32c(std::span{check}) != stored_crc)
-        return std::unexpected(WalError::kChecksumMismatch);
-
-      offset += kHeaderSize + rec_len;
-
-      bool complete = false;
-      switch (rec_type) {
-        case kRecZero:
-          // Padding – skip the rest of the block
-          offset += kBlockSize - (offset % kBlockSize);
+    return 0;
+
+  const auto segments = list_segments(std::string(log_dir), kSegmentPrefix);
+  std::vector<std::optional<WalError>> errors(segments.size());
+  std::atomic_size_t                   next{0};
+  std::atomic_size_t                   applied{0};
+  std::atomic_bool                     failed{false};
+
+  auto worker = [&] {
+    while (!failed.load(std::memory_order_relaxed)) {
+      const size_t i = next.fetch_add(1, std::memory_order_relaxed);
+      if (i >= segments.size())
+        return;
+      const auto& [log_number, path] = segments[i];
+      std::expected<void, WalError> read;
+      try {
+        auto file = FileObj::open(path, false);
+        if (auto h = read_segment_header(file);
+            h && h->sealed && h->log_number == log_number && h->max_tranc_id <= checkpoint_tranc_id)
           continue;
-        case kRecFull:
-          scratch  = std::move(data);
-          complete = true;
-          break;
-        case kRecFirst:
-          scratch = std::move(data);
-          break;
-        case kRecMiddle:
-          scratch.insert(scratch.end(), data.begin(), data.end());
-          break;
-        case kRecLast:
-          scratch.insert(scratch.end(), data.begin(), data.end());
-          complete = true;
-          break;
-        default:
-          return std::unexpected(WalError::kCorrupted);
+        read = read_segment(
+            file, log_number,
+            [&](std::span<const uint8_t> payload) -> std::expected<void, WalError> {
+              auto entry = decode_payload(payload);
+              if (!entry)
+                return std::unexpected(entry.error());
+              if (entry->tranc_id > checkpoint_tranc_id) {
+                apply(std::move(*entry));
+                applied.fetch_add(1, std::memory_order_relaxed);
+              }
+              return {};
+            });
+      } catch (const std::exception&) {
+        read = std::unexpected(WalError::kIOError);
       }
-
-      if (complete) {
-        auto entry_res = decode_payload(std::span{scratch});
-        if (!entry_res)
-          return std::unexpected(entry_res.error());
-        auto& e = *entry_res;
-        if (e.tranc_id > checkpoint_tranc_id)
-          result[e.tranc_id].push_back(std::move(e));
-        scratch.clear();
+      if (!read) {
+        errors[i] = read.error();
+        failed.store(true, std::memory_order_relaxed);
       }
     }
+  };
+
+  const size_t             workers = std::min(std::max<size_t>(threads, 1), segments.size());
+  std::vector<std::thread> pool;
+  for (size_t t = 1; t < workers; ++t)
+    pool.emplace_back(worker);
+  worker();
+  for (auto& t : pool)
+    t.join();
+
+  for (const auto& e : errors) {
+    if (e)
+      return std::unexpected(*e);
   }
+  return applied.load();
+}
+
+std::expected<std::map<uint64_t, std::vector<WalEntry>>, WalError> WAL::recover(
+    std::string_view log_dir, uint64_t checkpoint_tranc_id) {
+  std::map<uint64_t, std::vector<WalEntry>> result;
+  std::mutex                                result_mutex;
+  auto replayed = replay(log_dir, checkpoint_tranc_id, [&](WalEntry&& e) {
+    std::lock_guard lk(result_mutex);
+    result[e.tranc_id].push_back(std::move(e));
+  });
+  if (!replayed)
+    return std::unexpected(replayed.error());
   return result;
 }
 
 // ─── scan_tranc_ids (cleaner helper) ─────────────────────────────────────────
-// Light version of recover: no CRC check, just collects all tranc_ids.
+// Light version of recover: collects all tranc_ids without decoding entries.
 
-std::vector<uint64_t> WAL::scan_tranc_ids(FileObj& file) noexcept {
+std::vector<uint64_t> WAL::scan_tranc_ids(FileObj& file, uint64_t log_number) noexcept {
   std::vector<uint64_t> ids;
-  const size_t          file_size = file.size();
-  size_t                offset    = 0;
-  std::vector<uint8_t>  scratch;
-
   try {
-    while (offset < file_size) {
-      const size_t block_off = offset % kBlockSize;
-      if (kBlockSize - block_off < kHeaderSize) {
-        offset += kBlockSize - block_off;
-        continue;
-      }
-      if (offset + kHeaderSize > file_size)
-        break;
+    auto read = read_segment(
+        file, log_number, [&](std::span<const uint8_t> raw) -> std::expected<void, WalError> {
+          if (raw.size() < 16)
+            return {};
+          const auto   key_len = Global_::read_le<uint32_t>(raw, 0);
+          const size_t val_off = 4 + key_len + 4;
+          if (val_off <= raw.size()) {
+            const auto   val_len = Global_::read_le<uint32_t>(raw, 4 + key_len);
+            const size_t tid_off = val_off + val_len;
+            if (tid_off + 8 <= raw.size())
+              ids.push_back(Global_::read_le<uint64_t>(raw, tid_off));
+          }
+          return {};
+        });
+    (void)read;  // a damaged segment just yields fewer ids
+  } catch (...) {
+  }  // tolerate I/O errors during cleanup
 
-      const uint16_t rec_len  = file.read_uint16(offset + 4);
-      const uint8_t  rec_type = file.read_uint8(offset + 6);
+  return ids;
+}
 
-      if (offset + kHeaderSize + rec_len > file_size)
-        break;
+// ─── Segment management ──────────────────────────────────────────────────────
 
-      auto data = file.read_to_slice(offset + kHeaderSize, rec_len);
-      offset += kHeaderSize + rec_len;
+bool WAL::write_segment_header(bool sealed) {
+  auto header =
+      encode_segment_header({log_number_, write_offset_, min_tranc_id_, max_tranc_id_, sealed});
+  return log_file_.write(0, header);
+}
 
-      bool complete = false;
-      switch (rec_type) {
-        case kRecZero:
-          offset += kBlockSize - (offset % kBlockSize);
-          continue;
-        case kRecFull:
-          scratch  = std::move(data);
-          complete = true;
-          break;
-        case kRecFirst:
-          scratch = std::move(data);
-          break;
-        case kRecMiddle:
-          scratch.insert(scratch.end(), data.begin(), data.end());
-          break;
-        case kRecLast:
-          scratch.insert(scratch.end(), data.begin(), data.end());
-          complete = true;
-          break;
-        default:
-          scratch.clear();
-          break;
-      }
+std::expected<void, WalError> WAL::open_segment() {
+  ++log_number_;
+  active_log_path_ = log_dir_ + "/" + std::string(kSegmentPrefix) + std::to_string(log_number_);
+  write_offset_    = kDataStart;
+  pending_start_   = kDataStart;
+  min_tranc_id_    = UINT64_MAX;
+  max_tranc_id_    = 0;
+  lz_.reset();  // compressed payloads never refer across segments
 
-      if (complete && scratch.size() >= 16) {
-        const auto   key_len = Global_::read_le<uint32_t>(std::span{scratch}, 0);
-        const size_t val_off = 4 + key_len + 4;
-        if (val_off <= scratch.size()) {
-          const auto   val_len = Global_::read_le<uint32_t>(std::span{scratch}, 4 + key_len);
-          const size_t tid_off = val_off + val_len;
-          if (tid_off + 8 <= scratch.size())
-            ids.push_back(Global_::read_le<uint64_t>(std::span{scratch}, tid_off));
-        }
-        scratch.clear();
-      }
+  std::string recycled;
+  {
+    std::lock_guard lk(recycle_mutex_);
+    if (!recycled_.empty()) {
+      recycled = std::move(recycled_.back());
+      recycled_.pop_back();
     }
-  } catch (...) {
-  }  // tolerate I/O errors during cleanup
+  }
+  // Sync writes are acknowledged after fdatasync alone, so the segment's
+  // directory entry must be durable before it takes any: otherwise a crash
+  // could leave acknowledged records under a name replay never looks at.
+  if (!recycled.empty()) {
+    // Already allocated; its old records carry another log number and end
+    // the log as soon as recovery reaches them.
+    log_file_ = FileObj::open(recycled, /*create=*/false);
+    if (log_file_.rename(active_log_path_) && write_segment_header() && log_file_.sync_data() &&
+        FileObj::sync_dir(log_dir_))
+      return {};
+    log_file_.close();
+  }
 
-  return ids;
+  log_file_ = FileObj::open(active_log_path_, /*create=*/true);
+  // Full fsync once, so the allocated size is on disk before any fdatasync.
+  if (!log_file_.allocate(file_size_limit_) || !write_segment_header() || !log_file_.sync() ||
+      !FileObj::sync_dir(log_dir_)) {
+    spdlog::error("WAL: failed to preallocate segment {}", active_log_path_);
+    // Later writes fail on the closed file instead of landing in a segment
+    // that may not survive a crash.
+    log_file_.close();
+    return std::unexpected(WalError::kFileCreateFailed);
+  }
+  return {};
 }
 
-// ─── reset_file ──────────────────────────────────────────────────────────────
+void WAL::close_segment() {
+  if (!log_file_.is_open())
+    return;
+  // Make the segment durable, then its final logical end and tranc_id range.
+  log_file_.sync_data();
+  if (write_segment_header(/*sealed=*/true) && log_file_.sync_data()) {
+    std::lock_guard lk(sealed_mutex_);
+    sealed_max_[log_number_] = max_tranc_id_;
+  }
+  log_file_.close();
+}
 
-void WAL::reset_file() {
-  if (log_file_.is_open()) {
-    log_file_.sync();  // 确保数据持久化
-    log_file_.close();
+std::expected<void, WalError> WAL::reset_file() {
+  close_segment();
+  return open_segment();
+}
+
+uint64_t WAL::segment_max_tranc_id(uint64_t log_number, const std::string& path) {
+  {
+    std::lock_guard lk(sealed_mutex_);
+    if (auto it = sealed_max_.find(log_number); it != sealed_max_.end())
+      return it->second;
+  }
+  auto file = FileObj::open(path, false);
+  if (auto h = read_segment_header(file); h && h->sealed && h->log_number == log_number) {
+    std::lock_guard lk(sealed_mutex_);
+    sealed_max_[log_number] = h->max_tranc_id;
+    return h->max_tranc_id;
   }
-  const auto dot   = active_log_path_.find_last_of('.');
-  const auto seq   = std::stoul(active_log_path_.substr(dot + 1)) + 1;
-  active_log_path_ = active_log_path_.substr(0, dot + 1) + std::to_string(seq);
-  log_file_        = FileObj::create_and_write(active_log_path_, {});
-  block_offset_    = 0;
+  // Left unsealed by a crash: records past the last header update may carry
+  // higher ids, so only the records themselves can tell.
+  const auto ids = scan_tranc_ids(file, log_number);
+  return ids.empty() ? 0 : std::ranges::max(ids);
 }
 
 // ─── cleaner thread ───────────────────────────────────────────────────────────
@@ -500,14 +862,10 @@ void WAL::cleaner() {
 }
 
 void WAL::cleanWALFile() {
-  namespace fs = std::filesystem;
-
-  // Capture active path and checkpoint under their respective locks.
-  std::string dir_path;
+  uint64_t active;
   {
     std::lock_guard wlk(write_mutex_);
-    const auto      slash = active_log_path_.find_last_of('/');
-    dir_path = (slash != std::string::npos) ? active_log_path_.substr(0, slash + 1) : "./";
+    active = log_number_;
   }
   uint64_t cp;
   {
@@ -515,33 +873,27 @@ void WAL::cleanWALFile() {
     cp = checkpoint_tranc_id_;
   }
 
-  std::vector<std::pair<uint64_t, std::string>> wal_files;
-  for (const auto& de : fs::directory_iterator(dir_path)) {
-    if (!de.is_regular_file())
+  for (const auto& [log_number, path] : list_segments(log_dir_, kSegmentPrefix)) {
+    // Never touch the active segment (or one opened after we looked).
+    if (log_number >= active)
       continue;
-    const auto name = de.path().filename().string();
-    if (!name.starts_with("wal."))
+    // Retire only when every recorded tranc_id has been checkpointed.
+    if (segment_max_tranc_id(log_number, path) > cp)
       continue;
-    try {
-      wal_files.emplace_back(std::stoull(name.substr(4)), de.path().string());
-    } catch (...) {
+    {
+      std::lock_guard lk(sealed_mutex_);
+      sealed_max_.erase(log_number);
     }
-  }
-  std::ranges::sort(wal_files);
-
-  // Never touch the last (active) file.
-  if (wal_files.size() <= 1)
-    return;
 
-  for (auto& it : wal_files) {
-    auto       file = FileObj::open(it.second, false);
-    const auto ids  = scan_tranc_ids(file);
-
-    // Safe to delete only when every recorded tranc_id has been checkpointed.
-    const bool all_committed =
-        !ids.empty() && std::ranges::all_of(ids, [cp](uint64_t id) { return id <= cp; });
-
-    if (all_committed)
-      file.del_file();
+    auto            file = FileObj::open(path, false);
+    std::lock_guard lk(recycle_mutex_);
+    if (recycled_.size() < Global_::WAL_RECYCLE_SEGMENTS) {
+      const auto target = log_dir_ + "/" + std::string(kRecyclePrefix) + std::to_string(log_number);
+      if (file.rename(target)) {
+        recycled_.push_back(target);
+        continue;
+      }
+    }
+    file.del_file();
   }
-}
\ No newline at end of file
+}
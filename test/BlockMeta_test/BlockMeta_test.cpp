@@ -1,7 +1,9 @@
 #include "../../include/core/memtable.h"
 #include "../../include/storage/Sstable.h"
 #include <gtest/gtest.h>
+#include <cstring>
 #include <memory>
+#include <span>
 #include <string>
 
 class BlockMetaTest : public ::testing::Test {
@@ -101,6 +103,31 @@ TEST_F(BlockMetaTest, EdgeCases) {
   EXPECT_EQ(decoded[0].offset_, 0);
 }
 
+// 格式版本为 0 的旧索引用 std::hash 校验, 新索引只认 crc32c
+TEST_F(BlockMetaTest, LegacyFormatChecksum) {
+  std::vector<BlockMeta> test_metas = {BlockMeta("a", "b", 0), BlockMeta("c", "d", 4096)};
+  auto                   encoded    = BlockMeta::encode_meta_to_slice(test_metas);
+  EXPECT_EQ(encoded[sizeof(size_t) - 1], BlockMeta::kFormatCrc32c);
+
+  const std::span<const uint8_t> body(encoded.data() + sizeof(size_t),
+                                      encoded.size() - sizeof(size_t) - sizeof(uint32_t));
+  const uint32_t                 old_checksum = Global_::legacy_block_checksum(body);
+  auto                           legacy_hash  = encoded;
+  std::memcpy(legacy_hash.data() + legacy_hash.size() - sizeof(uint32_t), &old_checksum,
+              sizeof(old_checksum));
+  EXPECT_THROW(BlockMeta::decode_meta_from_slice(legacy_hash), std::runtime_error);
+
+  legacy_hash[sizeof(size_t) - 1] = BlockMeta::kFormatLegacy;
+  auto decoded                    = BlockMeta::decode_meta_from_slice(legacy_hash);
+  ASSERT_EQ(decoded.size(), 2u);
+  EXPECT_EQ(decoded[1].first_key_, "c");
+  EXPECT_EQ(decoded[1].offset_, 4096u);
+
+  auto legacy_crc                = encoded;
+  legacy_crc[sizeof(size_t) - 1] = BlockMeta::kFormatLegacy;
+  EXPECT_THROW(BlockMeta::decode_meta_from_slice(legacy_crc), std::runtime_error);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -1,9 +1,14 @@
 #include "../../include/storage/Block.h"
 #include "../../include/iterator/BlockIterator.h"
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <format>
 #include <memory>
+#include <span>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <tuple>
 
@@ -158,7 +163,7 @@ TEST_F(BlockTest, SizeLimit) {
 // 测试空块
 TEST_F(BlockTest, EmptyBlock) {
   EXPECT_TRUE(block->is_empty());
-  EXPECT_EQ(block->get_cur_size(), 2);
+  EXPECT_EQ(block->get_cur_size(), 7);  // 只有 trailer: num + restart_interval + version + marker
 }
 
 TEST_F(BlockTest, RangeSearch) {
@@ -283,6 +288,190 @@ TEST_F(BlockTest, RangeSearchandMVCC) {
   }
 }
 
+// 前缀压缩: 共享前缀的 key 编码后明显变小; 跨重启点的查找、多版本、遍历、前缀查询都正确
+TEST_F(BlockTest, PrefixCompression_ShrinksAndRoundTrips) {
+  auto big = std::make_shared<Block>(16384);
+  // (key, value, tranc_id), 同 key 的版本按新到旧排列
+  std::vector<std::tuple<std::string, std::string, uint64_t>> entries;
+  for (int user = 0; user < 40; user++) {
+    for (const char* field : {"email", "name", "phone"}) {
+      const auto key = std::format("user:{:06d}:{}", user, field);
+      if (user % 3 == 0) {
+        entries.emplace_back(key, "new", 200 + user);
+      }
+      entries.emplace_back(key, std::format("v{}", user), 100 + user);
+    }
+  }
+  size_t legacy_size = sizeof(uint16_t);  // 旧格式: 每条 key_len + key + value_len + value + tranc_id + offset
+  for (const auto& [key, value, tranc_id] : entries) {
+    ASSERT_TRUE(big->add_entry(key, value, tranc_id)) << key;
+    legacy_size += 2 + key.size() + 2 + value.size() + 8 + 2;
+  }
+  auto encoded = big->encode();
+  EXPECT_LT(encoded.size() * 10, legacy_size * 7) << encoded.size() << " vs " << legacy_size;
+
+  auto decoded = Block::decode(encoded);
+  ASSERT_NE(decoded, nullptr);
+  EXPECT_EQ(decoded->get_first_and_last_key(),
+            std::make_pair(std::string("user:000000:email"), std::string("user:000039:phone")));
+  for (const auto& [key, value, tranc_id] : entries) {
+    auto latest = decoded->get_value_binary(key);
+    ASSERT_TRUE(latest.has_value()) << key;
+    auto at = decoded->get_value_binary(key, tranc_id);
+    ASSERT_TRUE(at.has_value()) << key;
+    EXPECT_EQ(at->first, value) << key;
+    EXPECT_EQ(at->second, tranc_id) << key;
+  }
+  EXPECT_FALSE(decoded->get_value_binary("user:000003:name", 102).has_value());
+  EXPECT_FALSE(decoded->get_value_binary("user:000003:nam").has_value());
+  EXPECT_FALSE(decoded->get_value_binary("user:000040:email").has_value());
+
+  size_t i = 0;
+  for (auto it = decoded->begin(); it != decoded->end(); ++it, ++i) {
+    ASSERT_LT(i, entries.size());
+    EXPECT_EQ((*it).first, std::get<0>(entries[i]));
+    EXPECT_EQ(it.get_cur_tranc_id(), std::get<2>(entries[i]));
+  }
+  EXPECT_EQ(i, entries.size());
+  // user:00001x 共 10 个用户, 3 个字段, 其中 user 12、15、18 各字段多一个版本
+  EXPECT_EQ(decoded->get_prefix_tran_id("user:00001", UINT64_MAX).size(), 39u);
+  EXPECT_TRUE(decoded->get_prefix_tran_id("user:0001", UINT64_MAX).empty());
+}
+
+// 旧格式 block (完整 key + 偏移数组) 照样能读, 重新编码保持原格式
+TEST_F(BlockTest, LegacyFormat_StillReadable) {
+  std::vector<uint8_t>  bytes;
+  std::vector<uint16_t> offsets;
+  auto put = [&bytes](const void* p, size_t n) {
+    auto b = static_cast<const uint8_t*>(p);
+    bytes.insert(bytes.end(), b, b + n);
+  };
+  const std::vector<std::tuple<std::string, std::string, uint64_t>> entries = {
+      {"apple", "1", 7}, {"apricot", "2", 9}, {"apricot", "3", 5}, {"banana", "4", 1}};
+  for (const auto& [key, value, tranc_id] : entries) {
+    offsets.push_back(bytes.size());
+    const uint16_t key_len = key.size(), value_len = value.size();
+    put(&key_len, 2);
+    put(key.data(), key.size());
+    put(&value_len, 2);
+    put(value.data(), value.size());
+    put(&tranc_id, 8);
+  }
+  put(offsets.data(), offsets.size() * 2);
+  const uint16_t num = offsets.size();
+  put(&num, 2);
+  const uint32_t hash = std::hash<std::string_view>{}(
+      std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+  put(&hash, 4);
+
+  auto legacy = Block::decode(bytes);
+  ASSERT_NE(legacy, nullptr);
+  EXPECT_EQ(legacy->get_value_binary("apricot")->first, "2");
+  EXPECT_EQ(legacy->get_value_binary("apricot", 6)->first, "3");
+  EXPECT_EQ(legacy->get_value_binary("banana")->first, "4");
+  EXPECT_FALSE(legacy->get_value_binary("cherry").has_value());
+  EXPECT_EQ(legacy->get_prefix_tran_id("ap", UINT64_MAX).size(), 3u);
+  EXPECT_EQ(legacy->get_first_and_last_key(),
+            std::make_pair(std::string("apple"), std::string("banana")));
+  size_t n = 0;
+  for (auto it = legacy->begin(); it != legacy->end(); ++it) {
+    EXPECT_EQ((*it).first, std::get<0>(entries[n++]));
+  }
+  EXPECT_EQ(n, entries.size());
+  EXPECT_EQ(legacy->encode(), bytes);
+
+  // 旧格式只认旧校验和
+  auto crc = bytes;
+  const uint32_t masked = Global_::block_checksum(std::span(bytes.data(), bytes.size() - 4));
+  std::memcpy(crc.data() + crc.size() - 4, &masked, sizeof(masked));
+  EXPECT_THROW(Block::decode(crc), std::runtime_error);
+}
+
+// 带哈希索引的 block 点查结果与二分 (刚写入、还没有索引的 block) 完全一致,
+// 索引去掉后按前缀压缩格式也照样能读
+TEST_F(BlockTest, HashIndex_MatchesBinarySearch) {
+  auto built = std::make_shared<Block>(16384);
+  std::vector<std::tuple<std::string, uint64_t>> entries;
+  for (int i = 0; i < 300; i++) {
+    const auto key = std::format("k{:05d}", i * 3);
+    if (i % 4 == 0) {
+      ASSERT_TRUE(built->add_entry(key, "new", 500 + i));
+      entries.emplace_back(key, 500 + i);
+    }
+    ASSERT_TRUE(built->add_entry(key, std::format("v{}", i), 100 + i));
+    entries.emplace_back(key, 100 + i);
+  }
+  auto encoded = built->encode(false);
+  EXPECT_EQ(encoded[encoded.size() - 3], Block::kFormatPrefixHash);
+  auto indexed = Block::decode(encoded, false);
+  ASSERT_NE(indexed, nullptr);
+
+  std::vector<std::string> probes = {"", "k", "k0", "k00000", "k000000", "k00900", "l"};
+  for (int i = 0; i < 905; i++) {
+    probes.push_back(std::format("k{:05d}", i));
+  }
+  for (const auto& probe : probes) {
+    for (uint64_t tranc_id : {uint64_t{0}, uint64_t{150}, uint64_t{600}}) {
+      EXPECT_EQ(indexed->get_offset_binary(probe, tranc_id),
+                built->get_offset_binary(probe, tranc_id))
+          << probe << "@" << tranc_id;
+    }
+  }
+  for (const auto& [key, tranc_id] : entries) {
+    EXPECT_EQ(indexed->get_value_binary(key, tranc_id)->second, tranc_id) << key;
+  }
+  EXPECT_TRUE(indexed->KeyExists("k00300"));
+  EXPECT_FALSE(indexed->KeyExists("k00301"));
+
+  // 重新编码得到相同的字节
+  EXPECT_EQ(indexed->encode(false), encoded);
+
+  // 去掉索引: data | buckets | num_buckets(u16) | trailer(7B)
+  uint16_t num_buckets;
+  std::memcpy(&num_buckets, encoded.data() + encoded.size() - 9, sizeof(uint16_t));
+  std::vector<uint8_t> plain(encoded.begin(), encoded.end() - 9 - num_buckets);
+  plain.insert(plain.end(), encoded.end() - 7, encoded.end());
+  plain[plain.size() - 3] = Block::kFormatPrefix;
+  auto unindexed = Block::decode(plain, false);
+  ASSERT_NE(unindexed, nullptr);
+  for (const auto& probe : probes) {
+    EXPECT_EQ(unindexed->get_offset_binary(probe, 150), built->get_offset_binary(probe, 150))
+        << probe;
+  }
+  EXPECT_EQ(unindexed->encode(false), encoded);
+}
+
+// 校验和是掩码后的 crc32c; 损坏的 block 默认解码失败, 关掉校验后照常解码
+TEST_F(BlockTest, Checksum_Crc32cAndOptionalVerification) {
+  auto block = std::make_shared<Block>(4096);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(block->add_entry(std::format("key{:03d}", i), std::format("value{:03d}", i), i));
+  }
+  auto encoded = block->encode();
+  const std::span<const uint8_t> body(encoded.data(), encoded.size() - 4);
+  uint32_t stored;
+  std::memcpy(&stored, encoded.data() + body.size(), sizeof(stored));
+  EXPECT_EQ(stored, Global_::mask_crc(Global_::crc32c_portable(body)));
+
+  // 新格式不接受改用 crc32c 之前的 std::hash 校验和
+  auto legacy_hash = encoded;
+  const uint32_t old_checksum = Global_::legacy_block_checksum(body);
+  std::memcpy(legacy_hash.data() + body.size(), &old_checksum, sizeof(old_checksum));
+  EXPECT_THROW(Block::decode(legacy_hash), std::runtime_error);
+
+  // 改坏 key007 的 value 最后一个字节, 长度字段不动
+  auto corrupted = encoded;
+  const auto pos = std::string_view(reinterpret_cast<const char*>(corrupted.data()),
+                                    corrupted.size()).find("value007");
+  ASSERT_NE(pos, std::string_view::npos);
+  corrupted[pos + 7] = '9';
+  EXPECT_THROW(Block::decode(corrupted), std::runtime_error);
+  auto unchecked = Block::decode(corrupted, true, false);
+  ASSERT_NE(unchecked, nullptr);
+  EXPECT_EQ(unchecked->get_value_binary("key007")->first, "value009");
+  EXPECT_EQ(unchecked->get_value_binary("key008")->first, "value008");
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -1,12 +1,18 @@
 #include "../../include/LSM.h"
 #include "../../include/iterator/LeveIterator.h"
+#include "../../include/storage/Lz.h"
 #include <gtest/gtest.h>
 #include <spdlog/spdlog.h>
 #include <filesystem>
+#include <fstream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <print>
+#include <random>
 #include <string>
+#include <thread>
 #include <vector>
 #include <algorithm>
 
@@ -151,6 +157,802 @@ TEST_F(LSMTest, FlushPreservesTombstone) {
 
 
 
+// 一次 flush 把所有分片的冻结表合并成一个有序段, 切出的多个 L0 SST 之间 key 不重叠
+TEST_F(LSMTest, FlushMergesShardsIntoDisjointL0Run) {
+  const int         N = 40000;
+  const std::string pad(100, 'v');
+  for (int i = 0; i < N; ++i) {
+    lsm->put(std::format("run_{:06d}", i), pad);
+  }
+  lsm->flush_all();
+
+  std::vector<SstMeta> l0;
+  for (const auto& meta : lsm->get_manifest_info()) {
+    if (meta.level == 0) l0.push_back(meta);
+  }
+  ASSERT_GE(l0.size(), 2u) << "~5MB of data should be cut into several L0 SSTs";
+  std::ranges::sort(l0, {}, &SstMeta::first_key);
+  for (size_t i = 1; i < l0.size(); ++i) {
+    EXPECT_LT(l0[i - 1].last_key, l0[i].first_key) << "L0 SSTs of one flush overlap";
+  }
+  for (int i = 0; i < N; i += 997) {
+    ASSERT_TRUE(lsm->get(std::format("run_{:06d}", i)).has_value());
+  }
+}
+
+// 范围分片模式下读写、删除、前缀查询与哈希分片行为一致
+TEST_F(LSMTest, RangeShardMode_ReadWriteDeleteAndPrefix) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  lsm = std::make_shared<LSM>(db_path, Global_::MemTableShardMode::kRange);
+
+  const int         N = 30000;
+  const std::string pad(100, 'r');
+  for (int i = 0; i < N; ++i) {
+    lsm->put(std::format("rng_{:06d}", (i * 7919) % N), pad);
+  }
+  for (int i = 0; i < N; i += 3) {
+    lsm->remove(std::format("rng_{:06d}", i));
+  }
+  for (int i = 0; i < N; i += 211) {
+    auto val = lsm->get(std::format("rng_{:06d}", i));
+    EXPECT_EQ(val.has_value(), i % 3 != 0) << i;
+  }
+  auto range = lsm->get_prefix_range("rng_0001");
+  EXPECT_EQ(range.size(), 67u);  // rng_000100..rng_000199 中 i % 3 != 0 的部分
+
+  lsm->flush_all();
+  for (int i = 0; i < N; i += 211) {
+    auto val = lsm->get(std::format("rng_{:06d}", i));
+    EXPECT_EQ(val.has_value(), i % 3 != 0) << i;
+  }
+}
+
+// 哈希/向量表示的活跃表：冻结时转成有序跳表，落盘后的读结果与跳表表示一致
+class LSMRepTest : public LSMTest,
+                   public testing::WithParamInterface<Global_::MemTableRepType> {};
+
+TEST_P(LSMRepTest, ReadWriteDeleteAndPrefix) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  lsm = std::make_shared<LSM>(db_path, Global_::MemTableShardMode::kHash, GetParam());
+
+  const int         N = 30000;
+  const std::string pad(100, 'h');
+  for (int i = 0; i < N; ++i) {
+    lsm->put(std::format("hsh_{:06d}", (i * 7919) % N), pad);
+  }
+  for (int i = 0; i < N; i += 3) {
+    lsm->remove(std::format("hsh_{:06d}", i));
+  }
+  for (int i = 0; i < N; i += 211) {
+    auto val = lsm->get(std::format("hsh_{:06d}", i));
+    EXPECT_EQ(val.has_value(), i % 3 != 0) << i;
+  }
+  EXPECT_EQ(lsm->get_prefix_range("hsh_0001").size(), 67u);
+
+  lsm->flush_all();
+  for (int i = 0; i < N; i += 211) {
+    auto val = lsm->get(std::format("hsh_{:06d}", i));
+    EXPECT_EQ(val.has_value(), i % 3 != 0) << i;
+  }
+  EXPECT_EQ(lsm->get_prefix_range("hsh_0001").size(), 67u);
+}
+
+INSTANTIATE_TEST_SUITE_P(MemTableReps, LSMRepTest,
+                         testing::Values(Global_::MemTableRepType::kHashTable,
+                                         Global_::MemTableRepType::kVector));
+
+// 多个 flush 线程并行落盘时，安装顺序仍按冻结顺序：覆盖写总是读到最新值，重启后亦然
+TEST_F(LSMTest, ParallelFlush_OverwritesStayOrdered) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const int         N = 20000;
+  const std::string pad(1000, 'p');  // 每轮约 20MB，多轮之间会冻结并后台落盘多次
+  {
+    LSM_Engine engine(db_path, Global_::Block_CACHE_capacity, Global_::Block_CACHE_K,
+                      Global_::MEMTABLE_SHARD_MODE, /*flush_threads=*/4);
+    uint64_t tid = 1;
+    for (int round = 0; round < 3; ++round) {
+      std::vector<std::thread> writers;
+      for (int t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t, round, base = tid + t * (N / 4)] {
+          for (int i = t * (N / 4); i < (t + 1) * (N / 4); ++i) {
+            engine.put(std::format("pf_{:06d}", i), std::format("r{}_{}", round, pad),
+                       base + i - t * (N / 4));
+          }
+        });
+      }
+      for (auto& w : writers) w.join();
+      tid += N;
+    }
+    engine.flush(true);
+    for (int i = 0; i < N; i += 37) {
+      auto val = engine.get(std::format("pf_{:06d}", i));
+      ASSERT_TRUE(val.has_value()) << i;
+      EXPECT_TRUE(val->first.starts_with("r2_")) << i;
+    }
+  }
+  LSM_Engine reopened(db_path);
+  for (int i = 0; i < N; i += 37) {
+    auto val = reopened.get(std::format("pf_{:06d}", i));
+    ASSERT_TRUE(val.has_value()) << i;
+    EXPECT_TRUE(val->first.starts_with("r2_")) << i;
+  }
+}
+
+// 热点 key 反复覆盖：冻结/落盘只保留最新版本和存活快照看得到的版本，L0 随之变小
+TEST_F(LSMTest, FlushCollapsesObsoleteVersions) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const int KEYS = 2000, ROUNDS = 30;
+  LSM_Engine engine(db_path);
+  uint64_t   tid      = 1;
+  uint64_t   snapshot = 0;
+  for (int round = 0; round < ROUNDS; ++round) {
+    for (int i = 0; i < KEYS; ++i) {
+      engine.put(std::format("ctr_{:05d}", i), std::format("{:08d}", round), tid++);
+    }
+    if (round == 9) snapshot = engine.acquire_snapshot(tid - 1);
+  }
+  engine.flush(true);
+  EXPECT_GT(engine.memtable->collapsed_versions(), 0u);
+
+  uint64_t entries = 0;
+  for (const auto& meta : engine.get_manifest_info()) {
+    auto sst = engine.ssts.at(meta.sst_id);
+    for (auto it = sst->begin(0); it != sst->end(); ++it) ++entries;
+  }
+  EXPECT_EQ(entries, 2u * KEYS);  // 每个 key 的最新版本 + 快照版本
+
+  for (int i = 0; i < KEYS; i += 97) {
+    auto key = std::format("ctr_{:05d}", i);
+    EXPECT_EQ(engine.get(key)->first, std::format("{:08d}", ROUNDS - 1));
+    EXPECT_EQ(engine.get(key, snapshot)->first, std::format("{:08d}", 9));
+  }
+  engine.release_snapshot(snapshot);
+}
+
+// 正在进行的读 (ReadView) 和快照一样受保护: 冻结回收旧版本时保留它看得到的版本
+TEST_F(LSMTest, ReadViewSurvivesFreeze) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  LSM_Engine engine(db_path);
+  for (int i = 0; i < 100; ++i) engine.put(std::format("rv_{:03d}", i), "old");
+  {
+    const LSM_Engine::ReadView view(engine);
+    for (int i = 0; i < 100; ++i) engine.put(std::format("rv_{:03d}", i), "new");
+    ASSERT_TRUE(engine.memtable->frozen_cur_table(true));
+    for (int i = 0; i < 100; i += 7) {
+      auto key = std::format("rv_{:03d}", i);
+      EXPECT_EQ(engine.get(key, view.tranc_id())->first, "old") << key;
+      EXPECT_EQ(engine.get(key, engine.published_tranc_id())->first, "new") << key;
+    }
+  }
+  // 读结束后再冻结, 旧版本可以回收
+  const size_t collapsed = engine.memtable->collapsed_versions();
+  for (int i = 0; i < 100; ++i) engine.put(std::format("rv_{:03d}", i), "newer");
+  for (int i = 0; i < 100; ++i) engine.put(std::format("rv_{:03d}", i), "newest");
+  ASSERT_TRUE(engine.memtable->frozen_cur_table(true));
+  EXPECT_GT(engine.memtable->collapsed_versions(), collapsed);
+}
+
+// 前缀扫描读在发布水位上: 更早的 id 还没写进内存表时, 看不到它之后已经写入的版本
+TEST_F(LSMTest, PrefixRangeSkipsUnpublishedWrites) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  LSM_Engine engine(db_path);
+  for (int i = 0; i < 10; ++i) engine.put(std::format("pu_{}", i), "old");
+  // 分配两个 id: 前一个的写入还在途中, 后一个已经写进内存表
+  const uint64_t pending = engine.nextTransactionId_.fetch_add(2);
+  engine.put("pu_3", "new", pending + 1);
+  engine.put("pu_x", "new", pending + 1);
+  ASSERT_EQ(engine.published_tranc_id(), pending - 1);
+
+  auto check = [&] {
+    const auto rows = engine.get_prefix_range("pu_", engine.published_tranc_id());
+    ASSERT_EQ(rows.size(), 10u);
+    for (auto& [key, value, tid] : rows) {
+      EXPECT_EQ(value, "old") << key;
+      EXPECT_LT(tid, pending) << key;
+    }
+    EXPECT_EQ(engine.get_prefix_range("pu_", pending + 1).size(), 11u);
+  };
+  check();
+  ASSERT_TRUE(engine.memtable->frozen_cur_table(true));
+  check();
+}
+
+// 按次指定持久化方式:并发 sync 写入走组提交, 不 sync 的只进页缓存, 关闭 WAL 的不落日志;
+// 三种写入都立即可读, WAL 里只有前两种
+TEST_F(LSMTest, WriteOptions_SyncBufferedAndDisabledWal) {
+  const WriteOptions sync{.sync = true};
+  const WriteOptions buffered{.sync = false};
+  const WriteOptions no_wal{.disable_wal = true};
+
+  constexpr int            kThreads = 4;
+  constexpr int            kPerThread = 100;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; ++t) {
+    writers.emplace_back([&, t] {
+      for (int i = 0; i < kPerThread; ++i) {
+        lsm->put(std::format("sync_{}_{:03d}", t, i), std::to_string(i), sync);
+      }
+    });
+  }
+  for (auto& w : writers) {
+    w.join();
+  }
+  lsm->put("buffered", "b", buffered);
+  lsm->put_batch({{"batch_a", "1"}, {"batch_b", "2"}}, sync);
+  lsm->remove("sync_0_000", sync);
+  lsm->put("no_wal", "x", no_wal);
+
+  EXPECT_EQ(lsm->get("sync_3_099"), "99");
+  EXPECT_EQ(lsm->get("buffered"), "b");
+  EXPECT_EQ(lsm->get("batch_b"), "2");
+  EXPECT_FALSE(lsm->get("sync_0_000").has_value());
+  EXPECT_EQ(lsm->get("no_wal"), "x");
+
+  auto logged = WAL::recover(db_path, 0);
+  ASSERT_TRUE(logged.has_value());
+  std::map<std::string, std::string> latest;
+  for (const auto& [tid, entries] : *logged) {
+    for (const auto& e : entries) {
+      latest[e.key] = e.value;
+    }
+  }
+  EXPECT_EQ(latest.size(), kThreads * kPerThread + 3u);
+  EXPECT_EQ(latest["sync_2_050"], "50");
+  EXPECT_EQ(latest["buffered"], "b");
+  EXPECT_EQ(latest["batch_a"], "1");
+  EXPECT_EQ(latest["sync_0_000"], "");  // 删除标记
+  EXPECT_FALSE(latest.contains("no_wal"));
+}
+
+// 重启不再截断已有的 WAL: 没落盘就析构的写入 (含删除) 在重新打开后回放出来
+TEST_F(LSMTest, Reopen_ReplaysUnflushedWal) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  {
+    LSM_Engine engine(db_path);
+    engine.put("kept", "v1", 1, {.sync = true});
+    engine.put("gone", "x", 2);
+    engine.remove("gone", 3);
+    engine.put_batch({{"b1", "1"}, {"b2", "2"}}, 4, {.sync = true});
+  }
+  {
+    LSM_Engine engine(db_path);
+    EXPECT_EQ(engine.get("kept")->first, "v1");
+    EXPECT_FALSE(engine.get("gone").has_value());
+    EXPECT_EQ(engine.get("b2")->first, "2");
+    EXPECT_EQ(engine.nextTransactionId_.load(), 5u);
+    engine.put("kept", "v2", 5, {.sync = true});
+  }
+  LSM_Engine engine(db_path);
+  EXPECT_EQ(engine.get("kept")->first, "v2");
+}
+
+// 多个 WAL 流: 各线程分到不同的流, 重启时所有流按 tranc_id 合并回内存表;
+// 以更少的流重新打开也会回放磁盘上已有的流
+TEST_F(LSMTest, WalStreams_ConcurrentWritersRecoverMerged) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  constexpr size_t kStreams = 4, kThreads = 4, kKeys = 200;
+  auto open_engine = [&](size_t streams) {
+    return std::make_unique<LSM_Engine>(db_path, Global_::Block_CACHE_capacity,
+                                        Global_::Block_CACHE_K, Global_::MEMTABLE_SHARD_MODE,
+                                        Global_::FLUSH_THREAD_NUM, Global_::MEMTABLE_REP,
+                                        streams);
+  };
+  {
+    auto                     engine = open_engine(kStreams);
+    std::atomic<uint64_t>    next_tid{1};
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < kThreads; ++t) {
+      // 所有线程写同一批 key, 同一个 key 的版本散落在不同的流里
+      writers.emplace_back([&, t] {
+        for (size_t i = 0; i < kKeys; ++i) {
+          const uint64_t tid = next_tid.fetch_add(1);
+          engine->put(std::format("k{:03d}", i), std::format("t{}_{}", t, tid), tid);
+        }
+      });
+    }
+    for (auto& w : writers) {
+      w.join();
+    }
+    const uint64_t last = next_tid.fetch_add(1);
+    engine->put_batch({{"k000", "final"}, {"batch", "b"}}, last);
+    engine->remove("k001", last + 1);
+  }
+  for (size_t s = 1; s < kStreams; ++s) {
+    EXPECT_TRUE(std::filesystem::is_directory(db_path + std::format("/wal_stream_{}", s)));
+  }
+
+  // 每个 key 的期望值: 第一次打开时回放出来的最新版本
+  std::map<std::string, std::string> expected;
+  {
+    auto engine = open_engine(kStreams);
+    EXPECT_EQ(engine->nextTransactionId_.load(), kThreads * kKeys + 3);
+    EXPECT_EQ(engine->get("k000")->first, "final");
+    EXPECT_EQ(engine->get("batch")->first, "b");
+    EXPECT_FALSE(engine->get("k001").has_value());
+    for (size_t i = 2; i < kKeys; ++i) {
+      const auto key = std::format("k{:03d}", i);
+      auto       got = engine->get(key);
+      ASSERT_TRUE(got.has_value()) << key;
+      // 最新版本的值里带着写入它的 tranc_id
+      EXPECT_TRUE(got->first.ends_with(std::format("_{}", got->second))) << got->first;
+      expected[key] = got->first;
+    }
+  }
+  auto engine = open_engine(1);
+  EXPECT_EQ(engine->wals.size(), kStreams);
+  EXPECT_FALSE(engine->get("k001").has_value());
+  for (const auto& [key, value] : expected) {
+    EXPECT_EQ(engine->get(key)->first, value);
+  }
+  engine->clear();
+  EXPECT_FALSE(std::filesystem::exists(db_path + "/wal_stream_1"));
+}
+
+// WAL 段: 预分配到固定大小, 轮转后全部可恢复; 已 checkpoint 的段改名复用,
+// 复用段里的旧记录不会被当成新日志回放
+TEST_F(LSMTest, WalSegments_PreallocateRotateAndRecycle) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string wal_dir = db_path + "/wal";
+  const uint64_t    limit   = 4 * Global_::WAL_BLOCK_SIZE;
+  const std::string value(1000, 'v');
+  auto count_files = [&](std::string_view prefix) {
+    size_t n = 0;
+    for (const auto& de : std::filesystem::directory_iterator(wal_dir)) {
+      n += de.path().filename().string().starts_with(prefix) ? 1 : 0;
+    }
+    return n;
+  };
+  {
+    WAL wal(wal_dir, 0, /*clean_interval_s=*/3600, limit);
+    for (uint64_t tid = 1; tid <= 500; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:04d}", tid), value, tid}, tid % 50 == 0));
+    }
+  }
+  EXPECT_GE(count_files("wal."), 5u);
+  for (const auto& de : std::filesystem::directory_iterator(wal_dir)) {
+    EXPECT_GE(de.file_size(), limit) << de.path();  // 预分配, 追加不改文件大小
+  }
+  auto all = WAL::recover(wal_dir, 0);
+  ASSERT_TRUE(all.has_value());
+  EXPECT_EQ(all->size(), 500u);
+  EXPECT_EQ(all->at(500).front().key, "k0500");
+
+  {
+    // 全部 checkpoint 之后, 清理线程把旧段改名留作复用, 多余的删掉
+    WAL wal(wal_dir, /*checkpoint=*/500, /*clean_interval_s=*/1, limit);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_EQ(count_files("recycled_wal."), Global_::WAL_RECYCLE_SEGMENTS);
+    EXPECT_EQ(count_files("wal."), 1u);  // 只剩活跃段
+    for (uint64_t tid = 501; tid <= 700; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:04d}", tid), value, tid}, false));
+    }
+    EXPECT_LT(count_files("recycled_wal."), Global_::WAL_RECYCLE_SEGMENTS);
+  }
+  auto fresh = WAL::recover(wal_dir, 0);
+  ASSERT_TRUE(fresh.has_value());
+  EXPECT_EQ(fresh->size(), 200u);
+  EXPECT_EQ(fresh->begin()->first, 501u);
+  EXPECT_EQ(fresh->rbegin()->first, 700u);
+}
+
+// 封口的段只看段头里的 tranc_id 范围: 清理线程和 replay 都不再读它的记录
+TEST_F(LSMTest, WalSegments_SealedRangeSkipsScan) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string wal_dir = db_path + "/wal";
+  const uint64_t    limit   = 4 * Global_::WAL_BLOCK_SIZE;
+  const std::string value(1000, 'v');
+  {
+    WAL wal(wal_dir, 0, /*clean_interval_s=*/3600, limit);
+    for (uint64_t tid = 1; tid <= 300; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:04d}", tid), value, tid}, false));
+    }
+  }
+  std::vector<std::filesystem::path> segments;
+  for (const auto& de : std::filesystem::directory_iterator(wal_dir)) {
+    segments.push_back(de.path());
+  }
+  std::ranges::sort(segments, {}, [](const auto& p) {
+    return std::stoull(p.filename().string().substr(4));
+  });
+  ASSERT_GE(segments.size(), 3u);
+  {
+    // 清掉第一个段的首个数据块: 读记录会报损坏, 扫描会以为它是空段
+    std::fstream      f(segments[0], std::ios::in | std::ios::out | std::ios::binary);
+    const std::string zeros(Global_::WAL_BLOCK_SIZE, '\0');
+    f.seekp(Global_::WAL_BLOCK_SIZE);
+    f.write(zeros.data(), static_cast<std::streamsize>(zeros.size()));
+  }
+  EXPECT_FALSE(WAL::replay(wal_dir, 0, [](WalEntry&&) {}).has_value());
+  auto skipped = WAL::replay(wal_dir, 300, [](WalEntry&&) {});
+  ASSERT_TRUE(skipped.has_value());
+  EXPECT_EQ(*skipped, 0u);
+
+  {
+    WAL wal(wal_dir, /*checkpoint=*/0, /*clean_interval_s=*/1, limit);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_TRUE(std::filesystem::exists(segments[0]));  // 段头说它还有没 checkpoint 的条目
+    wal.set_checkpoint_tranc_id(300);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_FALSE(std::filesystem::exists(segments[0]));
+  }
+}
+
+// 记录直接从调用方的 key/value 视图编码进块缓冲: 跨多个块的大条目、空 key/value、
+// 凑满块尾的小条目都要原样恢复
+TEST_F(LSMTest, WalEncode_FragmentedViewsRoundTrip) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string wal_dir = db_path + "/wal";
+  std::vector<std::pair<std::string, std::string>> kvs;
+  kvs.emplace_back("big", std::string(3 * Global_::WAL_BLOCK_SIZE + 123, 'b'));
+  kvs.emplace_back("", "empty-key");
+  kvs.emplace_back("empty-value", "");
+  for (int i = 0; i < 2000; ++i) {
+    kvs.emplace_back(std::format("s{:04d}", i), std::string(i % 37, static_cast<char>('a' + i % 26)));
+  }
+  {
+    WAL                      wal(wal_dir, 0, /*clean_interval_s=*/3600, 16 * Global_::WAL_BLOCK_SIZE);
+    std::vector<WalEntryRef> refs;
+    for (uint64_t i = 0; i < kvs.size(); ++i) {
+      refs.emplace_back(kvs[i].first, kvs[i].second, i + 1);
+    }
+    ASSERT_TRUE(wal.log_batch(std::span{refs}.first(1000), false));
+    ASSERT_TRUE(wal.log_batch(std::span{refs}.subspan(1000), true));
+  }
+  std::vector<WalEntry> seen;
+  auto replayed = WAL::replay(wal_dir, 0, [&](WalEntry&& e) { seen.push_back(std::move(e)); }, 1);
+  ASSERT_TRUE(replayed.has_value());
+  ASSERT_EQ(seen.size(), kvs.size());
+  for (const auto& e : seen) {
+    ASSERT_GE(e.tranc_id, 1u);
+    EXPECT_EQ(e.key, kvs[e.tranc_id - 1].first);
+    EXPECT_EQ(e.value, kvs[e.tranc_id - 1].second);
+  }
+}
+
+// LZ 编解码: 空输入、短输入、长重复 (重叠匹配)、随机数据都要原样还原; 损坏输入返回 false
+TEST(LzTest, RoundTripAndRejectsGarbage) {
+  std::mt19937              rng(11);
+  std::vector<std::string>  inputs = {"", "a", "abcd", std::string(100000, 'x'),
+                                      std::string(70000, '\0') + "tail"};
+  std::string json;
+  for (int i = 0; i < 200; ++i) {
+    json += std::format(R"({{"id":{},"name":"user{}","tags":["a","b"],"score":{}}})", i, i % 7,
+                        rng() % 1000);
+  }
+  inputs.push_back(json);
+  std::string noise(5000, '\0');
+  for (auto& c : noise) c = static_cast<char>(rng());
+  inputs.push_back(noise);
+
+  for (const auto& in : inputs) {
+    const auto           src = std::span{reinterpret_cast<const uint8_t*>(in.data()), in.size()};
+    std::vector<uint8_t> packed, unpacked;
+    Lz::compress(src, packed);
+    ASSERT_TRUE(Lz::decompress(packed, in.size(), unpacked)) << in.size();
+    EXPECT_TRUE(std::ranges::equal(unpacked, src)) << in.size();
+    if (in.size() >= 1000 && in != noise) {
+      EXPECT_LT(packed.size() * 3, in.size()) << in.size();
+    }
+    if (!in.empty()) {
+      EXPECT_FALSE(Lz::decompress(packed, in.size() + 1, unpacked));
+    }
+  }
+  std::vector<uint8_t> out;
+  const uint8_t        bad_offset[] = {0x14, 'a', 0x05, 0x00};  // 回退距离超过已输出的长度
+  EXPECT_FALSE(Lz::decompress(bad_offset, 9, out));
+
+  // 流式: 短记录引用之前 commit 的记录; 没 commit 的记录解压方看不到,
+  // 总量超过窗口裁剪阈值, 覆盖裁剪后的位置平移
+  Lz::Encoder          enc;
+  Lz::Decoder          dec;
+  size_t               raw_total = 0, packed_total = 0;
+  std::vector<uint8_t> packed;
+  for (int i = 0; i < 8000; ++i) {
+    const std::string rec = std::format(R"({{"id":{},"name":"user{}","score":{}}})", i, i % 7,
+                                        rng() % 1000);
+    const auto src = std::span{reinterpret_cast<const uint8_t*>(rec.data()), rec.size()};
+    packed.clear();
+    enc.compress(src, packed);
+    if (i % 5 == 0) continue;  // 模拟 "压缩不划算, 按原样写入"
+    enc.commit();
+    const auto got = dec.decompress(packed, rec.size());
+    ASSERT_TRUE(got.has_value()) << i;
+    ASSERT_TRUE(std::ranges::equal(*got, src)) << i;
+    raw_total += rec.size();
+    packed_total += packed.size();
+  }
+  EXPECT_LT(packed_total * 2, raw_total);
+}
+
+// WAL 压缩: 压缩写入的段更少; 同一目录里压缩段和未压缩段混在一起都能恢复
+TEST_F(LSMTest, WalCompression_MixedSegmentsRecover) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string wal_dir = db_path + "/wal";
+  const uint64_t    limit   = 4 * Global_::WAL_BLOCK_SIZE;
+  auto json_value = [](uint64_t tid) {
+    return std::format(
+        R"({{"user_id":{},"name":"user-{}","email":"user-{}@example.com","active":true,)"
+        R"("roles":["reader","writer"],"profile":{{"city":"Shanghai","lang":"zh-CN"}},)"
+        R"("history":[{{"event":"login","ok":true}},{{"event":"logout","ok":true}}]}})",
+        tid, tid, tid);
+  };
+  auto count_segments = [&] {
+    size_t n = 0;
+    for (const auto& de : std::filesystem::directory_iterator(wal_dir)) {
+      n += de.path().filename().string().starts_with("wal.") ? 1 : 0;
+    }
+    return n;
+  };
+  constexpr uint64_t kPerRun = 3000;
+  {
+    WAL wal(wal_dir, 0, /*clean_interval_s=*/3600, limit, Global_::WalCompression::kNone);
+    for (uint64_t tid = 1; tid <= kPerRun; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:04d}", tid), json_value(tid), tid}, false));
+    }
+  }
+  const size_t raw_segments = count_segments();
+  {
+    WAL wal(wal_dir, 0, /*clean_interval_s=*/3600, limit, Global_::WalCompression::kLz);
+    for (uint64_t tid = kPerRun + 1; tid <= 2 * kPerRun; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:04d}", tid), json_value(tid), tid}, false));
+    }
+    // 太短、压不动的记录照旧原样写
+    ASSERT_TRUE(wal.log(WalEntry{"short", "v", 2 * kPerRun + 1}, true));
+  }
+  EXPECT_LT((count_segments() - raw_segments) * 2, raw_segments);
+
+  auto all = WAL::recover(wal_dir, 0);
+  ASSERT_TRUE(all.has_value());
+  ASSERT_EQ(all->size(), 2 * kPerRun + 1);
+  for (uint64_t tid = 1; tid <= 2 * kPerRun; ++tid) {
+    ASSERT_EQ(all->at(tid).front().value, json_value(tid)) << tid;
+  }
+  EXPECT_EQ(all->at(2 * kPerRun + 1).front().value, "v");
+}
+
+// log_async: 多个生产者不等结果连续提交, 全部落盘; 同一线程的提交按调用顺序写入
+TEST_F(LSMTest, WalAsync_ProducersPipelineWrites) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string  wal_dir = db_path + "/wal";
+  constexpr uint64_t kThreads = 4, kPerThread = 3000;
+  {
+    WAL                      wal(wal_dir, 0, /*clean_interval_s=*/3600, 8 * Global_::WAL_BLOCK_SIZE);
+    std::vector<std::thread> producers;
+    for (uint64_t t = 0; t < kThreads; ++t) {
+      producers.emplace_back([&wal, t] {
+        std::vector<std::future<std::expected<void, WalError>>> pending;
+        for (uint64_t i = 1; i <= kPerThread; ++i) {
+          const uint64_t tid = t * 100000 + i;
+          pending.push_back(
+              wal.log_async({WalEntry{std::format("k{}", tid), "v", tid}}, i == kPerThread));
+        }
+        for (auto& f : pending) {
+          EXPECT_TRUE(f.get().has_value());
+        }
+      });
+    }
+    for (auto& p : producers) {
+      p.join();
+    }
+    // 空提交直接完成
+    EXPECT_TRUE(wal.log_async({}, true).get().has_value());
+  }
+
+  // 单线程 replay 按段号顺序回放, 即日志顺序
+  std::vector<uint64_t> last(kThreads, 0);
+  size_t                count = 0;
+  auto replayed = WAL::replay(wal_dir, 0, [&](WalEntry&& e) {
+    const uint64_t t = e.tranc_id / 100000;
+    EXPECT_EQ(e.key, std::format("k{}", e.tranc_id));
+    EXPECT_GT(e.tranc_id, last[t]);
+    last[t] = e.tranc_id;
+    ++count;
+  }, 1);
+  ASSERT_TRUE(replayed.has_value());
+  EXPECT_EQ(count, kThreads * kPerThread);
+}
+
+// 写组统一分配 tranc_id: 每个批次一个 id, 不重不漏, 日志顺序就是 id 顺序
+TEST_F(LSMTest, WalGroupIds_ContiguousInLogOrder) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string  wal_dir = db_path + "/wal";
+  constexpr uint64_t kThreads = 8, kPerThread = 300;
+  std::atomic<uint64_t>              next_tid{1};
+  std::vector<std::vector<uint64_t>> ids(kThreads);
+  {
+    WAL                      wal(wal_dir, 0);
+    std::vector<std::thread> writers;
+    for (uint64_t t = 0; t < kThreads; ++t) {
+      writers.emplace_back([&, t] {
+        for (uint64_t i = 0; i < kPerThread; ++i) {
+          const std::string a = std::format("a{}_{}", t, i);
+          const std::string b = std::format("b{}_{}", t, i);
+          const WalEntryRef batch[] = {{a, "1", 0}, {b, "2", 0}};
+          uint64_t          tid     = 0;
+          EXPECT_TRUE(wal.log_batch(batch, i % 4 == 0, next_tid, tid).has_value());
+          ids[t].push_back(tid);
+        }
+      });
+    }
+    for (auto& w : writers) {
+      w.join();
+    }
+  }
+  std::vector<uint64_t> all;
+  for (const auto& v : ids) {
+    EXPECT_TRUE(std::ranges::is_sorted(v));  // 同一线程的写入 id 递增
+    all.insert(all.end(), v.begin(), v.end());
+  }
+  std::ranges::sort(all);
+  ASSERT_EQ(all.size(), kThreads * kPerThread);
+  for (size_t i = 0; i < all.size(); ++i) {
+    ASSERT_EQ(all[i], i + 1);
+  }
+  EXPECT_EQ(next_tid.load(), kThreads * kPerThread + 1);
+
+  uint64_t prev  = 0;
+  size_t   count = 0;
+  auto replayed = WAL::replay(wal_dir, 0, [&](WalEntry&& e) {
+    // 批内两条共享一个 id, 下一批正好是下一个 id
+    EXPECT_EQ(e.tranc_id, e.key[0] == 'a' ? prev + 1 : prev) << e.key;
+    prev = e.tranc_id;
+    ++count;
+  }, 1);
+  ASSERT_TRUE(replayed.has_value());
+  EXPECT_EQ(count, 2 * kThreads * kPerThread);
+}
+
+// 读请求用已发布的序号做快照: 写入返回后自己一定能读到; 全部写完后发布序号追上分配序号
+TEST_F(LSMTest, PublishedSequence_ReadYourWrites) {
+  constexpr int            kThreads = 8, kKeys = 500;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; ++t) {
+    writers.emplace_back([&, t] {
+      for (int i = 0; i < kKeys; ++i) {
+        const auto key = std::format("pub_{}_{}", t, i % 50);
+        if (i % 7 == 3) {
+          lsm->remove(key, {.disable_wal = true});
+          EXPECT_FALSE(lsm->get(key).has_value()) << key;
+        } else {
+          lsm->put(key, std::to_string(i), {.sync = i % 10 == 0});
+          EXPECT_EQ(lsm->get(key), std::to_string(i)) << key;
+        }
+      }
+    });
+  }
+  for (auto& w : writers) {
+    w.join();
+  }
+  lsm.reset();
+  LSM_Engine engine(db_path);
+  // 关库前 flush_all 落盘, 但 id 计数照样从恢复出的最大 id 之后开始
+  EXPECT_EQ(engine.published_tranc_id() + 1, engine.nextTransactionId_.load());
+}
+
+// 并行流式恢复: 多个段同时解码并回调, 条目不丢不重; 已 sync 范围内的损坏会报错
+TEST_F(LSMTest, WalReplay_ParallelSegmentsAndCorruption) {
+  lsm.reset();
+  std::filesystem::remove_all(db_path);
+  const std::string wal_dir = db_path + "/wal";
+  const uint64_t    limit   = 4 * Global_::WAL_BLOCK_SIZE;
+  const std::string value(700, 'v');
+  constexpr uint64_t N = 1200;
+  {
+    WAL wal(wal_dir, 0, /*clean_interval_s=*/3600, limit);
+    for (uint64_t tid = 1; tid <= N; ++tid) {
+      ASSERT_TRUE(wal.log(WalEntry{std::format("k{:05d}", tid), value, tid}, true));
+    }
+  }
+
+  std::mutex            mu;
+  std::vector<uint64_t> seen;
+  auto replayed = WAL::replay(wal_dir, 100, [&](WalEntry&& e) {
+    EXPECT_EQ(e.key, std::format("k{:05d}", e.tranc_id));
+    std::lock_guard lk(mu);
+    seen.push_back(e.tranc_id);
+  }, 4);
+  ASSERT_TRUE(replayed.has_value());
+  EXPECT_EQ(*replayed, N - 100);
+  std::ranges::sort(seen);
+  EXPECT_EQ(seen.size(), N - 100);
+  EXPECT_EQ(std::ranges::adjacent_find(seen), seen.end());
+  EXPECT_EQ(seen.front(), 101u);
+
+  // 翻转第二个段第一条记录里的一个字节: 它在段头记录的逻辑末尾之前, 不能当成日志结尾
+  std::vector<std::filesystem::path> segments;
+  for (const auto& de : std::filesystem::directory_iterator(wal_dir)) {
+    segments.push_back(de.path());
+  }
+  std::ranges::sort(segments, {}, [](const auto& p) {
+    return std::stoull(p.filename().string().substr(4));
+  });
+  ASSERT_GE(segments.size(), 3u);
+  {
+    std::fstream f(segments[1], std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(Global_::WAL_BLOCK_SIZE + 20);
+    f.put('\x5a');
+  }
+  auto corrupt = WAL::replay(wal_dir, 0, [](WalEntry&&) {}, 4);
+  ASSERT_FALSE(corrupt.has_value());
+  EXPECT_EQ(corrupt.error(), WalError::kChecksumMismatch);
+}
+
+// CRC-32C: CPU 支持的每种实现都要和查表版本逐位一致, 覆盖三路并行的整段、尾巴和非对齐起点
+TEST(Crc32cTest, AllImplementationsAgree) {
+  const std::string_view check = "123456789";
+  const auto             check_bytes =
+      std::span{reinterpret_cast<const uint8_t*>(check.data()), check.size()};
+  EXPECT_EQ(Global_::crc32c_portable(check_bytes), 0xE3069283u);
+  EXPECT_EQ(Global_::crc32c(check_bytes), 0xE3069283u);
+
+  std::vector<uint8_t> buf(8192 + 16);
+  std::mt19937         rng(7);
+  for (auto& b : buf) b = static_cast<uint8_t>(rng());
+  for (auto impl : {Global_::Crc32cImpl::kPortable, Global_::Crc32cImpl::kSse42,
+                    Global_::Crc32cImpl::kPclmul}) {
+    if (!Global_::crc32c_supported(impl)) continue;
+    EXPECT_EQ(Global_::crc32c(impl, check_bytes), 0xE3069283u);
+    for (size_t len : {0, 1, 7, 8, 9, 255, 767, 768, 769, 1536, 2000, 4096, 8192}) {
+      for (size_t off : {0, 1, 3}) {
+        const auto data = std::span<const uint8_t>{buf}.subspan(off, len);
+        EXPECT_EQ(Global_::crc32c(impl, data), Global_::crc32c_portable(data))
+            << "impl=" << static_cast<int>(impl) << " len=" << len << " off=" << off;
+      }
+    }
+  }
+}
+
+// 写入反压：指标在阈值以下不干预，进入减速区按速率限流，越过停写阈值阻塞到指标回落
+TEST(WriteControllerTest, SlowdownThenStopThenRecover) {
+  std::atomic_size_t imm{0};
+  WriteController    wc([&] { return WriteStallInputs{.imm_bytes = imm.load()}; });
+
+  wc.maybe_stall(1024);
+  EXPECT_EQ(wc.state(), WriteStallState::kNormal);
+  EXPECT_EQ(wc.stats().delayed_writes, 0u);
+
+  // 减速区正中：速率约为 DELAYED_WRITE_RATE 的 55%，写 4MB 至少要等上百毫秒
+  imm = (Global_::WRITE_SLOWDOWN_IMM_BYTES + Global_::WRITE_STOP_IMM_BYTES) / 2;
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < 5; ++i) wc.maybe_stall(1024 * 1024);
+  auto elapsed = std::chrono::steady_clock::now() - begin;
+  EXPECT_EQ(wc.state(), WriteStallState::kDelayed);
+  EXPECT_EQ(wc.stats().delayed_writes, 5u);
+  EXPECT_GE(elapsed, std::chrono::milliseconds(300));
+
+  // 停写：写者阻塞，直到后台把指标降下来并 notify
+  imm = Global_::WRITE_STOP_IMM_BYTES;
+  std::atomic<bool> done{false};
+  std::thread       writer([&] {
+    wc.maybe_stall(16);
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(done.load());
+  EXPECT_EQ(wc.state(), WriteStallState::kStopped);
+  imm = 0;
+  wc.notify();
+  writer.join();
+  EXPECT_TRUE(done.load());
+  EXPECT_EQ(wc.state(), WriteStallState::kNormal);
+  EXPECT_EQ(wc.stats().stopped_writes, 1u);
+  EXPECT_GT(wc.stats().stop_micros, 0u);
+}
+
 // ─────────────────────────────────────────────
 //  4. 大数据量 / 强制多层压缩路径
 // ─────────────────────────────────────────────
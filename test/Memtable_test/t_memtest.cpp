@@ -5,8 +5,11 @@
 #include <cmath>
 #include <cstddef>
 #include <format>
+#include <map>
 #include <memory>
 #include <print>
+#include <random>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -172,6 +175,26 @@ TEST_F(MemtableTest, FrozenAndFlush) {
   EXPECT_GE(memtable->get_fixed_size(), total_size);
 }
 
+// 多张冻结表含同一个 key 时, 按从新到旧的顺序取可见版本
+TEST_F(MemtableTest, FrozenTablesProbedNewestFirst) {
+  memtable->put_mutex("dup", "v1", 1);
+  memtable->put_mutex("only_old", "x", 2);
+  memtable->frozen_cur_table(true);
+  memtable->put_mutex("dup", "v2", 3);
+  memtable->frozen_cur_table(true);
+  memtable->put_mutex("dup", "v3", 4);
+  memtable->frozen_cur_table(true);
+
+  auto latest = memtable->get("dup");
+  ASSERT_TRUE(latest.has_value());
+  EXPECT_EQ(latest->first, "v3");
+  auto snapshot = memtable->get("dup", 3);  // 快照读跳过更新的冻结表
+  ASSERT_TRUE(snapshot.has_value());
+  EXPECT_EQ(snapshot->first, "v2");
+  EXPECT_EQ(memtable->get("only_old")->first, "x");
+  EXPECT_FALSE(memtable->get("missing").has_value());
+}
+
 // 范围查询测试 - 使用精确的范围验证
 TEST_F(MemtableTest, RangeSearchTest) {
   constexpr int              num_records = 100;
@@ -427,6 +450,271 @@ TEST_F(MemtableTest, ConcurrentReadWrite_Correct_Sharding) {
     EXPECT_EQ(read_hits.load(), OP_COUNT); // 校验读命中的次数是否等于预期的操作数
 }
 
+// 范围分片: 换表后分界按 key 分布重新划分, 数据分散到多个分片, 前缀查询只看相交分片
+TEST_F(MemtableTest, RangeSharding_RebalanceAndPrefixScan) {
+  auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kRange);
+  ASSERT_EQ(table->shard_mode(), Global_::MemTableShardMode::kRange);
+
+  const int        N = 60'000;  // 约 9MB, 足以触发多轮换表
+  std::vector<int> order(N);
+  for (int i = 0; i < N; ++i) order[i] = i;
+  std::ranges::shuffle(order, std::mt19937(42));
+  const std::string pad(100, 'x');
+  for (int i : order) {
+    table->put_mutex(std::format("rk_{:06d}", i), std::format("v{}_{}", i, pad));
+  }
+  // 初始分界按首字节均分, "rk_" 全落在同一分片; 重划分后应分散开
+  auto counts    = table->getShardNodeCounts();
+  auto non_empty = std::ranges::count_if(counts, [](size_t c) { return c > 0; });
+  EXPECT_GT(non_empty, Global_::NUMS_SHARDS / 2);
+  EXPECT_GT(table->get_fixed_size(), 0);
+
+  // 路由单调: key 越大分片号不会越小
+  for (int i = 1; i < N; i += 997) {
+    EXPECT_LE(table->shard_of(std::format("rk_{:06d}", i - 1)),
+              table->shard_of(std::format("rk_{:06d}", i)));
+  }
+
+  // 覆盖写: 新版本在活跃表, 旧版本在冻结表
+  table->put_mutex("rk_000007", "updated", 1);
+  for (int i = 0; i < N; i += 101) {
+    auto res = table->get(std::format("rk_{:06d}", i));
+    ASSERT_TRUE(res.has_value()) << i;
+    EXPECT_TRUE(res->first.starts_with(std::format("v{}_", i)));
+  }
+  auto updated = table->get("rk_000007");
+  ASSERT_TRUE(updated.has_value());
+  EXPECT_EQ(updated->first, "updated");
+
+  auto range = table->get_prefix_range("rk_0012", 0);
+  std::set<std::string> keys;
+  for (auto& [k, v, tid] : range) keys.insert(k);
+  EXPECT_EQ(keys.size(), 100u);
+  EXPECT_EQ(*keys.begin(), "rk_001200");
+  EXPECT_EQ(*keys.rbegin(), "rk_001299");
+}
+
+// 范围分片: 并发写入触发重划分时, 已写入的 key 始终可读
+TEST_F(MemtableTest, RangeSharding_ConcurrentRotation) {
+  auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kRange);
+
+  const int         NUM_WRITERS = 4;
+  const int         PER_WRITER  = 20'000;
+  const std::string pad(100, 'y');
+  std::atomic<bool> start{false};
+  std::atomic<int>  written[NUM_WRITERS];
+  for (auto& w : written) w.store(0);
+
+  std::vector<std::thread> workers;
+  for (int t = 0; t < NUM_WRITERS; ++t) {
+    workers.emplace_back([&, t] {
+      while (!start.load(std::memory_order_acquire));
+      for (int i = 0; i < PER_WRITER; ++i) {
+        table->put_mutex(std::format("w{}_{:06d}", t, i), pad);
+        written[t].store(i + 1, std::memory_order_release);
+      }
+    });
+  }
+  std::atomic<int> misses{0};
+  workers.emplace_back([&] {
+    std::mt19937 rng(7);
+    while (!start.load(std::memory_order_acquire));
+    for (int n = 0; n < 50'000; ++n) {
+      int t     = rng() % NUM_WRITERS;
+      int avail = written[t].load(std::memory_order_acquire);
+      if (avail == 0) continue;
+      if (!table->get(std::format("w{}_{:06d}", t, rng() % avail)).has_value()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  });
+  start.store(true, std::memory_order_release);
+  for (auto& w : workers) w.join();
+
+  EXPECT_EQ(misses.load(), 0);
+  for (int t = 0; t < NUM_WRITERS; ++t) {
+    for (int i = 0; i < PER_WRITER; i += 53) {
+      ASSERT_TRUE(table->get(std::format("w{}_{:06d}", t, i)).has_value());
+    }
+  }
+  // 换下时还有写者没退出的表, 之后长大的部分不能多扣: 全部释放后冻结表字节数归零
+  table->release_flushed_tables(table->claim_frozen_tables());
+  EXPECT_EQ(table->get_fixed_size(), 0u);
+}
+
+// 非跳表的活跃表: 并发写入多版本, 冻结后转成有序跳表, 冻结前后读到的结果一致
+static void CheckRepVersionsAndFreeze(Global_::MemTableRepType rep) {
+  auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kHash, rep);
+  ASSERT_EQ(table->rep_type(), rep);
+
+  const int                NUM_WRITERS = 4;
+  const int                KEYS        = 5'000;
+  std::vector<std::thread> workers;
+  // 每个线程写同一批 key 的不同版本, tranc_id = 线程号 + 1
+  for (int t = 0; t < NUM_WRITERS; ++t) {
+    workers.emplace_back([&, t] {
+      for (int i = 0; i < KEYS; ++i) {
+        table->put_mutex(std::format("hk_{:05d}", i), std::format("v{}_{}", i, t), t + 1);
+      }
+    });
+  }
+  for (auto& w : workers) w.join();
+  table->remove_mutex("hk_00042", NUM_WRITERS + 1);
+
+  auto check = [&] {
+    for (int i = 0; i < KEYS; i += 7) {
+      auto key    = std::format("hk_{:05d}", i);
+      auto latest = table->get(key);
+      ASSERT_TRUE(latest.has_value()) << key;
+      if (i == 42) {
+        EXPECT_TRUE(latest->first.empty());
+      } else {
+        EXPECT_EQ(latest->first, std::format("v{}_{}", i, NUM_WRITERS - 1));
+      }
+      auto old = table->get(key, 2);
+      ASSERT_TRUE(old.has_value());
+      EXPECT_EQ(old->first, std::format("v{}_1", i));
+      EXPECT_EQ(old->second, 2u);
+    }
+    auto range = table->get_prefix_range("hk_0010", 0);
+    std::set<std::string> keys;
+    for (auto& [k, v, tid] : range) keys.insert(k);
+    EXPECT_EQ(keys.size(), 10u);
+  };
+  check();
+  EXPECT_EQ(table->get_node_num(), NUM_WRITERS * KEYS + 1);
+
+  ASSERT_TRUE(table->frozen_cur_table(true));
+  EXPECT_EQ(table->get_cur_size(), 0u);
+  check();
+
+  // 冻结出的跳表按 (key 升序, tranc_id 降序) 排列, 版本一个不少
+  size_t nodes = 0;
+  for (auto& frozen : table->flushsync()) {
+    std::string prev_key;
+    uint64_t    prev_tid = 0;
+    for (auto it = frozen->begin(); it != frozen->end(); ++it, ++nodes) {
+      auto key = std::string(it.key());
+      if (key == prev_key) {
+        EXPECT_LT(it.get_tranc_id(), prev_tid) << key;
+      } else {
+        EXPECT_LT(prev_key, key);
+      }
+      prev_key = key;
+      prev_tid = it.get_tranc_id();
+    }
+  }
+  EXPECT_EQ(nodes, NUM_WRITERS * KEYS + 1);
+}
+
+TEST_F(MemtableTest, HashTableRep_ConcurrentVersionsAndFreeze) {
+  CheckRepVersionsAndFreeze(Global_::MemTableRepType::kHashTable);
+}
+
+TEST_F(MemtableTest, VectorRep_ConcurrentVersionsAndFreeze) {
+  CheckRepVersionsAndFreeze(Global_::MemTableRepType::kVector);
+}
+
+// 向量表示: 同一线程对同一 (key, tranc_id) 的重复写入, 后写的在冻结后排在前面
+TEST_F(MemtableTest, VectorRep_SameIdOverwriteAfterFreeze) {
+  auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kHash,
+                                          Global_::MemTableRepType::kVector);
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 1000; ++i) {
+      table->put_mutex(std::format("vo_{:04d}", i), std::format("r{}", round));
+    }
+  }
+  EXPECT_EQ(table->get("vo_0500")->first, "r2");
+  ASSERT_TRUE(table->frozen_cur_table(true));
+  for (int i = 0; i < 1000; i += 37) {
+    EXPECT_EQ(table->get(std::format("vo_{:04d}", i))->first, "r2");
+  }
+}
+
+// 设置了快照来源后, 冻结时只留下存活快照还看得到的版本
+TEST_F(MemtableTest, FreezeCollapsesObsoleteVersions) {
+  for (auto rep : {Global_::MemTableRepType::kSkiplist, Global_::MemTableRepType::kHashTable,
+                   Global_::MemTableRepType::kVector}) {
+    auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kHash, rep);
+    table->set_snapshot_source([] { return VersionCollapser({100}); });
+    const int KEYS = 500, ROUNDS = 20;
+    uint64_t  tid  = 1;
+    for (int round = 0; round < ROUNDS; ++round) {
+      for (int i = 0; i < KEYS; ++i) {
+        table->put_mutex(std::format("ctr_{:04d}", i), std::format("{}", round), tid++);
+      }
+    }
+    ASSERT_TRUE(table->frozen_cur_table(true));
+    // 每个 key 留下最新版本和快照 100 能看到的版本 (第 0 轮 tid <= 100 的那些)
+    EXPECT_EQ(table->get_node_num(), KEYS + 100u);
+    EXPECT_EQ(table->collapsed_versions(), KEYS * ROUNDS - KEYS - 100u);
+    EXPECT_EQ(table->get("ctr_0007")->first, std::format("{}", ROUNDS - 1));
+    EXPECT_EQ(table->get("ctr_0007", 100)->first, "0");
+    EXPECT_EQ(table->get("ctr_0007", 100)->second, 8u);
+  }
+}
+
+// 前缀扫描和点查一样按 tranc_id 过滤, 活跃表和冻结表都看不到更新的版本
+TEST_F(MemtableTest, PrefixRangeHonorsTrancId) {
+  for (auto rep : {Global_::MemTableRepType::kSkiplist, Global_::MemTableRepType::kHashTable,
+                   Global_::MemTableRepType::kVector}) {
+    auto table = std::make_unique<MemTable>(Global_::MemTableShardMode::kHash, rep);
+    for (int i = 0; i < 20; ++i) {
+      table->put_mutex(std::format("pr_{:02d}", i), "old", 1);
+    }
+    table->put_mutex("pr_03", "new", 3);
+    table->put_mutex("pr_25", "new", 3);
+    auto check = [&] {
+      std::map<std::string, std::pair<std::string, uint64_t>> seen;
+      for (auto& [k, v, tid] : table->get_prefix_range("pr_", 2)) {
+        EXPECT_LE(tid, 2u) << k;
+        seen.try_emplace(k, v, tid);
+      }
+      EXPECT_EQ(seen.size(), 20u);
+      EXPECT_EQ(seen["pr_03"].first, "old");
+      EXPECT_FALSE(seen.contains("pr_25"));
+      EXPECT_EQ(table->get_prefix_range("pr_", 0).size(), 22u);
+    };
+    check();
+    ASSERT_TRUE(table->frozen_cur_table(true));
+    check();
+  }
+}
+
+// 写缓冲预算: 按实际分配的字节记账, 超出预算时即使没有分片到达单表上限也会冻结
+TEST_F(MemtableTest, WriteBufferManager_BudgetFreezesLargestShard) {
+  const size_t budget = 2 * 1024 * 1024;
+  auto         wbm    = std::make_shared<WriteBufferManager>(budget);
+  auto         table  = std::make_unique<MemTable>(Global_::MemTableShardMode::kHash,
+                                                   Global_::MemTableRepType::kSkiplist, wbm);
+  const size_t empty = wbm->memtable_memory_usage();
+  EXPECT_GT(empty, 0u);  // 每个分片的头节点已经占了一块 Arena
+  EXPECT_EQ(wbm->mutable_memtable_memory_usage(), empty);
+
+  const int         N = 20'000;
+  const std::string pad(150, 'b');
+  size_t            peak_active = 0;
+  for (int i = 0; i < N; ++i) {
+    table->put_mutex(std::format("wbm_{:06d}", i), pad);
+    peak_active = std::max(peak_active, wbm->mutable_memtable_memory_usage());
+  }
+  // 数据量约 3.5MB, 平均每个分片不到 0.5MB, 冻结只可能来自预算
+  EXPECT_GT(table->get_fixed_size(), 0u);
+  EXPECT_LE(peak_active, budget * 7 / 8 + Global_::ARENA_BLOCK_SIZE);
+  EXPECT_EQ(table->get_memory_usage(), wbm->memtable_memory_usage());
+  EXPECT_GE(wbm->memtable_memory_usage(), table->get_total_size());
+  for (int i = 0; i < N; i += 101) {
+    EXPECT_TRUE(table->get(std::format("wbm_{:06d}", i)).has_value()) << i;
+  }
+
+  // 表析构后内存全部归还
+  table->clear();
+  EXPECT_EQ(wbm->memtable_memory_usage(), empty);
+  EXPECT_EQ(wbm->mutable_memtable_memory_usage(), empty);
+  table.reset();
+  EXPECT_EQ(wbm->memtable_memory_usage(), 0u);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
@@ -10,6 +10,8 @@
 #include <memory>
 #include <random>
 #include <set>
+#include <thread>
+#include <atomic>
 
 class SkiplistTest : public ::testing::Test {
  protected:
@@ -821,6 +823,184 @@ TEST_F(SkiplistTest, EdgeCases) {
   std::print("=== 测试5完成 ===\n\n");
 }
 
+// 超过 Arena 块大小的大 value 单独成块, 与小节点混插后依然可读
+TEST_F(SkiplistTest, LargeValueInsert) {
+  const std::string big(200 * 1024, 'x');
+  EXPECT_TRUE(skiplist->Insert("big_key", big, 1));
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(skiplist->Insert(test_keys[i], test_values[i]));
+  }
+  auto res = skiplist->Get("big_key");
+  ASSERT_TRUE(res.has_value());
+  EXPECT_EQ(res->value, big);
+  EXPECT_EQ(skiplist->Get(test_keys[999])->value, test_values[999]);
+}
+
+// 并发写入 + 并发读取: 无锁插入不能丢节点, 读者不应看到未完成的节点
+TEST_F(SkiplistTest, ConcurrentInsertAndGet) {
+  constexpr int kWriters       = 8;
+  constexpr int kKeysPerWriter = 5000;
+  std::atomic<bool> done{false};
+  std::atomic<int>  bad_reads{0};
+
+  std::thread reader([&] {
+    while (!done.load(std::memory_order_acquire)) {
+      for (int i = 0; i < kKeysPerWriter; i += 97) {
+        auto key = std::format("w0_{:06}", i);
+        auto res = skiplist->Get(key);
+        if (res.has_value() && res->value != "v" + key) {
+          bad_reads++;
+        }
+      }
+    }
+  });
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kWriters; ++w) {
+    writers.emplace_back([&, w] {
+      for (int i = 0; i < kKeysPerWriter; ++i) {
+        auto key = std::format("w{}_{:06}", w, i);
+        skiplist->Insert(key, "v" + key, static_cast<uint64_t>(i + 1));
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  done.store(true, std::memory_order_release);
+  reader.join();
+
+  EXPECT_EQ(bad_reads.load(), 0);
+  EXPECT_EQ(skiplist->getnodecount(), kWriters * kKeysPerWriter);
+  for (int w = 0; w < kWriters; ++w) {
+    for (int i = 0; i < kKeysPerWriter; ++i) {
+      auto key = std::format("w{}_{:06}", w, i);
+      auto res = skiplist->Get(key);
+      ASSERT_TRUE(res.has_value()) << key;
+      EXPECT_EQ(res->transaction_id, static_cast<uint64_t>(i + 1));
+    }
+  }
+  // 第 0 层必须严格有序
+  std::string prev;
+  for (auto it = skiplist->begin(); it != skiplist->end(); ++it) {
+    auto [key, value] = it.getValue();
+    EXPECT_LT(prev, key);
+    prev = key;
+  }
+}
+
+// 同一个 key 的版本并发写入, 最终按 transaction_id 降序排列
+TEST_F(SkiplistTest, ConcurrentVersionsOrderedByTrancId) {
+  constexpr int            kThreads = 4;
+  constexpr int            kPerThread = 1000;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kPerThread; ++i) {
+        uint64_t tid = static_cast<uint64_t>(i * kThreads + t + 1);
+        skiplist->Insert("hot", std::to_string(tid), tid);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  uint64_t expect = kThreads * kPerThread;
+  for (auto it = skiplist->begin(); it != skiplist->end(); ++it) {
+    EXPECT_EQ(it.get_tranc_id(), expect--);
+  }
+  EXPECT_EQ(expect, 0u);
+  EXPECT_EQ(skiplist->Get("hot", 2000)->value, "2000");
+}
+
+// 冻结后的布隆过滤器: 已有 key 一定通过, 范围内不存在的 key 绝大多数被挡掉
+TEST_F(SkiplistTest, FreezeBuildsFilter) {
+  for (size_t i = 0; i < test_keys.size(); i += 2) {
+    skiplist->Insert(test_keys[i], test_values[i], i + 1);
+    skiplist->Insert(test_keys[i], test_values[i], i + 2);  // 多版本只计一次
+  }
+  skiplist->freeze();
+  EXPECT_EQ(skiplist->get_status(), Global_::SkiplistStatus::kFrozen);
+  EXPECT_EQ(skiplist->first_key(), test_keys.front());
+
+  int false_positive = 0;
+  for (size_t i = 0; i < test_keys.size(); ++i) {
+    if (i % 2 == 0) {
+      EXPECT_TRUE(skiplist->may_contain(test_keys[i]));
+    } else if (skiplist->may_contain(test_keys[i])) {
+      ++false_positive;
+    }
+  }
+  EXPECT_LT(false_positive, static_cast<int>(test_keys.size() / 2 / 20));  // < 5%
+  EXPECT_FALSE(skiplist->may_contain("zzz"));  // 超出 key 范围
+}
+
+TEST_F(SkiplistTest, CollapseVersionsKeepsSnapshotViews) {
+  for (uint64_t tid : {10, 20, 30, 40}) {
+    skiplist->Insert("hot", std::format("v{}", tid), tid);
+  }
+  skiplist->Insert("hot", "v40_again", 40);  // 同 id 重复写入, 只留最新的一次
+  skiplist->Insert("cold", "c5", 5);
+
+  // 没有快照时每个 key 只剩最新版本
+  auto latest = skiplist->collapse_versions(VersionCollapser({}));
+  ASSERT_NE(latest, nullptr);
+  EXPECT_EQ(latest->getnodecount(), 2);
+  EXPECT_EQ(latest->Get("hot")->value, "v40_again");
+  EXPECT_FALSE(latest->Get("hot", 39).has_value());
+
+  // 快照 25 看到的是 tid=20 的版本, 快照 45 与最新版本相同
+  auto pinned = skiplist->collapse_versions(VersionCollapser({45, 25}));
+  ASSERT_NE(pinned, nullptr);
+  EXPECT_EQ(pinned->getnodecount(), 3);
+  EXPECT_EQ(pinned->Get("hot", 25)->value, "v20");
+  EXPECT_EQ(pinned->Get("hot", 45)->value, "v40_again");
+  EXPECT_EQ(pinned->Get("cold")->value, "c5");
+
+  // 已经没有多余版本时不复制
+  EXPECT_EQ(latest->collapse_versions(VersionCollapser({})), nullptr);
+}
+
+// 节点内嵌的 8 字节前缀只是比较的捷径: 含 \0 / 高位字节 / 长度在 8 字节上下的 key
+// 排序必须和完整的字典序一致
+TEST_F(SkiplistTest, InlineKeyPrefixKeepsOrder) {
+  const std::string alphabet("\0\x01a\x7f\x80\xff", 6);
+  std::mt19937      rng(12345);
+  std::set<std::string> expected;
+  for (int i = 0; i < 3000; ++i) {
+    std::string key(rng() % 13, '\0');
+    for (auto& c : key) {
+      c = alphabet[rng() % alphabet.size()];
+    }
+    expected.insert(key);
+    skiplist->Insert(key, key, static_cast<uint64_t>(i + 1));
+  }
+  for (const auto& a : expected) {
+    for (const auto& b : {std::string(""), std::string("a"), std::string(8, '\0'),
+                          std::string("\xff\xff\xff\xff\xff\xff\xff\xff\x01", 9)}) {
+      if (Node::key_prefix(a) < Node::key_prefix(b)) {
+        EXPECT_LT(a, b);
+      }
+    }
+  }
+
+  auto want = expected.begin();
+  for (auto it = skiplist->begin(); it != skiplist->end(); ++it) {
+    ASSERT_NE(want, expected.end());
+    if (it.key() != *want) {
+      ++want;  // 下一个不同的 key
+    }
+    ASSERT_NE(want, expected.end());
+    EXPECT_EQ(it.key(), *want);
+  }
+  EXPECT_EQ(std::next(want), expected.end());
+  for (const auto& key : expected) {
+    auto res = skiplist->Get(key);
+    ASSERT_TRUE(res.has_value());
+    EXPECT_EQ(res->value, key);
+  }
+  EXPECT_FALSE(skiplist->Get(std::string("a\0\0\0\0\0\0\0\0\0\0\0\0\0", 14)).has_value());
+}
+
 // ==================== 主函数 ====================
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
@@ -216,6 +216,52 @@ TEST_F(SstableTest, ReadMultipleBlocksAndCache) {
   }
 }
 
+// 不校验 checksum 读出的 block 不进 block cache, 缓存里只留校验过的
+TEST_F(SstableTest, UnverifiedReadsBypassCache) {
+  if (std::filesystem::exists(tmp_path2))
+    std::filesystem::remove(tmp_path2);
+
+  Sstbuild builder(256);
+  for (size_t i = 0; i < 500; ++i) {
+    builder.add("uv" + std::to_string(i), "v" + std::to_string(i), 0);
+  }
+  auto sst = builder.build(block_cache, tmp_path2, 3);
+  ASSERT_NE(sst, nullptr);
+
+  const ReadOptions unverified{.verify_checksums = false};
+  auto              first  = sst->read_block(0, unverified);
+  auto              second = sst->read_block(0, unverified);
+  ASSERT_NE(first, nullptr);
+  EXPECT_NE(first, second) << "unverified block was cached";
+
+  auto verified = sst->read_block(0);
+  ASSERT_NE(verified, nullptr);
+  EXPECT_EQ(verified, sst->read_block(0));
+  // 校验过的缓存项可以直接给不校验的读者
+  EXPECT_EQ(verified, sst->read_block(0, unverified));
+}
+
+// bloom filter 按头部的格式版本决定有没有 checksum, 不再按长度猜
+TEST_F(SstableTest, BloomFilter_FormatVersion) {
+  BloomFilter bf(100, 0.01);
+  for (int i = 0; i < 100; ++i) bf.add("bf" + std::to_string(i));
+  auto encoded = bf.encode();
+  EXPECT_EQ(encoded[sizeof(size_t) - 1], BloomFilter::kFormatCrc32c);
+  EXPECT_TRUE(BloomFilter::decode(encoded).possibly_contains("bf42"));
+
+  // 去掉 checksum 但版本仍是新格式: 长度不符
+  std::vector<uint8_t> legacy(encoded.begin(), encoded.end() - sizeof(uint32_t));
+  EXPECT_THROW(BloomFilter::decode(legacy), std::invalid_argument);
+  // 旧格式 (版本字节为 0) 没有 checksum
+  legacy[sizeof(size_t) - 1] = BloomFilter::kFormatLegacy;
+  auto old = BloomFilter::decode(legacy);
+  for (int i = 0; i < 100; ++i) EXPECT_TRUE(old.possibly_contains("bf" + std::to_string(i)));
+
+  auto corrupted = encoded;
+  corrupted[sizeof(size_t) + sizeof(double) + sizeof(uint64_t) + sizeof(uint32_t)] ^= 0x1;
+  EXPECT_THROW(BloomFilter::decode(corrupted), std::runtime_error);
+}
+
 // Collect keys from [begin, end) and verify prefix
 static std::vector<std::string> collect_prefix_keys(const std::shared_ptr<BlockIterator>& begin,
                                                     const std::shared_ptr<BlockIterator>& end,